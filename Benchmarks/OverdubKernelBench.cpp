@@ -0,0 +1,153 @@
+/*
+    Overdub kernel microbenchmark: the two passes LoopTrack::handleOverdub used to make
+    (play the loop into the output, then add the input into the loop) against the fused
+    MixKernels::overdub, which reads the loop once.
+
+    The loop is larger than the caches (as a real loop is) and is walked block by block,
+    like the audio thread does. Output and input are block-sized and stay in cache.
+    Per sample and channel the loop stream costs 12 bytes in two passes when the second
+    read misses (read, read, write) and 8 bytes fused (read, write).
+*/
+#include "MixKernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+    constexpr int loopLength = 1 << 22; // 16 MB per buffer, about 95 s at 44.1 kHz
+    constexpr int repetitions = 5;
+
+    struct Buffers
+    {
+        std::vector<float> loop, other, out, in;
+
+        explicit Buffers(int blockSize)
+            : loop((size_t)loopLength), other((size_t)loopLength),
+              out((size_t)blockSize), in((size_t)blockSize)
+        {
+            for (size_t i = 0; i < loop.size(); ++i)
+            {
+                loop[i]  = (float)std::sin((double)i * 0.001);
+                other[i] = (float)std::cos((double)i * 0.003);
+            }
+            for (size_t i = 0; i < in.size(); ++i)
+                in[i] = 1.0e-6f * (float)(i % 7);
+        }
+    };
+
+    void twoPass(float* out, float* loop, const float* in, const float* other, float gain, float, int n)
+    {
+        if (other != nullptr)
+            MixKernels::addSum2(out, loop, other, gain, n);
+        else
+            MixKernels::addSum1(out, loop, gain, n);
+
+        for (int i = 0; i < n; ++i)
+            loop[i] += in[i];
+    }
+
+    using Kernel = void (*)(float*, float*, const float*, const float*, float, float, int);
+
+    /** Best-of-N nanoseconds per sample for one sweep over the loop. */
+    double measure(Kernel kernel, int blockSize, bool withOther)
+    {
+        Buffers b(blockSize);
+        double best = 1.0e30;
+
+        for (int r = 0; r < repetitions; ++r)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            // Odd starting offset: heads and tails are part of the cost, as in the track
+            for (int pos = 3; pos + blockSize <= loopLength; pos += blockSize)
+            {
+                std::fill(b.out.begin(), b.out.end(), 0.0f);
+                kernel(b.out.data(), b.loop.data() + pos, b.in.data(),
+                       withOther ? b.other.data() + pos : nullptr, 0.8f, 1.0f, blockSize);
+            }
+
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            best = std::min(best, ns / (double)loopLength);
+        }
+        return best;
+    }
+
+    /** The fused kernels must match the two-pass result (up to rounding). */
+    bool verify(Kernel kernel, int blockSize)
+    {
+        Buffers expected(blockSize), actual(blockSize);
+        for (int pos = 1; pos + blockSize <= 64 * blockSize; pos += blockSize)
+        {
+            std::fill(expected.out.begin(), expected.out.end(), 0.25f);
+            std::fill(actual.out.begin(), actual.out.end(), 0.25f);
+            twoPass(expected.out.data(), expected.loop.data() + pos, expected.in.data(),
+                    expected.other.data() + pos, 0.8f, 1.0f, blockSize);
+            kernel(actual.out.data(), actual.loop.data() + pos, actual.in.data(),
+                   actual.other.data() + pos, 0.8f, 1.0f, blockSize);
+
+            for (int i = 0; i < blockSize; ++i)
+                if (std::abs(expected.out[(size_t)i] - actual.out[(size_t)i]) > 1.0e-5f
+                    || std::abs(expected.loop[(size_t)(pos + i)] - actual.loop[(size_t)(pos + i)]) > 1.0e-5f)
+                    return false;
+        }
+        return true;
+    }
+
+    const char* instructionSet()
+    {
+       #if MIXKERNELS_AVX
+        return "AVX";
+       #elif MIXKERNELS_SSE
+        return "SSE2";
+       #elif MIXKERNELS_NEON
+        return "NEON";
+       #else
+        return "scalar";
+       #endif
+    }
+}
+
+int main()
+{
+    const int blockSizes[] = { 64, 128, 256, 512, 1024, 2048 };
+
+    for (int blockSize : blockSizes)
+    {
+        if (!verify(MixKernels::overdubScalar, blockSize) || !verify(MixKernels::overdub, blockSize))
+        {
+            std::printf("MISMATCH at block size %d\n", blockSize);
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::printf("Overdub kernel, %s build, loop %d samples, ns per sample (one channel)\n\n",
+                instructionSet(), loopLength);
+
+    for (bool withOther : { false, true })
+    {
+        std::printf("%s\n", withOther ? "top layer + one other source (base)" : "top layer only");
+        std::printf("%8s %12s %12s %12s %10s %14s\n",
+                    "block", "two-pass", "fused-scal", "fused-simd", "speedup", "loop GB/s");
+
+        for (int blockSize : blockSizes)
+        {
+            double two   = measure(twoPass, blockSize, withOther);
+            double fusedScalar = measure(MixKernels::overdubScalar, blockSize, withOther);
+            double fused = measure(MixKernels::overdub, blockSize, withOther);
+
+            // Loop traffic actually required by the fused kernel: 4 bytes read + 4 written
+            double gigabytesPerSecond = 8.0 / fused;
+
+            std::printf("%8d %12.3f %12.3f %12.3f %9.2fx %14.2f\n",
+                        blockSize, two, fusedScalar, fused, two / fused, gigabytesPerSecond);
+        }
+        std::printf("\n");
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,398 @@
+/*
+    Headless processBlock benchmark (no editor), reported as JSON.
+
+    For every combination of block size, sample rate and track count a processor is
+    built and its tracks record a one-second loop (track 1 as master, the others as
+    slaves of the same length). processBlock is then timed in three states:
+
+    - play:    every track playing
+    - overdub: every track overdubbing
+    - bounce:  the last track recording again while a Bounce is mixed down and installed
+               (blocks are paced in real time, so the job runs alongside as on stage)
+
+    Each result gives ns per sample, the mean and worst block, and the heap allocations
+    and blocking locks inside processBlock, render workers included (RealtimeGuard,
+    glibc only). Everything is routed to the monitor bus, the worst case for output mixing.
+
+    --rt-check instead walks every command (record, overdub, multiply, divide, undo, redo,
+    after loop, FX replace, clear, stop, bounce, reset) and an oversized host block, with
+    RealtimeGuard reporting the stack of each allocation or lock on a realtime thread
+    (--rt-abort: abort on the first one). Exit code 1 if anything was found.
+
+    Usage: ProcessorBench [--render-threads N] [--block-sizes 16,256] [--rates 48000]
+                          [--tracks 1,6] [--scenarios play,overdub,bounce] [--rt-check | --rt-abort]
+    JSON goes to stdout, progress and reports to stderr.
+*/
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "RealtimeGuard.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <thread>
+
+//==============================================================================
+namespace
+{
+    using Cmd = LooperCommand::Type;
+    using Clock = std::chrono::steady_clock;
+
+    struct Config
+    {
+        int blockSize = 256;
+        double sampleRate = 48000.0;
+        int numTracks = 1;
+        int renderThreads = 0;
+    };
+
+    struct Timing
+    {
+        int numBlocks = 0;
+        double totalNs = 0.0;
+        double worstUs = 0.0;
+        long long allocations = 0, locks = 0;
+
+        void add(double ns, const RealtimeGuard::Totals& violations)
+        {
+            ++numBlocks;
+            totalNs += ns;
+            worstUs = juce::jmax(worstUs, ns / 1000.0);
+            allocations += violations.allocations;
+            locks += violations.locks;
+        }
+    };
+
+    struct Harness
+    {
+        explicit Harness(const Config& c)
+            : config(c), processor(c.numTracks)
+        {
+            processor.setRateAndBufferSizeDetails(config.sampleRate, config.blockSize);
+            processor.prepareToPlay(config.sampleRate, config.blockSize);
+
+            auto* threads = processor.apvts.getParameter("render_threads");
+            threads->setValueNotifyingHost(threads->convertTo0to1((float)config.renderThreads));
+            // Room for host blocks larger than announced (--rt-check)
+            buffer.setSize(juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()),
+                           2 * config.blockSize);
+            midi.ensureSize(4096); // hosts hand over a preallocated buffer
+        }
+
+        double blockMs() const { return 1000.0 * config.blockSize / config.sampleRate; }
+        int blocksFor(double seconds) const { return juce::jmax(1, juce::roundToInt(seconds * config.sampleRate / config.blockSize)); }
+
+        /** One processBlock on fresh input (numSamples: 0 = the prepared block size). */
+        void processOne(Timing* timing, int numSamples = 0)
+        {
+            numSamples = numSamples > 0 ? juce::jmin(numSamples, buffer.getNumSamples()) : config.blockSize;
+            juce::AudioBuffer<float> block(buffer.getArrayOfWritePointers(), buffer.getNumChannels(), numSamples);
+
+            // Fresh input: processBlock leaves the output in the shared channels
+            for (int ch = 0; ch < juce::jmin(2, block.getNumChannels()); ++ch)
+                for (int i = 0; i < numSamples; ++i)
+                    block.setSample(ch, i, 0.1f * (random.nextFloat() * 2.0f - 1.0f));
+            midi.clear();
+
+            const auto before = RealtimeGuard::getTotals();
+            const auto start = Clock::now();
+            {
+                RealtimeGuard::ScopedRealtime realtime;
+                processor.processBlock(block, midi);
+            }
+            const auto end = Clock::now();
+            const auto after = RealtimeGuard::getTotals();
+
+            if (timing != nullptr)
+                timing->add(std::chrono::duration<double, std::nano>(end - start).count(),
+                            { after.allocations - before.allocations, after.locks - before.locks });
+        }
+
+        /** Setup / warm-up: about four times real time, so the background thread keeps the page pool filled. */
+        void runPaced(int numBlocks)
+        {
+            double owedMs = 0.0;
+            for (int b = 0; b < numBlocks; ++b)
+            {
+                processOne(nullptr);
+                owedMs += 0.25 * blockMs();
+                if (owedMs >= 1.0)
+                {
+                    juce::Thread::sleep((int)owedMs);
+                    owedMs -= (int)owedMs;
+                }
+            }
+        }
+
+        Timing runTimed(int numBlocks)
+        {
+            Timing timing;
+            for (int b = 0; b < numBlocks; ++b)
+                processOne(&timing);
+            return timing;
+        }
+
+        /** Blocks spaced as a host would deliver them, until done() or maxBlocks. */
+        template <typename Done>
+        Timing runRealTime(int minBlocks, int maxBlocks, Done done)
+        {
+            Timing timing;
+            const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(blockMs()));
+            auto next = Clock::now();
+            for (int b = 0; b < maxBlocks && (b < minBlocks || !done()); ++b)
+            {
+                processOne(&timing);
+                next += period;
+                std::this_thread::sleep_until(next);
+            }
+            return timing;
+        }
+
+        void pushToAllTracks(Cmd type, int firstTrack = 0)
+        {
+            for (int t = firstTrack; t < processor.getNumTracks(); ++t)
+                processor.pushCommand(type, t);
+        }
+
+        int countTracksIn(LoopTrack::State state)
+        {
+            int count = 0;
+            for (auto& track : processor.getTracks())
+                count += track->getState() == state ? 1 : 0;
+            return count;
+        }
+
+        /** Every track playing a one-second loop. */
+        bool recordLoops()
+        {
+            processor.pushCommand(Cmd::RecPlay, 0);
+            runPaced(blocksFor(1.0));
+            processor.pushCommand(Cmd::RecPlay, 0);
+            runPaced(2);
+            pushToAllTracks(Cmd::RecPlay, 1);
+            runPaced(blocksFor(1.0) + 8);
+            return countTracksIn(LoopTrack::State::Playing) == config.numTracks;
+        }
+
+        Config config;
+        SimpleLooperAudioProcessor processor;
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+        juce::Random random { 1234 };
+    };
+
+    //==============================================================================
+    /** Every command and state change once, counting realtime violations per step. */
+    juce::var runRealtimeCheck(const Config& config, bool& clean)
+    {
+        Harness h(config);
+        juce::Array<juce::var> steps;
+        clean = true;
+
+        auto step = [&](const char* name, std::function<void()> action, double seconds)
+        {
+            const auto before = RealtimeGuard::getTotals();
+            if (action)
+                action();
+            h.runPaced(h.blocksFor(seconds));
+            const auto after = RealtimeGuard::getTotals();
+
+            const auto allocations = after.allocations - before.allocations;
+            const auto locks = after.locks - before.locks;
+            std::fprintf(stderr, "  %-22s %lld allocations, %lld locks\n", name, allocations, locks);
+            clean = clean && allocations == 0 && locks == 0;
+
+            auto* result = new juce::DynamicObject();
+            result->setProperty("step", name);
+            result->setProperty("allocations", allocations);
+            result->setProperty("locks", locks);
+            steps.add(juce::var(result));
+        };
+
+        const int last = config.numTracks - 1;
+        auto& p = h.processor;
+
+        step("record loops",    [&] { if (!h.recordLoops()) clean = false; }, 0.1);
+        step("overdub",         [&] { h.pushToAllTracks(Cmd::RecPlay); }, 1.1);
+        step("overdub end",     [&] { h.pushToAllTracks(Cmd::RecPlay); }, 0.2);
+        step("multiply",        [&] { p.pushCommand(Cmd::Multiply, 0); }, 0.5);
+        step("divide",          [&] { p.pushCommand(Cmd::Divide, 0); }, 0.5);
+        step("undo",            [&] { h.pushToAllTracks(Cmd::Undo); }, 0.2);
+        step("redo",            [&] { h.pushToAllTracks(Cmd::Redo); }, 0.2);
+        step("after loop",      [&] { p.pushCommand(Cmd::AfterLoop, last); }, 1.5);
+        step("fx replace",      [&] { p.pushCommand(Cmd::FxReplace, last); }, 0.2);
+        step("clear",           [&] { p.pushCommand(Cmd::Clear, last); }, 0.2);
+        step("record again",    [&] { p.pushCommand(Cmd::RecPlay, last); }, 1.2);
+        step("stop / play",     [&] { p.pushCommand(Cmd::Stop, 0); h.runPaced(4); p.pushCommand(Cmd::RecPlay, 0); }, 0.2);
+        step("oversized block", [&] { for (int b = 0; b < 4; ++b) h.processOne(nullptr, 2 * config.blockSize); }, 0.1);
+        step("bounce",          [&] { p.pushCommand(Cmd::Bounce); }, 2.0);
+        step("reset",           [&] { p.pushCommand(Cmd::Reset); }, 0.2);
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("block_size", config.blockSize);
+        result->setProperty("sample_rate", config.sampleRate);
+        result->setProperty("tracks", config.numTracks);
+        result->setProperty("clean", clean);
+        result->setProperty("steps", steps);
+        return juce::var(result);
+    }
+
+    //==============================================================================
+    std::vector<int> parseList(const juce::String& text)
+    {
+        std::vector<int> values;
+        for (auto& item : juce::StringArray::fromTokens(text, ",", {}))
+            if (item.trim().getIntValue() > 0)
+                values.push_back(item.trim().getIntValue());
+        return values;
+    }
+
+    juce::var makeResult(const Config& config, const char* scenario, const Timing& timing)
+    {
+        auto* result = new juce::DynamicObject();
+        result->setProperty("scenario", scenario);
+        result->setProperty("block_size", config.blockSize);
+        result->setProperty("sample_rate", config.sampleRate);
+        result->setProperty("tracks", config.numTracks);
+        result->setProperty("blocks", timing.numBlocks);
+
+        const double samples = (double)timing.numBlocks * config.blockSize;
+        const double budgetUs = 1.0e6 * config.blockSize / config.sampleRate;
+        const double meanUs = timing.numBlocks > 0 ? timing.totalNs / timing.numBlocks / 1000.0 : 0.0;
+        result->setProperty("ns_per_sample", samples > 0.0 ? timing.totalNs / samples : 0.0);
+        result->setProperty("mean_block_us", meanUs);
+        result->setProperty("worst_block_us", timing.worstUs);
+        result->setProperty("budget_us", budgetUs);
+        result->setProperty("worst_percent_of_budget", 100.0 * timing.worstUs / budgetUs);
+        result->setProperty("allocations", RealtimeGuard::isAvailable() ? juce::var(timing.allocations) : juce::var());
+        result->setProperty("locks", RealtimeGuard::isAvailable() ? juce::var(timing.locks) : juce::var());
+        return juce::var(result);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    std::vector<int> blockSizes  { 16, 64, 256, 1024, 4096 };
+    std::vector<int> sampleRates { 44100, 96000 };
+    std::vector<int> trackCounts { 1, 6, 16 };
+    juce::StringArray scenarios  { "play", "overdub", "bounce" };
+    int renderThreads = 0;
+    bool realtimeCheck = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String option(argv[i]);
+        if (option == "--rt-check" || option == "--rt-abort")
+        {
+            realtimeCheck = true;
+            RealtimeGuard::setAction(option == "--rt-abort" ? RealtimeGuard::Action::Abort
+                                                           : RealtimeGuard::Action::Report);
+            continue;
+        }
+
+        const juce::String value(i + 1 < argc ? argv[++i] : "");
+        if      (option == "--render-threads") renderThreads = juce::jlimit(0, RenderWorkerPool::maxWorkers, value.getIntValue());
+        else if (option == "--block-sizes")    blockSizes = parseList(value);
+        else if (option == "--rates")          sampleRates = parseList(value);
+        else if (option == "--tracks")         trackCounts = parseList(value);
+        else if (option == "--scenarios")      scenarios = juce::StringArray::fromTokens(value, ",", {});
+        else
+        {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    if (realtimeCheck)
+    {
+        if (!RealtimeGuard::isAvailable())
+            std::fprintf(stderr, "realtime checks need glibc: nothing is intercepted\n");
+
+        // One realistic configuration per block size unless narrowed down
+        juce::Array<juce::var> checks;
+        bool allClean = true;
+        for (int blockSize : blockSizes)
+        {
+            const Config config { juce::jlimit(1, 1 << 15, blockSize), (double)sampleRates.front(),
+                                  juce::jlimit(2, SimpleLooperAudioProcessor::MAX_TRACKS, trackCounts.back()), renderThreads };
+            std::fprintf(stderr, "rt-check %6.0f Hz %5d samples %3d tracks\n", config.sampleRate, config.blockSize, config.numTracks);
+
+            bool clean = true;
+            checks.add(runRealtimeCheck(config, clean));
+            allClean = allClean && clean;
+        }
+
+        auto* report = new juce::DynamicObject();
+        report->setProperty("rt_check", checks);
+        report->setProperty("clean", allClean);
+        std::printf("%s\n", juce::JSON::toString(juce::var(report)).toRawUTF8());
+        return allClean ? 0 : 1;
+    }
+
+    juce::Array<juce::var> results;
+    bool allSetUp = true;
+
+    for (int sampleRate : sampleRates)
+        for (int blockSize : blockSizes)
+            for (int numTracks : trackCounts)
+            {
+                const Config config { juce::jlimit(1, 1 << 15, blockSize), (double)sampleRate,
+                                      juce::jlimit(1, SimpleLooperAudioProcessor::MAX_TRACKS, numTracks), renderThreads };
+                std::fprintf(stderr, "%6d Hz %5d samples %3d tracks\n", sampleRate, config.blockSize, config.numTracks);
+
+                Harness h(config);
+                if (!h.recordLoops())
+                {
+                    std::fprintf(stderr, "  setup failed: only %d tracks playing\n", h.countTracksIn(LoopTrack::State::Playing));
+                    allSetUp = false;
+                    continue;
+                }
+
+                const int timedBlocks = juce::jmax(64, h.blocksFor(1.0));
+
+                if (scenarios.contains("play"))
+                {
+                    h.runPaced(h.blocksFor(0.25)); // warm up
+                    results.add(makeResult(config, "play", h.runTimed(timedBlocks)));
+                }
+
+                if (scenarios.contains("overdub"))
+                {
+                    h.pushToAllTracks(Cmd::RecPlay);  // Playing -> Overdubbing
+                    h.runPaced(h.blocksFor(1.0) + 2); // first pass pulls the layer pages
+                    results.add(makeResult(config, "overdub", h.runTimed(timedBlocks)));
+                    h.pushToAllTracks(Cmd::RecPlay);  // back to Playing
+                    h.runPaced(2);
+                }
+
+                if (scenarios.contains("bounce"))
+                {
+                    // The last track records a new loop while every track is mixed down
+                    const int recordingTrack = config.numTracks - 1;
+                    if (recordingTrack > 0)
+                    {
+                        h.processor.pushCommand(Cmd::Clear, recordingTrack);
+                        h.processor.pushCommand(Cmd::RecPlay, recordingTrack);
+                    }
+                    h.processor.pushCommand(Cmd::Bounce);
+
+                    auto timing = h.runRealTime(h.blocksFor(0.25), h.blocksFor(10.0),
+                                                [&] { return h.processor.getLastBounceLatencyMs() >= 0.0; });
+                    auto result = makeResult(config, "bounce", timing);
+                    result.getDynamicObject()->setProperty("bounce_latency_ms", h.processor.getLastBounceLatencyMs());
+                    results.add(result);
+                }
+            }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("benchmark", "processBlock");
+    report->setProperty("render_threads", renderThreads);
+    report->setProperty("counts_allocations", RealtimeGuard::isAvailable());
+    report->setProperty("results", results);
+
+    std::printf("%s\n", juce::JSON::toString(juce::var(report)).toRawUTF8());
+    return allSetUp ? 0 : 1;
+}
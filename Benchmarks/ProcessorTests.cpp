@@ -0,0 +1,338 @@
+/*
+    Headless processor tests (juce::UnitTest), built with ProcessorBench.
+
+    Each test drives a prepared processor through pushCommand / parameters and
+    processBlock, as a host would, and checks the tracks' states afterwards.
+
+    Usage: ProcessorTests        (exit code 1 if any test failed)
+*/
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "SessionFormat.h"
+
+#include <vector>
+
+//==============================================================================
+namespace
+{
+    using Cmd = LooperCommand::Type;
+
+    constexpr double sampleRate = 48000.0;
+    constexpr int blockSize = 256;
+
+    struct Harness
+    {
+        explicit Harness(int numTracks = 2)
+            : processor(numTracks)
+        {
+            processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+            processor.prepareToPlay(sampleRate, blockSize);
+            buffer.setSize(juce::jmax(processor.getTotalNumInputChannels(), processor.getTotalNumOutputChannels()),
+                           blockSize);
+        }
+
+        ~Harness() { processor.releaseResources(); }
+
+        int blocksFor(double seconds) const { return juce::jmax(1, juce::roundToInt(seconds * sampleRate / blockSize)); }
+
+        /** Blocks of fresh noise, paced so the background threads keep up. */
+        void run(int numBlocks)
+        {
+            for (int b = 0; b < numBlocks; ++b)
+            {
+                for (int ch = 0; ch < juce::jmin(2, buffer.getNumChannels()); ++ch)
+                    for (int i = 0; i < blockSize; ++i)
+                        buffer.setSample(ch, i, 0.1f * (random.nextFloat() * 2.0f - 1.0f));
+                midi.clear();
+                processor.processBlock(buffer, midi);
+                if (b % 16 == 15)
+                    juce::Thread::sleep(1);
+            }
+        }
+
+        void press(const juce::String& paramID)
+        {
+            auto* parameter = processor.apvts.getParameter(paramID);
+            parameter->setValueNotifyingHost(parameter->getValue() < 0.5f ? 1.0f : 0.0f);
+        }
+
+        int countTracksIn(LoopTrack::State state)
+        {
+            int count = 0;
+            for (auto& track : processor.getTracks())
+                count += track->getState() == state ? 1 : 0;
+            return count;
+        }
+
+        LoopTrack& track(int index) { return *processor.getTracks()[(size_t)index]; }
+
+        SimpleLooperAudioProcessor processor;
+        juce::AudioBuffer<float> buffer;
+        juce::MidiBuffer midi;
+        juce::Random random { 1234 };
+    };
+
+    //==============================================================================
+    class SessionStateTests : public juce::UnitTest
+    {
+    public:
+        SessionStateTests() : juce::UnitTest("Session state", "Processor") {}
+
+        void runTest() override
+        {
+            beginTest("Restoring a state doesn't press the trigger parameters");
+            {
+                Harness saved;
+                saved.press("rec_0");
+                saved.press("clear_1");
+                saved.press("reset_all");
+
+                juce::MemoryBlock state;
+                saved.processor.getStateInformation(state);
+
+                Harness restored;
+                restored.processor.setStateInformation(state.getData(), (int)state.getSize());
+                restored.run(restored.blocksFor(0.25));
+                expectEquals(restored.countTracksIn(LoopTrack::State::Empty), restored.processor.getNumTracks());
+            }
+
+            beginTest("Trigger parameters in older sessions are ignored");
+            {
+                // A session written with the triggers still in the parameter tree
+                Harness saved;
+                saved.press("rec_0");
+                auto parameters = saved.processor.apvts.copyState();
+
+                juce::MemoryOutputStream tree;
+                parameters.writeToStream(tree);
+
+                juce::MemoryOutputStream session;
+                SessionFormat::writeHeader(session);
+                SessionFormat::writeChunkHeader(session, SessionFormat::parametersId, tree.getDataSize());
+                session.write(tree.getData(), tree.getDataSize());
+
+                Harness restored;
+                restored.processor.setStateInformation(session.getData(), (int)session.getDataSize());
+                restored.run(restored.blocksFor(0.25));
+                expectEquals(restored.countTracksIn(LoopTrack::State::Empty), restored.processor.getNumTracks());
+            }
+
+            beginTest("A loop saved before the encoder compressed it is restored");
+            {
+                Harness saved;
+                saved.processor.pushCommand(Cmd::RecPlay, 0);
+                saved.run(saved.blocksFor(0.5));
+                saved.processor.pushCommand(Cmd::RecPlay, 0);
+                saved.run(2);
+
+                juce::MemoryBlock state;
+                saved.processor.getStateInformation(state); // stored uncompressed
+
+                Harness restored;
+                restored.processor.setStateInformation(state.getData(), (int)state.getSize());
+                for (int b = 0; b < restored.blocksFor(5.0) && restored.track(0).getState() != LoopTrack::State::Playing; ++b)
+                {
+                    restored.run(1);
+                    juce::Thread::sleep(1);
+                }
+                expect(restored.track(0).getState() == LoopTrack::State::Playing);
+                expectEquals(restored.track(0).getLoopLengthSamples(), saved.track(0).getLoopLengthSamples());
+            }
+
+            beginTest("A session saved again before its reset is processed is kept");
+            {
+                Harness saved;
+                saved.processor.pushCommand(Cmd::RecPlay, 0);
+                saved.run(saved.blocksFor(0.5));
+                saved.processor.pushCommand(Cmd::RecPlay, 0);
+                saved.run(2);
+
+                juce::MemoryBlock state;
+                saved.processor.getStateInformation(state);
+
+                // The host restores, then saves, without a block in between
+                Harness restored;
+                restored.processor.setStateInformation(state.getData(), (int)state.getSize());
+                juce::MemoryBlock again;
+                restored.processor.getStateInformation(again);
+
+                Harness reloaded;
+                reloaded.processor.setStateInformation(again.getData(), (int)again.getSize());
+                for (int b = 0; b < reloaded.blocksFor(5.0) && reloaded.track(0).getState() != LoopTrack::State::Playing; ++b)
+                {
+                    reloaded.run(1);
+                    juce::Thread::sleep(1);
+                }
+                expect(reloaded.track(0).getState() == LoopTrack::State::Playing);
+                expectEquals(reloaded.track(0).getLoopLengthSamples(), saved.track(0).getLoopLengthSamples());
+            }
+        }
+    };
+
+    static SessionStateTests sessionStateTests;
+
+    //==============================================================================
+    class StemExportTests : public juce::UnitTest
+    {
+    public:
+        StemExportTests() : juce::UnitTest("Stem export", "Processor") {}
+
+        void runTest() override
+        {
+            beginTest("An export finishes while the host doesn't call processBlock");
+            {
+                Harness h;
+                h.processor.pushCommand(Cmd::RecPlay, 0);
+                h.run(h.blocksFor(0.25));
+                h.processor.pushCommand(Cmd::RecPlay, 0);
+                h.run(2);
+
+                auto folder = juce::File::getSpecialLocation(juce::File::tempDirectory)
+                                  .getNonexistentChildFile("SimpleLooperStems", "");
+                StemExport::Options options;
+                options.folder = folder;
+                expect(h.processor.exportStems(options));
+
+                using State = SimpleLooperAudioProcessor::ExportState;
+                for (int ms = 0; ms < 5000 && h.processor.getStemExportState() == State::Running; ms += 10)
+                    juce::Thread::sleep(10);
+
+                expect(h.processor.getStemExportState() == State::Done);
+                expect(folder.getChildFile("Track 1.wav").existsAsFile());
+                folder.deleteRecursively();
+            }
+        }
+    };
+
+    static StemExportTests stemExportTests;
+
+    //==============================================================================
+    class TrackCommandTests : public juce::UnitTest
+    {
+    public:
+        TrackCommandTests() : juce::UnitTest("Track commands", "Processor") {}
+
+        void runTest() override
+        {
+            beginTest("Record, stop, multiply, play");
+            {
+                Harness h;
+                auto& p = h.processor;
+                auto& track = h.track(0);
+
+                p.pushCommand(Cmd::RecPlay, 0);
+                h.run(h.blocksFor(0.5));
+                p.pushCommand(Cmd::Stop, 0);
+                h.run(2);
+
+                const int length = track.getLoopLengthSamples();
+                expect(track.getState() == LoopTrack::State::Stopped);
+                expectGreaterThan(length, 0);
+                expectEquals(track.getLoopImage().getBasePeriod(), length);
+
+                p.pushCommand(Cmd::Multiply, 0);
+                h.run(2);
+                expectEquals(track.getLoopLengthSamples(), 2 * length);
+
+                p.pushCommand(Cmd::RecPlay, 0);
+                h.run(1);
+                expect(track.getState() == LoopTrack::State::Playing);
+
+                // The doubled loop plays the recording twice
+                std::vector<float> played;
+                while ((int)played.size() < 3 * length)
+                {
+                    h.run(1);
+                    const auto* output = track.getOutput().getReadPointer(0);
+                    played.insert(played.end(), output, output + blockSize);
+                }
+
+                float peak = 0.0f, worstDifference = 0.0f;
+                for (int i = 0; i < 2 * length; ++i)
+                {
+                    peak = juce::jmax(peak, std::abs(played[(size_t)i]));
+                    worstDifference = juce::jmax(worstDifference, std::abs(played[(size_t)i] - played[(size_t)(i + length)]));
+                }
+                expectGreaterThan(peak, 0.01f);
+                expectEquals(worstDifference, 0.0f);
+            }
+
+            beginTest("FX replace captures the next pass, then replaces the loop");
+            {
+                Harness h;
+                auto& p = h.processor;
+                auto& track = h.track(0);
+
+                p.pushCommand(Cmd::RecPlay, 0);
+                h.run(h.blocksFor(0.25));
+                p.pushCommand(Cmd::RecPlay, 0);
+                h.run(2);
+                const int length = track.getLoopLengthSamples();
+
+                p.pushCommand(Cmd::FxReplace, 0);
+                h.run(1);
+                expect(track.isFxCaptureArmed());
+
+                // The FX return is silent here: so is the replaced loop
+                h.run(length / blockSize + 2);
+                expect(!track.isFxCaptureArmed());
+                expectEquals(track.getLoopLengthSamples(), length);
+
+                float peak = 0.0f;
+                for (int b = 0; b < length / blockSize; ++b)
+                {
+                    h.run(1);
+                    peak = juce::jmax(peak, track.getOutput().getMagnitude(0, 0, blockSize));
+                }
+                expectEquals(peak, 0.0f);
+
+                p.pushCommand(Cmd::FxReplace, 0);
+                h.run(1);
+                p.pushCommand(Cmd::FxReplace, 0); // cancelled
+                h.run(1);
+                expect(!track.isFxCaptureArmed());
+            }
+
+            beginTest("Imports wait for a master loop, and the master waits for the other tracks");
+            {
+                Harness h(3);
+                auto& p = h.processor;
+                juce::TemporaryFile file(".wav");
+                file.getFile().replaceWithText("not read: only its existence is checked");
+
+                expect(!p.importAudioFile(1, file.getFile(), false));
+                expect(p.canImportInto(0));
+
+                p.pushCommand(Cmd::RecPlay, 0);
+                h.run(h.blocksFor(0.5));
+                p.pushCommand(Cmd::RecPlay, 0);
+                h.run(2);
+                expect(p.canImportInto(1));
+
+                p.pushCommand(Cmd::RecPlay, 1);
+                h.run(h.blocksFor(0.25));
+                expect(!p.canImportInto(1)); // recording
+                p.pushCommand(Cmd::RecPlay, 1);
+                h.run(2);
+                expect(!p.importAudioFile(0, file.getFile(), false));
+                expect(p.canImportInto(2));
+            }
+        }
+    };
+
+    static TrackCommandTests trackCommandTests;
+}
+
+int main()
+{
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    juce::UnitTestRunner runner;
+    runner.setAssertOnFailure(false);
+    runner.runTestsInCategory("Processor");
+
+    int failures = 0;
+    for (int i = 0; i < runner.getNumResults(); ++i)
+        failures += runner.getResult(i)->failures;
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+#include "RealtimeGuard.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__GLIBC__)
+ #include <dlfcn.h>
+ #include <execinfo.h>
+ #include <pthread.h>
+ #include <unistd.h>
+
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+}
+
+namespace
+{
+    enum class Kind { Allocation, Lock };
+
+    constexpr int maxReports = 16;
+    constexpr int maxFrames = 32;
+
+    std::atomic<int> action { (int)RealtimeGuard::Action::Count };
+    std::atomic<long long> numAllocations { 0 }, numLocks { 0 };
+
+    // Call sites already reported (hash of the innermost frames: operator new and the
+    // container code above malloc are shared by every caller)
+    std::atomic<size_t> reportedSites[maxReports];
+    std::atomic<int> numReported { 0 };
+
+    thread_local int realtimeDepth = 0;
+    thread_local bool inGuard = false; // reporting allocates: don't recurse
+
+    void report(Kind kind)
+    {
+        void* frames[maxFrames];
+        const int numFrames = backtrace(frames, maxFrames);
+
+        size_t site = 0;
+        for (int i = 2; i < std::min(numFrames, 8); ++i)
+            site = site * 31 + (size_t)frames[i];
+
+        for (int i = 0; i < std::min(numReported.load(), maxReports); ++i)
+            if (reportedSites[i].load() == site)
+                return;
+
+        const int slot = numReported.fetch_add(1);
+        if (slot >= maxReports)
+            return;
+        reportedSites[slot].store(site);
+
+        char header[128];
+        const int length = std::snprintf(header, sizeof(header), "\n*** realtime violation: %s on a realtime thread\n",
+                                         kind == Kind::Allocation ? "heap allocation" : "blocking lock");
+        (void)!write(STDERR_FILENO, header, (size_t)length);
+        backtrace_symbols_fd(frames + 2, numFrames - 2, STDERR_FILENO); // skip the guard's own frames
+    }
+
+    /** The next definition of a function (libc's), looked up on first use. */
+    template <typename Function>
+    Function next(std::atomic<void*>& cached, const char* name)
+    {
+        auto* function = cached.load(std::memory_order_relaxed);
+        if (function == nullptr)
+        {
+            function = dlsym(RTLD_NEXT, name);
+            cached.store(function, std::memory_order_relaxed);
+        }
+        return reinterpret_cast<Function>(function);
+    }
+
+    std::atomic<void*> mutexLock { nullptr }, rwlockRead { nullptr }, rwlockWrite { nullptr };
+
+    __attribute__((noinline)) void check(Kind kind)
+    {
+        if (realtimeDepth == 0 || inGuard)
+            return;
+
+        (kind == Kind::Allocation ? numAllocations : numLocks).fetch_add(1, std::memory_order_relaxed);
+
+        const auto mode = (RealtimeGuard::Action)action.load(std::memory_order_relaxed);
+        if (mode == RealtimeGuard::Action::Count)
+            return;
+
+        inGuard = true;
+        report(kind);
+        if (mode == RealtimeGuard::Action::Abort)
+            std::abort();
+        inGuard = false;
+    }
+}
+
+extern "C"
+{
+    void* malloc(size_t size) noexcept                       { check(Kind::Allocation); return __libc_malloc(size); }
+    void* calloc(size_t count, size_t size) noexcept         { check(Kind::Allocation); return __libc_calloc(count, size); }
+    void* realloc(void* ptr, size_t size) noexcept           { check(Kind::Allocation); return __libc_realloc(ptr, size); }
+    void* memalign(size_t align, size_t size) noexcept       { check(Kind::Allocation); return __libc_memalign(align, size); }
+    void* aligned_alloc(size_t align, size_t size) noexcept  { check(Kind::Allocation); return __libc_memalign(align, size); }
+
+    int posix_memalign(void** ptr, size_t align, size_t size) noexcept
+    {
+        check(Kind::Allocation);
+        *ptr = __libc_memalign(align, size);
+        return *ptr != nullptr ? 0 : 12; // ENOMEM
+    }
+
+    // Blocking acquisitions only: trylock never waits
+    int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+    {
+        check(Kind::Lock);
+        return next<int (*)(pthread_mutex_t*)>(mutexLock, "pthread_mutex_lock")(mutex);
+    }
+
+    int pthread_rwlock_rdlock(pthread_rwlock_t* lock) noexcept
+    {
+        check(Kind::Lock);
+        return next<int (*)(pthread_rwlock_t*)>(rwlockRead, "pthread_rwlock_rdlock")(lock);
+    }
+
+    int pthread_rwlock_wrlock(pthread_rwlock_t* lock) noexcept
+    {
+        check(Kind::Lock);
+        return next<int (*)(pthread_rwlock_t*)>(rwlockWrite, "pthread_rwlock_wrlock")(lock);
+    }
+}
+
+bool RealtimeGuard::isAvailable() { return true; }
+
+void RealtimeGuard::setAction(Action newAction)
+{
+    // backtrace() loads libgcc on its first call: do it here, not on a realtime thread
+    void* frames[1];
+    backtrace(frames, 1);
+    action.store((int)newAction);
+}
+
+RealtimeGuard::Totals RealtimeGuard::getTotals()
+{
+    return { numAllocations.load(), numLocks.load() };
+}
+
+RealtimeGuard::ScopedRealtime::ScopedRealtime()  { ++realtimeDepth; }
+RealtimeGuard::ScopedRealtime::~ScopedRealtime() { --realtimeDepth; }
+
+#else
+
+bool RealtimeGuard::isAvailable() { return false; }
+void RealtimeGuard::setAction(Action) {}
+RealtimeGuard::Totals RealtimeGuard::getTotals() { return {}; }
+RealtimeGuard::ScopedRealtime::ScopedRealtime() {}
+RealtimeGuard::ScopedRealtime::~ScopedRealtime() {}
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+/**
+    Realtime-safety checks for the test harness (Linux / glibc only).
+
+    RealtimeGuard.cpp interposes the malloc family (operator new ends up there too)
+    and the blocking pthread lock calls. Inside a ScopedRealtime, on any thread, each
+    call counts as a violation; in Report mode the first few distinct ones print a
+    stack trace to stderr, in Abort mode the first one aborts (for a debugger or CI).
+
+    Never link this into the plugin: it replaces the host's allocator entry points.
+    Targets that link it define SIMPLELOOPER_RT_GUARD=1, so the render workers mark
+    their tasks as realtime too (RenderWorkers.cpp).
+*/
+namespace RealtimeGuard
+{
+    enum class Action
+    {
+        Count,   // counters only (benchmark)
+        Report,  // counters, plus a stack trace per new call site
+        Abort    // stack trace, then abort()
+    };
+
+    struct Totals
+    {
+        long long allocations = 0;
+        long long locks = 0;
+    };
+
+    /** False where the interposition is not compiled (not glibc): everything counts zero. */
+    bool isAvailable();
+
+    void setAction(Action action);
+
+    /** Violations on every thread since the start of the process. */
+    Totals getTotals();
+
+    /** Marks the calling thread as realtime for the scope (nests). */
+    struct ScopedRealtime
+    {
+        ScopedRealtime();
+        ~ScopedRealtime();
+
+        ScopedRealtime(const ScopedRealtime&) = delete;
+        ScopedRealtime& operator=(const ScopedRealtime&) = delete;
+    };
+}
@@ -0,0 +1,108 @@
+#include "AudioImport.h"
+
+namespace AudioImport
+{
+    static constexpr int blockFrames = 1 << 15;
+
+    static std::unique_ptr<juce::AudioFormatReader> createReader(const juce::File& file)
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+        return std::unique_ptr<juce::AudioFormatReader>(formats.createReaderFor(file));
+    }
+
+    juce::String getWildcard()
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+        return formats.getWildcardForAllFormats();
+    }
+
+    bool probe(const juce::File& file, FileInfo& info)
+    {
+        auto reader = createReader(file);
+        if (reader == nullptr || reader->sampleRate <= 0.0 || reader->lengthInSamples <= 0 || reader->numChannels == 0)
+            return false;
+
+        info.sampleRate  = reader->sampleRate;
+        info.length      = reader->lengthInSamples;
+        info.numChannels = (int)reader->numChannels;
+        return true;
+    }
+
+    juce::int64 getConvertedLength(const FileInfo& info, double sampleRate)
+    {
+        if (info.sampleRate == sampleRate)
+            return info.length;
+        return (juce::int64)std::ceil((double)info.length * sampleRate / info.sampleRate);
+    }
+
+    bool decode(const juce::File& file, double sampleRate, juce::AudioBuffer<float>& audio, int numFrames)
+    {
+        auto reader = createReader(file);
+        if (reader == nullptr || reader->sampleRate <= 0.0 || sampleRate <= 0.0)
+            return false;
+
+        // The reader fills two channels at most (both from a mono file)
+        audio.clear(0, numFrames);
+        juce::AudioBuffer<float> dest(audio.getArrayOfWritePointers(), juce::jmin(2, audio.getNumChannels()), numFrames);
+        const int numChannels = dest.getNumChannels();
+
+        if (reader->sampleRate == sampleRate)
+        {
+            const int numInput = (int)juce::jmin((juce::int64)numFrames, reader->lengthInSamples);
+            for (int start = 0; start < numInput; start += blockFrames)
+            {
+                if (juce::Thread::currentThreadShouldExit()
+                    || !reader->read(&dest, start, juce::jmin(blockFrames, numInput - start), start, true, true))
+                    return false;
+            }
+            return true;
+        }
+
+        // Converted block by block. The interpolators keep their own history, so each
+        // block only needs the input it consumes (plus a little look-ahead).
+        const double ratio = reader->sampleRate / sampleRate; // file frames per output frame
+        const int numOutput = (int)juce::jmin((juce::int64)numFrames,
+                                              getConvertedLength({ reader->sampleRate, reader->lengthInSamples, 0 }, sampleRate));
+        constexpr int lookAhead = 2;
+
+        juce::AudioBuffer<float> input(numChannels, blockFrames);
+        juce::AudioBuffer<float> output(numChannels, (int)((blockFrames - lookAhead) / ratio) + 1);
+        std::vector<juce::WindowedSincInterpolator> interpolators((size_t)numChannels);
+
+        // The filter delays its output: the first outputs are dropped
+        int produced = -juce::roundToInt(juce::WindowedSincInterpolator::getBaseLatency() / ratio);
+        int available = 0;
+        juce::int64 readPos = 0;
+
+        while (produced < numOutput)
+        {
+            if (juce::Thread::currentThreadShouldExit())
+                return false;
+
+            // Top the input up (past the end of the file the reader gives silence, which
+            // flushes the filter)
+            const int numRead = input.getNumSamples() - available;
+            if (!reader->read(&input, available, numRead, readPos, true, true))
+                return false;
+            readPos += numRead;
+            available += numRead;
+
+            const int numOut = juce::jmin(output.getNumSamples(), numOutput - produced, (int)((available - lookAhead) / ratio));
+            int used = 0;
+            for (int ch = 0; ch < numChannels; ++ch)
+                used = interpolators[(size_t)ch].process(ratio, input.getReadPointer(ch), output.getWritePointer(ch), numOut);
+
+            const int first = juce::jmax(0, -produced);
+            for (int ch = 0; first < numOut && ch < numChannels; ++ch)
+                dest.copyFrom(ch, produced + first, output, ch, first, numOut - first);
+            produced += numOut;
+
+            available -= used;
+            for (int ch = 0; ch < numChannels; ++ch)
+                std::memmove(input.getWritePointer(ch), input.getReadPointer(ch) + used, (size_t)available * sizeof(float));
+        }
+        return true;
+    }
+}
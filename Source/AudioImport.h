@@ -0,0 +1,36 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Audio files imported into tracks (SimpleLooperAudioProcessor::importAudioFile).
+
+    The session loader thread decodes the file in blocks, straight into the buffer
+    the track is then replaced from, and converts it to the session's sample rate
+    with a windowed sinc interpolator: nothing holds the whole file but that buffer.
+    At the session's rate the samples are copied as they are.
+*/
+namespace AudioImport
+{
+    struct FileInfo
+    {
+        double sampleRate = 0.0;
+        juce::int64 length = 0;     // frames at sampleRate
+        int numChannels = 0;
+    };
+
+    /** File chooser pattern for every format the import reads. */
+    juce::String getWildcard();
+
+    /** Reads the file's header only. False if no format reads the file. */
+    bool probe(const juce::File& file, FileInfo& info);
+
+    /** The file's length once converted to sampleRate. */
+    juce::int64 getConvertedLength(const FileInfo& info, double sampleRate);
+
+    /** Decodes the file into audio[0, numFrames), converted to sampleRate. Frames past
+        the end of the file are silent, a mono file fills both channels and channels
+        beyond the second are dropped. False if the file can't be read, or if the
+        calling thread is asked to exit. */
+    bool decode(const juce::File& file, double sampleRate, juce::AudioBuffer<float>& audio, int numFrames);
+}
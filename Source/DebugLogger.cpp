@@ -0,0 +1,184 @@
+#include "DebugLogger.h"
+
+namespace
+{
+    enum class TraceLevel { Info, Warning, Error };
+
+    struct TraceEventInfo
+    {
+        TraceLevel level;
+        const char* text;
+        const char* argNames[4];
+    };
+
+    const TraceEventInfo eventInfo[] =
+    {
+       #define SIMPLELOOPER_TRACE_INFO(id, level, text, a0, a1, a2, a3) { TraceLevel::level, text, { a0, a1, a2, a3 } },
+        SIMPLELOOPER_TRACE_EVENTS(SIMPLELOOPER_TRACE_INFO)
+       #undef SIMPLELOOPER_TRACE_INFO
+    };
+
+    juce::String formatArg(double value)
+    {
+        // Sample counts and lengths print as integers, the rest with 3 decimals
+        if (value == std::floor(value) && std::abs(value) < 1.0e15)
+            return juce::String((juce::int64)value);
+        return juce::String(value, 3);
+    }
+}
+
+DebugLogger& DebugLogger::getInstance()
+{
+    static DebugLogger instance;
+    return instance;
+}
+
+DebugLogger::DebugLogger()
+{
+    for (size_t i = 0; i < ring.size(); ++i)
+        ring[i].sequence.store(i);
+
+   #if JUCE_DEBUG
+    enabled.store(true);
+   #endif
+}
+
+DebugLogger::~DebugLogger()
+{
+    writer.stopThread(2000);
+}
+
+//==============================================================================
+void DebugLogger::initialize()
+{
+    const juce::ScopedLock lock(usersLock);
+    if (numUsers++ > 0) return;
+
+    auto file = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory)
+                    .getChildFile("SimpleLooper_Debug.log");
+    logFile = std::make_unique<juce::FileOutputStream>(file);
+    if (!logFile->openedOk())
+        logFile.reset();
+
+    sessionStartTicks = juce::Time::getHighResolutionTicks();
+    if (logFile != nullptr)
+        logFile->writeText("======== NEW SESSION " + juce::Time::getCurrentTime().toString(true, true)
+                           + " ========\n", false, false, nullptr);
+
+    writer.startThread(juce::Thread::Priority::background);
+}
+
+void DebugLogger::shutdown()
+{
+    const juce::ScopedLock lock(usersLock);
+    if (numUsers == 0 || --numUsers > 0) return;
+
+    writer.stopThread(2000);
+    writePending();
+    logFile.reset();
+}
+
+//==============================================================================
+void DebugLogger::push(TraceEvent event, int track, const double* values, int numValues)
+{
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+
+    for (;;)
+    {
+        slot = &ring[pos & (ringSize - 1)];
+        const size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        const auto diff = (std::ptrdiff_t)sequence - (std::ptrdiff_t)pos;
+
+        if (diff == 0)
+        {
+            // Free slot for this position: claim it (pos is reloaded on failure)
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            numDropped.fetch_add(1, std::memory_order_relaxed); // full: the writer is behind
+            return;
+        }
+        else
+        {
+            pos = enqueuePos.load(std::memory_order_relaxed);   // another producer got there first
+        }
+    }
+
+    auto& record = slot->record;
+    record.ticks      = juce::Time::getHighResolutionTicks();
+    record.sampleTime = sampleClock.load(std::memory_order_relaxed);
+    record.event      = event;
+    record.track      = (juce::int16)track;
+    record.numArgs    = (juce::uint8)numValues;
+    for (int i = 0; i < numValues; ++i)
+        record.args[i] = values[i];
+
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+bool DebugLogger::pop(TraceRecord& record)
+{
+    auto& slot = ring[dequeuePos & (ringSize - 1)];
+    const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if ((std::ptrdiff_t)sequence - (std::ptrdiff_t)(dequeuePos + 1) < 0)
+        return false; // empty (or the next record is still being written)
+
+    record = slot.record;
+    slot.sequence.store(dequeuePos + ringSize, std::memory_order_release);
+    ++dequeuePos;
+    return true;
+}
+
+void DebugLogger::writePending()
+{
+    TraceRecord record;
+    while (pop(record))
+    {
+        const auto& info = eventInfo[(size_t)record.event];
+        const double ms = 1000.0 * juce::Time::highResolutionTicksToSeconds(record.ticks - sessionStartTicks);
+
+        juce::String line = "[" + juce::String(ms, 3) + " ms]";
+        if (record.sampleTime >= 0)
+            line << " @" << juce::String(record.sampleTime);
+        if (info.level == TraceLevel::Warning)
+            line << " !!! WARNING:";
+        else if (info.level == TraceLevel::Error)
+            line << " *** ERROR:";
+        if (record.track >= 0)
+            line << " TRACK " << juce::String(record.track + 1) << ":";
+        line << " " << info.text;
+
+        for (int i = 0; i < record.numArgs; ++i)
+            if (info.argNames[i] != nullptr)
+                line << (i == 0 ? " | " : " ") << info.argNames[i] << "=" << formatArg(record.args[i]);
+
+        if (logFile != nullptr)
+            logFile->writeText(line + "\n", false, false, nullptr);
+        DBG(line);
+    }
+
+    const auto dropped = numDropped.load();
+    if (dropped != numDroppedReported)
+    {
+        juce::String line = "!!! " + juce::String((int)(dropped - numDroppedReported)) + " trace records dropped";
+        numDroppedReported = dropped;
+        if (logFile != nullptr)
+            logFile->writeText(line + "\n", false, false, nullptr);
+        DBG(line);
+    }
+
+    if (logFile != nullptr)
+        logFile->flush();
+}
+
+void DebugLogger::Writer::run()
+{
+    while (!threadShouldExit())
+    {
+        logger.writePending();
+        wait(50);
+    }
+}
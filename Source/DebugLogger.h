@@ -1,227 +1,167 @@
 #pragma once
 
 #include <JuceHeader.h>
-#include <fstream>
-#include <sstream>
-#include <memory>
+#include <array>
+#include <atomic>
 
-// ACTIVER/DSACTIVER LE LOGGER
-#define ENABLE_DEBUG_LOGGER 0  // 1 = activ, 0 = dsactiv (DSACTIV pour viter les crashes)
+// Trace logger, compiled in by default. Recording is switched on at runtime
+// (setEnabled); while it is off, a trace costs one relaxed atomic load.
+#ifndef ENABLE_DEBUG_LOGGER
+ #define ENABLE_DEBUG_LOGGER 1
+#endif
 
-#if ENABLE_DEBUG_LOGGER
+/**
+    Every traced event: id, severity, text, then the names of up to four numeric
+    arguments (nullptr = unused). Adding an event is one line here.
+*/
+#define SIMPLELOOPER_TRACE_EVENTS(X) \
+    X(PluginCreated,      Info,    "PLUGIN CREATED",                 "tracks",     nullptr,        nullptr,     nullptr)      \
+    X(PrepareToPlay,      Info,    "PREPARE TO PLAY",                "sampleRate", "blockSize",    nullptr,     nullptr)      \
+    X(TrackPrepared,      Info,    "PREPARED",                       nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(PrepareComplete,    Info,    "PREPARATION COMPLETE",           nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(FirstLoopCompleted, Info,    "FIRST LOOP COMPLETED",           "masterLen",  "bpm",          "globalPos", nullptr)      \
+    X(ResetAll,           Info,    "RESET ALL",                      nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(TrackReset,         Info,    "RESET",                          nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(CommandDropped,     Warning, "COMMAND QUEUE FULL, DROPPED",    "command",    nullptr,        nullptr,     nullptr)      \
+    X(BounceStarted,      Info,    "BOUNCE JOB STARTED",             "len",        nullptr,        nullptr,     nullptr)      \
+    X(BounceInstalled,    Info,    "BOUNCE INSTALLED",               "len",        "latencyMs",    nullptr,     nullptr)      \
+    X(AfterLoopStarted,   Info,    "AFTER LOOP JOB STARTED",         "captureLen", "mult",         "overdub",   nullptr)      \
+    X(AfterLoopInstalled, Info,    "AFTER LOOP INSTALLED",           "len",        nullptr,        nullptr,     nullptr)      \
+    X(AfterLoopDropped,   Warning, "AFTER LOOP DROPPED, TRACK CHANGED", nullptr,   nullptr,        nullptr,     nullptr)      \
+    X(RecordingStarted,   Info,    "RECORDING STARTED",              "targetMult", nullptr,        nullptr,     nullptr)      \
+    X(SlaveRecStart,      Info,    "SLAVE REC START",                "offset",     "globalSample", "masterLen", "targetMult") \
+    X(SlaveRecFinished,   Info,    "SLAVE REC FINISHED",             "recorded",   "loopLen",      "mult",      "offset")     \
+    X(MasterRecToPlay,    Info,    "MASTER REC->PLAY",               "len",        "playbackPos",  nullptr,     nullptr)      \
+    X(SlaveRecToPlay,     Info,    "SLAVE REC->PLAY",                "len",        "recorded",     "targetMult", nullptr)     \
+    X(PlaybackReset,      Info,    "PLAYBACK POSITION RESET",        nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(StatePlaying,       Info,    "STATE = PLAYING",                nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(PlayWithoutLoop,    Error,   "CANNOT PLAY, LOOP LENGTH IS 0",  nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(RenderTrackLate,    Warning, "TRACK RENDER LATE, SILENCED",    nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(ClearedContentHeld, Warning, "CLEARED LOOP NOT RELEASED YET, IGNORED", nullptr, nullptr,      nullptr,     nullptr)      \
+    X(LoopFromMix,        Info,    "LOOP FROM MIX",                  "len",        "offset",       "globalSample", nullptr)   \
+    X(LoopFromMixNoPages, Warning, "LOOP FROM MIX, PAGE POOL EXHAUSTED", nullptr,  nullptr,        nullptr,     nullptr)      \
+    X(OverdubFromBuffer,  Info,    "OVERDUB FROM BUFFER",            "inputLen",   "writeStart",   "loopLen",   nullptr)      \
+    X(FxReplaceArmed,     Info,    "FX REPLACE ARMED",               "loopLen",    nullptr,        nullptr,     nullptr)      \
+    X(FxReplaceApplied,   Info,    "FX REPLACE APPLIED",             "loopLen",    nullptr,        nullptr,     nullptr)      \
+    X(FxReplaceNoPages,   Warning, "FX REPLACE CANCELLED, PAGE POOL EXHAUSTED", nullptr, nullptr,   nullptr,     nullptr)      \
+    X(ReplaceBegin,       Info,    "PROGRESSIVE REPLACE BEGIN",      "len",        nullptr,        nullptr,     nullptr)      \
+    X(ReplaceComplete,    Info,    "PROGRESSIVE REPLACE COMPLETE",   nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(SessionSaved,       Info,    "SESSION SAVED",                  "tracks",     "bytes",        nullptr,     nullptr)      \
+    X(SessionLoaded,      Info,    "SESSION LOADED",                 "tracks",     "bytes",        nullptr,     nullptr)      \
+    X(SessionRateMismatch, Warning, "SESSION SAMPLE RATE DIFFERS",   "savedRate",  "sampleRate",   nullptr,     nullptr)      \
+    X(SessionTrackInstalled, Info,  "SESSION TRACK INSTALLED",       "len",        nullptr,        nullptr,     nullptr)      \
+    X(SessionTrackUnreadable, Error, "SESSION TRACK UNREADABLE",     nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(AudioImportFailed,  Error,   "AUDIO FILE IMPORT FAILED",       nullptr,      nullptr,        nullptr,     nullptr)      \
+    X(StemsExported,      Info,    "STEMS EXPORTED",                 "files",      "ms",           nullptr,     nullptr)      \
+    X(StemExportFailed,   Error,   "STEM EXPORT FAILED",             nullptr,      nullptr,        nullptr,     nullptr)
+
+enum class TraceEvent : juce::uint16
+{
+   #define SIMPLELOOPER_TRACE_ENUM(id, level, text, a0, a1, a2, a3) id,
+    SIMPLELOOPER_TRACE_EVENTS(SIMPLELOOPER_TRACE_ENUM)
+   #undef SIMPLELOOPER_TRACE_ENUM
+    NumEvents
+};
+
+/** One trace, as pushed by any thread. Formatted only by the writer thread. */
+struct TraceRecord
+{
+    juce::int64 ticks = 0;        // Time::getHighResolutionTicks() when pushed
+    juce::int64 sampleTime = -1;  // processor sample clock (start of the segment being processed)
+    double args[4] {};
+    TraceEvent event = TraceEvent::PluginCreated;
+    juce::int16 track = -1;       // -1 = not about one track
+    juce::uint8 numArgs = 0;
+};
 
 /**
- * Singleton Logger pour tracer tous les vnements du Looper
- * crit dans un fichier avec timestamps pour dbogage
- */
+    Realtime-safe trace logger.
+
+    - trace() is lock-free and allocation-free, callable from any thread (audio thread,
+      render workers, job worker, message thread): it stamps a fixed-size binary record
+      and pushes it into a bounded multi-producer ring. When the ring is full the record
+      is dropped and counted, the caller never waits.
+    - A background writer thread drains the ring, formats the records and appends them
+      to Documents/SimpleLooper_Debug.log (and DBG).
+    - Shared by every plugin instance: each processor calls initialize() / shutdown(),
+      the writer runs while at least one is alive.
+*/
 class DebugLogger
 {
 public:
-    static DebugLogger& getInstance()
-    {
-        static DebugLogger instance;
-        return instance;
-    }
+    static DebugLogger& getInstance();
 
-    // Log un vnement simple
-    void log(const juce::String& message)
-    {
-        if (!isEnabled) return;
-        
-        auto timestamp = juce::Time::getCurrentTime();
-        auto timestampStr = timestamp.formatted("%H:%M:%S.%f");
-        
-        juce::String fullMessage = "[" + timestampStr + "] " + message;
-        
-        // Thread-safe write
-        const juce::ScopedLock lock(logLock);
-        
-        if (logFile.is_open())
-        {
-            logFile << fullMessage.toStdString() << std::endl;
-            logFile.flush(); // Force write immdiatement
-        }
-        
-        // Aussi dans la console pour debug temps rel
-        DBG(fullMessage);
-    }
-    
-    // Log un vnement avec track ID
-    void logTrack(int trackID, const juce::String& event, const juce::String& details = "")
-    {
-        juce::String msg = "TRACK " + juce::String(trackID) + ": " + event;
-        if (details.isNotEmpty())
-            msg += " | " + details;
-        log(msg);
-    }
-    
-    // Log un changement d'tat
-    void logStateChange(int trackID, const juce::String& oldState, const juce::String& newState)
-    {
-        logTrack(trackID, "STATE CHANGE", oldState + " -> " + newState);
-    }
-    
-    // Log les positions et longueurs
-    void logPosition(int trackID, int position, int loopLength, int globalPos = -1)
-    {
-        juce::String details = "pos=" + juce::String(position) + 
-                              " len=" + juce::String(loopLength);
-        if (globalPos >= 0)
-            details += " global=" + juce::String(globalPos);
-        logTrack(trackID, "POSITION", details);
-    }
-    
-    // Log les actions utilisateur (boutons)
-    void logButton(const juce::String& buttonName, int trackID = -1)
-    {
-        juce::String msg = "BUTTON: " + buttonName;
-        if (trackID >= 0)
-            msg += " (Track " + juce::String(trackID) + ")";
-        log(msg);
-    }
-    
-    // Log les valeurs importantes
-    void logValue(const juce::String& name, double value)
-    {
-        log("VALUE: " + name + " = " + juce::String(value, 3));
-    }
-    
-    // Log une erreur ou warning
-    void logError(const juce::String& error)
-    {
-        log("*** ERROR: " + error);
-    }
-    
-    void logWarning(const juce::String& warning)
-    {
-        log("!!! WARNING: " + warning);
-    }
-    
-    // Sparateurs pour lisibilit
-    void logSeparator(const juce::String& title = "")
-    {
-        if (title.isEmpty())
-            log("========================================");
-        else
-            log("======== " + title + " ========");
-    }
-    
-    // Activer/dsactiver le logging
-    void setEnabled(bool enabled) { isEnabled = enabled; }
-    bool getEnabled() const { return isEnabled; }
-    
-    // Initialiser explicitement le logger ( appeler aprs l'initialisation de JUCE)
-    void initialize()
-    {
-        if (isInitialized) return;
-        
-        try
-        {
-            // Crer le fichier de log dans le dossier Documents
-            auto documentsDir = juce::File::getSpecialLocation(juce::File::userDocumentsDirectory);
-            auto logFileObj = documentsDir.getChildFile("SimpleLooper_Debug.log");
-            logFilePath = logFileObj.getFullPathName();
-            
-            logFile.open(logFilePath.toStdString(), std::ios::out | std::ios::app);
-            
-            if (logFile.is_open())
-            {
-                isInitialized = true;
-                logSeparator("NEW SESSION");
-                log("Log file: " + logFilePath);
-                log("Start time: " + juce::Time::getCurrentTime().toString(true, true));
-            }
-        }
-        catch (...)
-        {
-            isInitialized = false;
-        }
-    }
-    
-    // Fermer et rouvrir le fichier (utile pour vider le buffer)
-    void flush()
-    {
-        const juce::ScopedLock lock(logLock);
-        if (logFile.is_open())
-            logFile.flush();
-    }
-    
-    // Clear le fichier log
-    void clearLog()
+    //==============================================================================
+    /** MESSAGE THREAD: opens the log file and starts the writer (first user only). */
+    void initialize();
+    /** MESSAGE THREAD: the last user stops the writer after it has written everything. */
+    void shutdown();
+
+    /** Records are only taken while enabled (on by default in debug builds). */
+    void setEnabled(bool shouldBeEnabled) { enabled.store(shouldBeEnabled); }
+    bool getEnabled() const { return enabled.load(); }
+
+    /** AUDIO: sample clock stamped on the following records. */
+    void setSampleTime(juce::int64 sampleTime) { sampleClock.store(sampleTime, std::memory_order_relaxed); }
+
+    /** Records dropped because the ring was full. */
+    juce::uint32 getNumDropped() const { return numDropped.load(); }
+
+    //==============================================================================
+    /** ANY THREAD: up to four numeric arguments, named in SIMPLELOOPER_TRACE_EVENTS. */
+    template <typename... Args>
+    void trace(TraceEvent event, int track, Args... args)
     {
-        const juce::ScopedLock lock(logLock);
-        if (logFile.is_open())
-        {
-            logFile.close();
-            logFile.open(logFilePath.toStdString(), std::ios::out | std::ios::trunc);
-            log("=== LOG CLEARED ===");
-        }
+        static_assert(sizeof...(Args) <= 4, "a trace record holds at most four arguments");
+        if (!enabled.load(std::memory_order_relaxed)) return;
+
+        const double values[] = { static_cast<double>(args)..., 0.0 };
+        push(event, track, values, (int)sizeof...(Args));
     }
 
 private:
-DebugLogger()
-{
-    // Ne pas initialiser ici - attendre l'appel explicite  initialize()
-    // pour viter les problmes avec l'ordre d'initialisation
-}
-    
-~DebugLogger()
-{
-    if (logFile.is_open())
+    DebugLogger();
+    ~DebugLogger();
+
+    void push(TraceEvent event, int track, const double* values, int numValues);
+    bool pop(TraceRecord& record);   // writer thread only
+    void writePending();             // writer thread (or shutdown, once it has stopped)
+
+    // Bounded MPMC ring (sequence number per slot): producers claim a slot with one CAS
+    static constexpr int ringSize = 4096;
+    struct Slot
     {
-        try
-        {
-            log("=== SESSION END ===");
-        }
-        catch (...) {}
-        logFile.close();
-    }
-}
-    
-    
-// Pas de copie
-DebugLogger(const DebugLogger&) = delete;
-DebugLogger& operator=(const DebugLogger&) = delete;
-    
-std::ofstream logFile;
-juce::String logFilePath;
-juce::CriticalSection logLock;
-bool isEnabled = true;
-bool isInitialized = false;
-};
+        std::atomic<size_t> sequence { 0 };
+        TraceRecord record;
+    };
+    std::array<Slot, ringSize> ring;
+    std::atomic<size_t> enqueuePos { 0 };
+    size_t dequeuePos = 0;
 
-// Macros pratiques pour logger
-#define LOG(msg) DebugLogger::getInstance().log(msg)
-#define LOG_TRACK(trackID, event, details) DebugLogger::getInstance().logTrack(trackID, event, details)
-#define LOG_STATE(trackID, old, new) DebugLogger::getInstance().logStateChange(trackID, old, new)
-#define LOG_POS(trackID, pos, len, global) DebugLogger::getInstance().logPosition(trackID, pos, len, global)
-#define LOG_BUTTON(name, trackID) DebugLogger::getInstance().logButton(name, trackID)
-#define LOG_VALUE(name, val) DebugLogger::getInstance().logValue(name, val)
-#define LOG_ERROR(msg) DebugLogger::getInstance().logError(msg)
-#define LOG_WARNING(msg) DebugLogger::getInstance().logWarning(msg)
-#define LOG_SEP(title) DebugLogger::getInstance().logSeparator(title)
+    std::atomic<bool> enabled { false };
+    std::atomic<juce::int64> sampleClock { -1 };
+    std::atomic<juce::uint32> numDropped { 0 };
+    juce::uint32 numDroppedReported = 0;
 
-#else
+    struct Writer : public juce::Thread
+    {
+        explicit Writer(DebugLogger& l) : juce::Thread("SimpleLooper Trace"), logger(l) {}
+        void run() override;
+        DebugLogger& logger;
+    };
+    Writer writer { *this };
 
-// Logger dsactiv - Macros vides qui ne font rien
-#define LOG(msg) ((void)0)
-#define LOG_TRACK(trackID, event, details) ((void)0)
-#define LOG_STATE(trackID, old, new) ((void)0)
-#define LOG_POS(trackID, pos, len, global) ((void)0)
-#define LOG_BUTTON(name, trackID) ((void)0)
-#define LOG_VALUE(name, val) ((void)0)
-#define LOG_ERROR(msg) ((void)0)
-#define LOG_WARNING(msg) ((void)0)
-#define LOG_SEP(title) ((void)0)
-
-// Classe vide pour viter les erreurs de compilation
-class DebugLogger
-{
-public:
-    static DebugLogger& getInstance() { static DebugLogger instance; return instance; }
-    void initialize() {}
-    void log(const juce::String&) {}
-    void setEnabled(bool) {}
+    juce::CriticalSection usersLock;
+    int numUsers = 0;
+    std::unique_ptr<juce::FileOutputStream> logFile;
+    juce::int64 sessionStartTicks = 0;
+
+    JUCE_DECLARE_NON_COPYABLE(DebugLogger)
 };
 
+#if ENABLE_DEBUG_LOGGER
+ /** TRACE(EventId, track, args...): track is -1 for global events. */
+ #define TRACE(event, ...) DebugLogger::getInstance().trace(TraceEvent::event, __VA_ARGS__)
+#else
+ #define TRACE(event, ...) ((void)0)
 #endif
@@ -0,0 +1,116 @@
+#include "DspLoadPanel.h"
+#include "CustomLookAndFeel.h"
+
+DspLoadPanel::DspLoadPanel(DspProfiler& profilerToShow)
+    : profiler(profilerToShow)
+{
+}
+
+DspLoadPanel::~DspLoadPanel()
+{
+    stopTimer();
+    profiler.setEnabled(false);
+}
+
+int DspLoadPanel::getPreferredHeight() const
+{
+    // Header row, the stages, the track rows
+    return expanded ? stripHeight + rowHeight * (1 + DspProfiler::NumStages + maxTrackRows) + 6
+                    : stripHeight;
+}
+
+void DspLoadPanel::setExpanded(bool shouldBeExpanded)
+{
+    expanded = shouldBeExpanded;
+    profiler.setEnabled(expanded);
+
+    if (expanded)
+    {
+        profiler.readReport(report); // start from now
+        startTimerHz(4);
+    }
+    else
+    {
+        stopTimer();
+    }
+
+    if (onExpandedChange)
+        onExpandedChange();
+    repaint();
+}
+
+void DspLoadPanel::mouseDown(const juce::MouseEvent& e)
+{
+    if (e.y < stripHeight)
+        setExpanded(!expanded);
+}
+
+void DspLoadPanel::timerCallback()
+{
+    profiler.readReport(report);
+    repaint();
+}
+
+void DspLoadPanel::paint(juce::Graphics& g)
+{
+    auto area = getLocalBounds().reduced(8, 0);
+
+    g.setColour(Colours_::surface);
+    g.fillRect(getLocalBounds());
+    g.setColour(Colours_::border);
+    g.drawHorizontalLine(0, 0.0f, (float)getWidth());
+
+    // Strip: title, then the total and the overruns while expanded
+    auto strip = area.removeFromTop(stripHeight);
+    g.setFont(juce::FontOptions(11.0f, juce::Font::bold));
+    g.setColour(Colours_::textDim);
+    g.drawText(expanded ? "- DSP LOAD" : "+ DSP LOAD", strip, juce::Justification::centredLeft);
+
+    if (!expanded) return;
+
+    const auto& total = report.stages[DspProfiler::Total];
+    const bool overloaded = total.percentOfBudget > 80.0;
+    g.setColour(overloaded ? Colours_::rec : Colours_::play);
+    g.drawText(juce::String(total.percentOfBudget, 1) + " %   block " + juce::String(report.blockUs, 0)
+                   + " us   overruns " + juce::String(report.overruns),
+               strip.withTrimmedLeft(90), juce::Justification::centredLeft);
+
+    // Table
+    auto columns = [&](juce::Rectangle<int> row, const juce::String& name, const juce::String& mean,
+                       const juce::String& p99, const juce::String& max, const juce::String& percent)
+    {
+        g.drawText(name, row.removeFromLeft(140), juce::Justification::centredLeft);
+        g.drawText(mean, row.removeFromLeft(80), juce::Justification::centredRight);
+        g.drawText(p99, row.removeFromLeft(80), juce::Justification::centredRight);
+        g.drawText(max, row.removeFromLeft(80), juce::Justification::centredRight);
+        g.drawText(percent, row.removeFromLeft(80), juce::Justification::centredRight);
+    };
+    auto statsRow = [&](const juce::String& name, const DspProfiler::Stats& stats)
+    {
+        columns(area.removeFromTop(rowHeight), name, juce::String(stats.meanUs, 1), juce::String(stats.p99Us, 1),
+                juce::String(stats.maxUs, 1), juce::String(stats.percentOfBudget, 1) + " %");
+    };
+
+    g.setFont(juce::FontOptions(10.0f, juce::Font::bold));
+    g.setColour(Colours_::textDim);
+    columns(area.removeFromTop(rowHeight), "STAGE", "MEAN us", "P99 us", "MAX us", "BUDGET");
+
+    g.setFont(juce::FontOptions(11.0f));
+    for (int stage = 0; stage < DspProfiler::NumStages; ++stage)
+    {
+        g.setColour(stage == DspProfiler::Total ? Colours_::textPrimary : Colours_::textDim);
+        statsRow(DspProfiler::getStageName(stage), report.stages[(size_t)stage]);
+    }
+
+    // Heaviest tracks by mean
+    std::vector<int> order((size_t)report.tracks.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = (int)i;
+    const auto numShown = juce::jmin((int)order.size(), maxTrackRows);
+    std::partial_sort(order.begin(), order.begin() + numShown, order.end(),
+                      [this](int a, int b) { return report.tracks[(size_t)a].meanUs > report.tracks[(size_t)b].meanUs; });
+
+    g.setColour(Colours_::afterloop);
+    for (int i = 0; i < numShown; ++i)
+        statsRow("Track " + juce::String(order[(size_t)i] + 1), report.tracks[(size_t)order[(size_t)i]]);
+}
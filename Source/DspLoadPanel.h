@@ -0,0 +1,43 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "DspProfiler.h"
+
+/**
+    Collapsible DSP load table at the bottom of the editor.
+
+    Collapsed, it is a one-line strip and the profiler is off. Expanded, it switches
+    the profiler on and shows, four times a second, each processBlock stage (mean,
+    p99 and max in microseconds, share of the block duration), the heaviest tracks
+    and the number of blocks that overran their deadline.
+*/
+class DspLoadPanel  : public juce::Component,
+                      private juce::Timer
+{
+public:
+    explicit DspLoadPanel(DspProfiler& profilerToShow);
+    ~DspLoadPanel() override;
+
+    bool isExpanded() const { return expanded; }
+    int getPreferredHeight() const;
+
+    /** Called after a click on the strip opened or closed the table. */
+    std::function<void()> onExpandedChange;
+
+    void paint(juce::Graphics&) override;
+    void mouseDown(const juce::MouseEvent& e) override;
+
+private:
+    void timerCallback() override;
+    void setExpanded(bool shouldBeExpanded);
+
+    static constexpr int stripHeight = 22;
+    static constexpr int rowHeight = 16;
+    static constexpr int maxTrackRows = 4;
+
+    DspProfiler& profiler;
+    DspProfiler::Report report;
+    bool expanded = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DspLoadPanel)
+};
@@ -0,0 +1,186 @@
+#include "DspProfiler.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+ #if defined(_MSC_VER)
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+const char* DspProfiler::getStageName(int stage)
+{
+    switch (stage)
+    {
+        case InputSnapshot: return "Input snapshot";
+        case RetroWrite:    return "Retro write";
+        case Parameters:    return "Parameters";
+        case Commands:      return "Commands";
+        case Tracks:        return "Tracks";
+        case Mix:           return "Mix";
+        case PendingOps:    return "Pending ops";
+        case MidiClock:     return "MIDI clock";
+        case Total:         return "Total";
+        default:            return "";
+    }
+}
+
+DspProfiler::Cycles DspProfiler::now()
+{
+   #if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    return (Cycles)__rdtsc();
+   #elif defined(__aarch64__) && !defined(_MSC_VER)
+    Cycles value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+   #else
+    return juce::Time::getHighResolutionTicks();
+   #endif
+}
+
+void DspProfiler::prepare(int numTracks, double newSampleRate)
+{
+    sampleRate = newSampleRate > 0.0 ? newSampleRate : 44100.0;
+
+    // Counter rate against the high resolution clock
+    const auto ticks0 = juce::Time::getHighResolutionTicks();
+    const auto cycles0 = now();
+    juce::Thread::sleep(20);
+    const double seconds = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - ticks0);
+    const double cyclesPerSecond = juce::jmax(1.0, (double)(now() - cycles0) / juce::jmax(1.0e-3, seconds));
+
+    cyclesPerSample = cyclesPerSecond / sampleRate;
+    usPerCycle = 1.0e6 / cyclesPerSecond;
+
+    const auto numSeries = (size_t)(NumStages + juce::jmax(0, numTracks));
+    blockCycles.assign(numSeries, 0);
+    series = std::vector<Series>(numSeries);
+
+    numSamples.store(0);
+    numOverruns.store(0);
+    lastNumSamples = 0;
+    active = false;
+}
+
+//==============================================================================
+bool DspProfiler::beginBlock()
+{
+    active = enabled.load(std::memory_order_relaxed) && !series.empty();
+    if (active)
+        std::fill(blockCycles.begin(), blockCycles.end(), 0);
+    return active;
+}
+
+void DspProfiler::endBlock(int blockSamples)
+{
+    if (!active) return;
+    active = false;
+
+    for (size_t i = 0; i < series.size(); ++i)
+        series[i].add(blockCycles[i]);
+
+    numSamples.fetch_add((juce::uint64)blockSamples, std::memory_order_relaxed);
+    if ((double)blockCycles[Total] > cyclesPerSample * blockSamples)
+        numOverruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+//==============================================================================
+int DspProfiler::binOf(Cycles cycles)
+{
+    if (cycles < 8) return (int)juce::jmax((Cycles)0, cycles);
+
+    // Octave of the leading bit, then the 3 bits below it
+    const int octave = juce::jmin(31, std::ilogb((double)cycles));
+    const int sub = (int)((cycles >> (octave - 3)) & 7);
+    return juce::jmin(numBins - 1, octave * 8 + sub);
+}
+
+double DspProfiler::binUpperEdge(int bin)
+{
+    if (bin < 8) return (double)(bin + 1);
+    const int octave = bin / 8, sub = bin % 8;
+    return std::ldexp((double)(8 + sub + 1), octave - 3);
+}
+
+void DspProfiler::Series::add(Cycles cycles)
+{
+    histogram[(size_t)binOf(cycles)].fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add((juce::uint64)juce::jmax((Cycles)0, cycles), std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    auto previous = max.load(std::memory_order_relaxed);
+    while (cycles > previous && !max.compare_exchange_weak(previous, cycles, std::memory_order_relaxed)) {}
+}
+
+DspProfiler::Stats DspProfiler::Series::read(double usPerCycle)
+{
+    Stats stats;
+
+    const auto newCount = count.load(std::memory_order_relaxed);
+    const auto newSum = sum.load(std::memory_order_relaxed);
+    const auto blocks = newCount - lastCount;
+
+    // Histogram of the blocks since the previous read
+    std::array<juce::uint32, numBins> delta {};
+    juce::uint32 total = 0;
+    for (int b = 0; b < numBins; ++b)
+    {
+        const auto value = histogram[(size_t)b].load(std::memory_order_relaxed);
+        delta[(size_t)b] = value - lastHistogram[(size_t)b];
+        lastHistogram[(size_t)b] = value;
+        total += delta[(size_t)b];
+    }
+
+    if (blocks > 0)
+        stats.meanUs = usPerCycle * (double)(newSum - lastSum) / blocks;
+
+    if (total > 0)
+    {
+        const auto target = total - total / 100; // 99th percentile
+        juce::uint32 seen = 0;
+        for (int b = 0; b < numBins; ++b)
+        {
+            seen += delta[(size_t)b];
+            if (seen >= target)
+            {
+                stats.p99Us = usPerCycle * binUpperEdge(b);
+                break;
+            }
+        }
+    }
+
+    stats.maxUs = usPerCycle * (double)max.exchange(0, std::memory_order_relaxed);
+
+    lastCount = newCount;
+    lastSum = newSum;
+    return stats;
+}
+
+void DspProfiler::readReport(Report& report)
+{
+    const auto samples = numSamples.load(std::memory_order_relaxed);
+    const auto samplesDelta = samples - lastNumSamples;
+    lastNumSamples = samples;
+
+    report.overruns = numOverruns.load(std::memory_order_relaxed);
+    report.numBlocks = 0;
+    report.blockUs = 0.0;
+    report.tracks.resize(series.size() > (size_t)NumStages ? series.size() - (size_t)NumStages : 0);
+    if (series.empty()) return;
+
+    report.numBlocks = (int)(series[Total].count.load(std::memory_order_relaxed) - series[Total].lastCount);
+    if (report.numBlocks > 0)
+        report.blockUs = 1.0e6 * (double)samplesDelta / report.numBlocks / sampleRate;
+
+    for (size_t i = 0; i < series.size(); ++i)
+    {
+        auto stats = series[i].read(usPerCycle);
+        if (report.blockUs > 0.0)
+            stats.percentOfBudget = 100.0 * stats.meanUs / report.blockUs;
+
+        if (i < (size_t)NumStages)
+            report.stages[i] = stats;
+        else
+            report.tracks[i - (size_t)NumStages] = stats;
+    }
+}
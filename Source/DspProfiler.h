@@ -0,0 +1,126 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <vector>
+
+/**
+    Where the audio callback's time goes, per stage of processBlock and per track.
+
+    - Timing uses the CPU's cycle counter (TSC on x86, the virtual counter on ARM),
+      calibrated against the high resolution clock in prepare().
+    - The audio thread sums each stage over the block (a stage may run once per
+      segment), then adds the block's value to the stage's series: running sums, a
+      log-scale histogram (for p99) and the maximum, all plain atomics. Nothing locks.
+    - The editor reads the series (single reader) and turns the change since its last
+      read into mean / p99 / max and the share of the block budget.
+    - A block whose total exceeds its real-time duration counts as an overrun.
+    - Off (setEnabled) it costs one relaxed load per block.
+*/
+class DspProfiler
+{
+public:
+    enum Stage
+    {
+        InputSnapshot,   // input + FX return snapshot, output clear, monitoring
+        RetroWrite,      // After Loop retrospective buffer
+        Parameters,      // handleParameterChanges
+        Commands,        // command queue + MIDI learn, applying due commands
+        Tracks,          // track rendering (all segments, serial or on the render workers)
+        Mix,             // output bus summing
+        PendingOps,      // bounce / after loop hand-over and install
+        MidiClock,       // MIDI clock output
+        Total,           // whole processBlock
+        NumStages
+    };
+
+    static const char* getStageName(int stage);
+
+    using Cycles = juce::int64;
+
+    /** Raw cycle counter (monotonic, per core invariant on current CPUs). */
+    static Cycles now();
+
+    //==============================================================================
+    /** PREPARE: message thread, while the audio thread is not running. Sizes the track
+        series and calibrates the counter (sleeps ~20 ms). */
+    void prepare(int numTracks, double sampleRate);
+
+    void setEnabled(bool shouldBeEnabled) { enabled.store(shouldBeEnabled); }
+    bool isEnabled() const { return enabled.load(); }
+
+    //==============================================================================
+    /** AUDIO: false if profiling is off (the block then records nothing). */
+    bool beginBlock();
+    void addStage(int stage, Cycles cycles) { if (active) blockCycles[(size_t)stage] += cycles; }
+    /** Any thread rendering the track during the block (one at a time per track). */
+    void addTrack(int track, Cycles cycles) { if (active) blockCycles[(size_t)(NumStages + track)] += cycles; }
+    void endBlock(int numSamples);
+
+    /** Adds the scope's duration to a stage (or a track: NumStages + track index). */
+    struct Scope
+    {
+        Scope(DspProfiler& p, int s) : profiler(p), series(s), start(p.active ? now() : 0) {}
+        ~Scope() { if (profiler.active) profiler.blockCycles[(size_t)series] += now() - start; }
+
+        DspProfiler& profiler;
+        const int series;
+        const Cycles start;
+        JUCE_DECLARE_NON_COPYABLE(Scope)
+    };
+
+    //==============================================================================
+    struct Stats
+    {
+        double meanUs = 0.0, p99Us = 0.0, maxUs = 0.0;
+        double percentOfBudget = 0.0; // mean / block duration
+    };
+
+    struct Report
+    {
+        std::array<Stats, NumStages> stages;
+        std::vector<Stats> tracks;
+        double blockUs = 0.0;         // mean real-time duration of a block
+        int numBlocks = 0;            // blocks since the previous report
+        juce::uint32 overruns = 0;    // since prepare()
+    };
+
+    /** UI (single reader): statistics of the blocks since the previous call. */
+    void readReport(Report& report);
+
+private:
+    static constexpr int numBins = 256; // 8 bins per octave of cycles
+
+    static int binOf(Cycles cycles);
+    static double binUpperEdge(int bin);
+
+    struct Series
+    {
+        std::array<std::atomic<juce::uint32>, numBins> histogram {};
+        std::atomic<juce::uint64> sum { 0 };
+        std::atomic<juce::uint32> count { 0 };
+        std::atomic<Cycles> max { 0 };
+
+        // Reader side: values at the previous report
+        std::array<juce::uint32, numBins> lastHistogram {};
+        juce::uint64 lastSum = 0;
+        juce::uint32 lastCount = 0;
+
+        void add(Cycles cycles);
+        Stats read(double usPerCycle);
+    };
+
+    std::atomic<bool> enabled { false };
+    bool active = false;                 // audio thread: this block is profiled
+    std::vector<Cycles> blockCycles;     // stages, then tracks
+    std::vector<Series> series;          // same layout
+
+    double cyclesPerSample = 0.0;
+    double usPerCycle = 0.0;
+    double sampleRate = 44100.0;
+
+    std::atomic<juce::uint64> numSamples { 0 };
+    std::atomic<juce::uint32> numOverruns { 0 };
+    juce::uint64 lastNumSamples = 0;     // reader side
+};
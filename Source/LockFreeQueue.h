@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+    Bounded lock-free FIFO (Vyukov's sequenced ring).
+    Any number of threads may push (message thread, host automation thread,
+    audio thread); a single consumer pops. Neither side ever blocks or allocates:
+    push() fails when the ring is full and pop() fails when it is empty.
+
+    Capacity must be a power of two.
+*/
+template <typename T, size_t Capacity>
+class LockFreeQueue
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    LockFreeQueue()
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /** ANY THREAD: returns false (item dropped) if the queue is full. */
+    bool push(const T& item)
+    {
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            auto& cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            auto diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+
+            if (diff == 0)
+            {
+                // Cell free for this lap: claim it
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = item;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full: the consumer has not freed this cell yet
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed); // another producer won, retry
+            }
+        }
+    }
+
+    /** CONSUMER: returns false if the queue is empty. */
+    bool pop(T& item)
+    {
+        auto& cell = cells[dequeuePos & mask];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+
+        if ((std::ptrdiff_t)seq - (std::ptrdiff_t)(dequeuePos + 1) < 0)
+            return false; // empty, or the producer of this cell has not finished writing
+
+        item = cell.value;
+        cell.sequence.store(dequeuePos + Capacity, std::memory_order_release);
+        ++dequeuePos;
+        return true;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence { 0 };
+        T value {};
+    };
+
+    static constexpr size_t mask = Capacity - 1;
+
+    std::array<Cell, Capacity> cells;
+    alignas(64) std::atomic<size_t> enqueuePos { 0 };
+    alignas(64) size_t dequeuePos = 0; // consumer only
+};
@@ -0,0 +1,181 @@
+#include "LoopHistory.h"
+
+void LoopHistory::prepare(PagePool& pool, int maxSamples)
+{
+    for (auto& level : levels)
+    {
+        level.image.prepare(pool, maxSamples);
+        level.length = 0;
+        level.ownedPages = 0;
+    }
+
+    for (auto& slot : retired)
+    {
+        slot.image.prepare(pool, maxSamples);
+        slot.pending.store(false);
+    }
+
+    head = 0;
+    numUndo = 0;
+    numRedo = 0;
+    olderOwnedPages = 0;
+    nextRetired = 0;
+}
+
+void LoopHistory::setDepth(int newDepth)
+{
+    depth = juce::jlimit(1, maxLevels, newDepth);
+
+    // Undo + redo levels can never exceed the depth (redo levels come from undone ones)
+    while (numUndo + numRedo > depth)
+    {
+        if (numUndo > 0) dropOldest();
+        else             { retire(slot(numUndo + numRedo - 1)); --numRedo; }
+    }
+}
+
+void LoopHistory::push(const LoopImage& current, int length)
+{
+    dropRedo();
+
+    if (numUndo == depth)
+        dropOldest();
+
+    // The newest level's own pages are the ones current no longer holds
+    if (numUndo > 0)
+    {
+        auto& newest = slot(numUndo - 1);
+        newest.ownedPages = newest.image.countPagesNotIn(current);
+        olderOwnedPages += newest.ownedPages;
+    }
+
+    auto& level = slot(numUndo);
+    level.image.shareFrom(current);
+    level.length = length;
+    level.ownedPages = 0;
+    ++numUndo;
+
+    enforceBudget();
+}
+
+bool LoopHistory::undo(LoopImage& current, int& length)
+{
+    if (numUndo == 0) return false;
+
+    // The next newest level keeps its count, for a redo
+    if (numUndo > 1)
+        olderOwnedPages -= slot(numUndo - 2).ownedPages;
+
+    // The newest undo slot becomes the nearest redo slot: same index, swapped contents
+    auto& level = slot(numUndo - 1);
+    current.swapWith(level.image);
+    std::swap(length, level.length);
+
+    --numUndo;
+    ++numRedo;
+    return true;
+}
+
+bool LoopHistory::redo(LoopImage& current, int& length)
+{
+    if (numRedo == 0) return false;
+
+    if (numUndo > 0)
+        olderOwnedPages += slot(numUndo - 1).ownedPages;
+
+    auto& level = slot(numUndo);
+    current.swapWith(level.image);
+    std::swap(length, level.length);
+
+    ++numUndo;
+    --numRedo;
+    return true;
+}
+
+void LoopHistory::clear(PagePool::Caller caller)
+{
+    for (auto& level : levels)
+    {
+        level.image.releaseAll(caller);
+        level.length = 0;
+        level.ownedPages = 0;
+    }
+
+    head = 0;
+    numUndo = 0;
+    numRedo = 0;
+    olderOwnedPages = 0;
+}
+
+void LoopHistory::swapLevelsWith(LoopHistory& other) noexcept
+{
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        levels[i].image.swapWith(other.levels[i].image);
+        std::swap(levels[i].length, other.levels[i].length);
+        std::swap(levels[i].ownedPages, other.levels[i].ownedPages);
+    }
+
+    std::swap(head, other.head);
+    std::swap(numUndo, other.numUndo);
+    std::swap(numRedo, other.numRedo);
+    std::swap(olderOwnedPages, other.olderOwnedPages);
+}
+
+bool LoopHistory::releaseRetired()
+{
+    bool released = false;
+    for (auto& slot : retired)
+    {
+        if (slot.pending.load())
+        {
+            slot.image.releaseAll(PagePool::Caller::Background);
+            slot.pending.store(false);
+            released = true;
+        }
+    }
+    return released;
+}
+
+void LoopHistory::retire(Level& level)
+{
+    auto& slot = retired[(size_t)nextRetired];
+    if (slot.pending.load())
+    {
+        level.image.releaseAll();
+    }
+    else
+    {
+        level.image.swapWith(slot.image);
+        slot.pending.store(true);
+        nextRetired = (nextRetired + 1) % numRetiredSlots;
+    }
+
+    level.length = 0;
+    level.ownedPages = 0;
+}
+
+void LoopHistory::dropOldest()
+{
+    if (numUndo > 1)
+        olderOwnedPages -= slot(0).ownedPages;
+    retire(slot(0));
+
+    head = (head + 1) % maxLevels;
+    --numUndo;
+}
+
+void LoopHistory::dropRedo()
+{
+    for (int i = 0; i < numRedo; ++i)
+        retire(slot(numUndo + i));
+    numRedo = 0;
+}
+
+void LoopHistory::enforceBudget()
+{
+    // Oldest first; dropping a level frees exactly what it owned (copy-on-write
+    // keeps shared pages at the same index, so the newer levels' counts stay)
+    while (budgetPages > 0 && olderOwnedPages > budgetPages && numUndo > 1)
+        dropOldest();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LoopImage.h"
+
+/**
+    N-deep undo/redo stack of copy-on-write loop snapshots for one track.
+
+    Snapshots share pages with the live loop and with each other, so a level only
+    costs the pages that changed after it was taken. Levels live in a ring of
+    preallocated page tables:
+        [oldest undo ... newest undo][nearest redo ... furthest redo]
+    Undo and redo swap the live page table with one slot, which is O(1).
+    Dropped levels are swapped into a few retired slots, whose pages the background
+    thread releases (releaseRetired).
+    All methods except prepare() and releaseRetired() are realtime-safe (audio thread).
+*/
+class LoopHistory
+{
+public:
+    static constexpr int maxLevels = 16;
+
+    LoopHistory() = default;
+
+    /** PREPARE: Sizes every snapshot slot's page table (message thread). */
+    void prepare(PagePool& pool, int maxSamples);
+
+    /** Number of undo levels kept (1..maxLevels). Shrinking evicts the oldest levels. */
+    void setDepth(int levels);
+    int getDepth() const { return depth; }
+
+    /** Memory cap in pages for the levels' own pages (pages shared with the live loop are free).
+        The oldest levels are evicted first; the newest level is always kept. Each level's
+        own pages are counted once, when a newer level is pushed over it. */
+    void setBudgetPages(int pages) { budgetPages = juce::jmax(0, pages); }
+
+    /** Records current as the newest undo level and drops every redo level.
+        O(pages) for the snapshot; the budget check is O(1). */
+    void push(const LoopImage& current, int length);
+
+    /** Swaps current with the newest undo level. O(1). */
+    bool undo(LoopImage& current, int& length);
+
+    /** Swaps current with the nearest redo level. O(1). */
+    bool redo(LoopImage& current, int& length);
+
+    /** Drops every level. */
+    void clear(PagePool::Caller caller = PagePool::Caller::Audio);
+
+    /** Exchanges the levels with other (O(levels), no page is touched). Depth, budget
+        and retired slots stay. */
+    void swapLevelsWith(LoopHistory& other) noexcept;
+
+    /** BACKGROUND: releases the pages of the dropped levels. True if there were any. */
+    bool releaseRetired();
+
+    bool canUndo() const { return numUndo > 0; }
+    bool canRedo() const { return numRedo > 0; }
+    int getNumUndoLevels() const { return numUndo; }
+    int getNumRedoLevels() const { return numRedo; }
+
+private:
+    struct Level
+    {
+        LoopImage image;
+        int length = 0;
+        int ownedPages = 0; // pages not in the next newer level (set when one is pushed over it)
+    };
+
+    Level& slot(int index) { return levels[(size_t)((head + index) % maxLevels)]; }
+    void dropOldest();
+    void dropRedo();
+    void enforceBudget();
+    /** Empties level, handing its pages to the background thread
+        (released here if every retired slot is still pending). */
+    void retire(Level& level);
+
+    std::array<Level, maxLevels> levels;
+    int head = 0;       // ring index of the oldest undo level
+    int numUndo = 0;
+    int numRedo = 0;
+    int depth = 4;
+    int budgetPages = 0; // 0 = unlimited
+    int olderOwnedPages = 0; // ownedPages of every undo level but the newest
+
+    struct RetiredLevel
+    {
+        LoopImage image;
+        std::atomic<bool> pending { false };
+    };
+    static constexpr int numRetiredSlots = 4;
+    std::array<RetiredLevel, numRetiredSlots> retired;
+    int nextRetired = 0;
+};
@@ -0,0 +1,348 @@
+#include "LoopImage.h"
+#include "MixKernels.h"
+
+void LoopImage::prepare(PagePool& pool, int maxSamples)
+{
+    base.prepare(pool, maxSamples);
+    for (auto& layer : layers)
+        layer.prepare(pool, maxSamples);
+
+    layerMuted.fill(false);
+    layerPeriods.fill(0);
+    basePeriod = 0;
+    numLayers = 0;
+}
+
+void LoopImage::clampPeriods(int maxPeriod)
+{
+    if (basePeriod > maxPeriod) basePeriod = maxPeriod;
+    for (int i = 0; i < numLayers; ++i)
+        layerPeriods[(size_t)i] = juce::jmin(layerPeriods[(size_t)i], maxPeriod);
+}
+
+void LoopImage::setLayerMuted(int index, bool shouldBeMuted)
+{
+    if (index >= 0 && index < numLayers)
+        layerMuted[(size_t)index] = shouldBeMuted;
+}
+
+PagedBuffer& LoopImage::pushLayer(int period)
+{
+    if (numLayers == maxLayers)
+        return layers[(size_t)maxLayers - 1];
+
+    layerMuted[(size_t)numLayers] = false;
+    layerPeriods[(size_t)numLayers] = period;
+    return layers[(size_t)numLayers++];
+}
+
+void LoopImage::removeLayer(int index)
+{
+    if (index < 0 || index >= numLayers) return;
+
+    layers[(size_t)index].releaseAll();
+
+    // Bubble the emptied table up to the top, keeping the order of the others
+    for (int i = index; i < numLayers - 1; ++i)
+    {
+        layers[(size_t)i].swapWith(layers[(size_t)i + 1]);
+        std::swap(layerMuted[(size_t)i], layerMuted[(size_t)i + 1]);
+        std::swap(layerPeriods[(size_t)i], layerPeriods[(size_t)i + 1]);
+    }
+
+    --numLayers;
+    layerMuted[(size_t)numLayers] = false;
+    layerPeriods[(size_t)numLayers] = 0;
+}
+
+int LoopImage::getOldestMergeableLayer() const
+{
+    for (int i = 0; i < numLayers; ++i)
+    {
+        if (layerMuted[(size_t)i]) continue;
+
+        int shorter = juce::jmin(basePeriod, layerPeriods[(size_t)i]);
+        int longer  = juce::jmax(basePeriod, layerPeriods[(size_t)i]);
+        if (shorter > 0 && longer % shorter == 0)
+            return i;
+    }
+    return -1;
+}
+
+void LoopImage::releaseAll(PagePool::Caller caller)
+{
+    base.releaseAll(caller);
+    for (int i = 0; i < numLayers; ++i)
+        layers[(size_t)i].releaseAll(caller);
+
+    layerMuted.fill(false);
+    layerPeriods.fill(0);
+    basePeriod = 0;
+    numLayers = 0;
+}
+
+void LoopImage::shareFrom(const LoopImage& other)
+{
+    if (&other == this) return;
+
+    base.shareFrom(other.base);
+
+    // Layers above both counts are empty on both sides
+    int used = juce::jmax(numLayers, other.numLayers);
+    for (int i = 0; i < used; ++i)
+        layers[(size_t)i].shareFrom(other.layers[(size_t)i]);
+
+    layerMuted   = other.layerMuted;
+    layerPeriods = other.layerPeriods;
+    basePeriod   = other.basePeriod;
+    numLayers    = other.numLayers;
+}
+
+void LoopImage::swapWith(LoopImage& other) noexcept
+{
+    base.swapWith(other.base);
+    for (size_t i = 0; i < layers.size(); ++i)
+        layers[i].swapWith(other.layers[i]);
+
+    std::swap(layerMuted, other.layerMuted);
+    std::swap(layerPeriods, other.layerPeriods);
+    std::swap(basePeriod, other.basePeriod);
+    std::swap(numLayers, other.numLayers);
+}
+
+int LoopImage::countPagesNotIn(const LoopImage& other) const
+{
+    int count = base.countPagesNotIn(other.base);
+    for (int i = 0; i < numLayers; ++i)
+        count += layers[(size_t)i].countPagesNotIn(other.layers[(size_t)i]);
+    return count;
+}
+
+int LoopImage::gatherChunk(int channel, int sourcePos, int numSamples, int excludedLayer,
+                           const float** sources, int& numSources) const
+{
+    // Position inside a buffer repeating every period samples
+    auto wrap = [&sourcePos](int period) { return period > 0 ? sourcePos % period : sourcePos; };
+
+    // 1. Largest chunk on which no buffer crosses a page boundary or its period
+    int chunk = numSamples;
+    auto limit = [&](int period)
+    {
+        int pos = wrap(period);
+        chunk = juce::jmin(chunk, AudioPage::numSamples - (pos & AudioPage::mask));
+        if (period > 0)
+            chunk = juce::jmin(chunk, period - pos);
+    };
+
+    limit(basePeriod);
+    for (int i = 0; i < numLayers; ++i)
+        if (!layerMuted[(size_t)i])
+            limit(layerPeriods[(size_t)i]);
+
+    // 2. Every non-silent page under this chunk
+    numSources = 0;
+    auto gather = [&](const PagedBuffer& buffer, int period)
+    {
+        int pos = wrap(period);
+        int pageIndex = pos >> AudioPage::shift;
+        if (pageIndex < buffer.getNumPages())
+            if (auto* page = buffer.getPage(pageIndex))
+                sources[numSources++] = page->data[channel] + (pos & AudioPage::mask);
+    };
+
+    gather(base, basePeriod);
+    for (int i = 0; i < numLayers; ++i)
+        if (!layerMuted[(size_t)i] && i != excludedLayer)
+            gather(layers[(size_t)i], layerPeriods[(size_t)i]);
+
+    return chunk;
+}
+
+void LoopImage::addTo(int channel, int sourcePos, float* dest, int numSamples, float gain) const
+{
+    const float* sources[maxLayers + 1];
+
+    while (numSamples > 0)
+    {
+        // Mix every source of the chunk in one pass
+        int numSources = 0;
+        int chunk = gatherChunk(channel, sourcePos, numSamples, -1, sources, numSources);
+
+        MixKernels::addSum(dest, sources, numSources, gain, chunk);
+
+        dest       += chunk;
+        sourcePos  += chunk;
+        numSamples -= chunk;
+    }
+}
+
+bool LoopImage::overdubTop(int channel, int sourcePos, float* dest, const float* input,
+                           int numSamples, float gain, float feedback)
+{
+    if (numLayers == 0) return false;
+
+    const int top = numLayers - 1;
+    auto& layer = layers[(size_t)top];
+    const int period = layerPeriods[(size_t)top];
+
+    // A muted top layer is not played back: nothing to share between the two passes
+    if (layerMuted[(size_t)top])
+    {
+        addTo(channel, sourcePos, dest, numSamples, gain);
+        int writable = juce::jmin(numSamples, period - sourcePos);
+        return writable <= 0 || layer.addFrom(channel, sourcePos, input, writable);
+    }
+
+    const float* sources[maxLayers + 1];
+    bool complete = true;
+
+    while (numSamples > 0)
+    {
+        int numSources = 0;
+        int chunk = gatherChunk(channel, sourcePos, numSamples, top, sources, numSources);
+
+        if (sourcePos >= period)
+        {
+            // Past this pass's period (every layer in use): playback only
+            addTo(channel, sourcePos, dest, chunk, gain);
+        }
+        else if (layer.ensureAllocated(sourcePos, chunk))
+        {
+            // The chunk stays inside one page of the top layer (gatherChunk limits it)
+            float* loop = layer.getExclusivePage(sourcePos >> AudioPage::shift)->data[channel]
+                        + (sourcePos & AudioPage::mask);
+
+            // The kernel takes one extra source; more than that are summed beforehand
+            if (numSources > 1)
+                MixKernels::addSum(dest, sources + 1, numSources - 1, gain, chunk);
+
+            MixKernels::overdub(dest, loop, input, numSources > 0 ? sources[0] : nullptr,
+                                gain, feedback, chunk);
+        }
+        else
+        {
+            // Pool ran dry: keep playing, drop the input
+            addTo(channel, sourcePos, dest, chunk, gain);
+            complete = false;
+        }
+
+        dest       += chunk;
+        input      += chunk;
+        sourcePos  += chunk;
+        numSamples -= chunk;
+    }
+
+    return complete;
+}
+
+void LoopImage::addPeriodic(const PagedBuffer& buffer, int period, int channel, int sourcePos, float* dest, int numSamples)
+{
+    while (numSamples > 0)
+    {
+        int pos   = period > 0 ? sourcePos % period : sourcePos;
+        int chunk = period > 0 ? juce::jmin(numSamples, period - pos) : numSamples;
+
+        buffer.addTo(channel, pos, dest, chunk);
+
+        dest       += chunk;
+        sourcePos  += chunk;
+        numSamples -= chunk;
+    }
+}
+
+//==============================================================================
+void FlattenJob::prepare(PagePool& pool, int maxSamples)
+{
+    base.prepare(pool, maxSamples);
+    layer.prepare(pool, maxSamples);
+    result.prepare(pool, maxSamples);
+    status.store(Idle);
+    layerIndex = -1;
+}
+
+bool FlattenJob::start(const LoopImage& image, int index, juce::uint32 newGeneration)
+{
+    const auto& source = image.getLayer(index);
+    basePeriod   = image.getBasePeriod();
+    layerPeriod  = image.getLayerPeriod(index);
+    resultPeriod = juce::jmax(basePeriod, layerPeriod);
+    if (basePeriod <= 0 || layerPeriod <= 0 || resultPeriod % juce::jmin(basePeriod, layerPeriod) != 0)
+        return false;
+
+    // Same period: only the pages the pass wrote change.
+    // Different periods: the shorter one repeats over the whole result.
+    const int resultPages = PagePool::pagesForSamples(resultPeriod);
+    auto needsPage = [&](int p)
+    {
+        return basePeriod != layerPeriod || source.getPage(p) != nullptr;
+    };
+
+    int numResultPages = 0;
+    for (int p = 0; p < resultPages; ++p)
+        if (needsPage(p))
+            ++numResultPages;
+
+    if (!result.canAllocate(numResultPages << AudioPage::shift))
+        return false;
+
+    // Hold references so the pages stay valid whatever the track does meanwhile
+    base.shareFrom(image.getBase());
+    layer.shareFrom(source);
+
+    for (int p = 0; p < resultPages; ++p)
+        if (needsPage(p))
+            result.ensureAllocated(p << AudioPage::shift, AudioPage::numSamples);
+
+    layerIndex = index;
+    generation = newGeneration;
+    status.store(Pending);
+    return true;
+}
+
+void FlattenJob::run()
+{
+    // Result pages come zeroed from the pool: just add both sources
+    for (int p = 0; p < result.getNumPages(); ++p)
+    {
+        auto* to = result.getExclusivePage(p);
+        if (to == nullptr) continue;
+
+        int start = p << AudioPage::shift;
+        int count = juce::jmin(AudioPage::numSamples, resultPeriod - start);
+
+        for (int ch = 0; ch < AudioPage::numChannels; ++ch)
+        {
+            LoopImage::addPeriodic(base,  basePeriod,  ch, start, to->data[ch], count);
+            LoopImage::addPeriodic(layer, layerPeriod, ch, start, to->data[ch], count);
+        }
+    }
+
+    status.store(Done);
+}
+
+void FlattenJob::install(LoopImage& image)
+{
+    auto& target = image.getBase();
+    const int resultPages = PagePool::pagesForSamples(resultPeriod);
+
+    for (int p = 0; p < target.getNumPages(); ++p)
+    {
+        if (result.getPage(p) != nullptr)
+            target.attachPage(p, result.detachPage(p));
+        else if (p >= resultPages && target.getPage(p) != nullptr)
+            target.attachPage(p, nullptr); // beyond the new period: never read again
+    }
+
+    image.setBasePeriod(resultPeriod);
+    image.removeLayer(layerIndex);
+    reset();
+}
+
+void FlattenJob::reset()
+{
+    base.releaseAll();
+    layer.releaseAll();
+    result.releaseAll();
+    layerIndex = -1;
+    status.store(Idle);
+}
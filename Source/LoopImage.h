@@ -0,0 +1,135 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PagedBuffer.h"
+
+/**
+    Loop content of one track: a base recording plus one sparse layer per overdub pass.
+    A layer only holds pages for the range its pass actually wrote. Reading mixes the
+    base with every unmuted layer in a single pass (MixKernels), so removing or muting
+    a pass never touches the other samples. Old layers are merged into the base in the
+    background (FlattenJob) to keep the mix cost bounded.
+
+    Every buffer has a period: it is read at (position % period), so a loop multiplied
+    after a buffer was recorded simply repeats it. Multiply and divide only change the
+    loop length (and divide clamps the periods); an overdub on a multiplied loop writes
+    into a new layer with the longer period, so only what it writes is materialised.
+
+    All methods except prepare() are realtime-safe (audio thread).
+*/
+class LoopImage
+{
+public:
+    static constexpr int maxLayers = 8;
+
+    LoopImage() = default;
+
+    /** PREPARE: Sizes the base and layer page tables (message thread). */
+    void prepare(PagePool& pool, int maxSamples);
+
+    int getNumChannels() const { return base.getNumChannels(); }
+    int getCapacity() const { return base.getCapacity(); }
+
+    PagedBuffer& getBase() { return base; }
+    const PagedBuffer& getBase() const { return base; }
+
+    /** 0 = not periodic (first pass still being recorded). */
+    int getBasePeriod() const { return basePeriod; }
+    void setBasePeriod(int period) { basePeriod = period; }
+
+    /** Divide: no buffer may repeat later than the new loop length. */
+    void clampPeriods(int maxPeriod);
+
+    //==============================================================================
+    // Layers (index 0 = oldest)
+    int getNumLayers() const { return numLayers; }
+    PagedBuffer& getLayer(int index) { return layers[(size_t)index]; }
+    const PagedBuffer& getLayer(int index) const { return layers[(size_t)index]; }
+
+    bool isLayerMuted(int index) const { return layerMuted[(size_t)index]; }
+    void setLayerMuted(int index, bool shouldBeMuted);
+    int getLayerPeriod(int index) const { return layerPeriods[(size_t)index]; }
+
+    /** Opens an empty layer on top for a new overdub pass repeating every period samples.
+        When every layer is in use the pass is written into the top layer (with its own period). */
+    PagedBuffer& pushLayer(int period);
+
+    /** Releases a layer's pages and shifts the newer layers down. */
+    void removeLayer(int index);
+
+    /** Oldest unmuted layer that can be merged into the base
+        (one period a multiple of the other), or -1. */
+    int getOldestMergeableLayer() const;
+
+    //==============================================================================
+    void releaseAll(PagePool::Caller caller = PagePool::Caller::Audio);
+    void shareFrom(const LoopImage& other);
+    void swapWith(LoopImage& other) noexcept;
+
+    /** Pages held here that other does not hold at the same place (see PagedBuffer). */
+    int countPagesNotIn(const LoopImage& other) const;
+
+    //==============================================================================
+    // Reading: base + unmuted layers, each at (sourcePos % period)
+    void addTo(int channel, int sourcePos, float* dest, int numSamples, float gain = 1.0f) const;
+
+    /** Overdub pass on the top layer, fused with playback (MixKernels::overdub):
+        dest += gain * (base + unmuted layers), top = top * feedback + input,
+        reading the top layer's pages only once. Only positions below the top
+        layer's period are written. Returns false if input had to be dropped. */
+    bool overdubTop(int channel, int sourcePos, float* dest, const float* input,
+                    int numSamples, float gain = 1.0f, float feedback = 1.0f);
+
+    /** Adds buffer's content repeating every period samples (0 = not periodic). */
+    static void addPeriodic(const PagedBuffer& buffer, int period, int channel, int sourcePos, float* dest, int numSamples);
+
+private:
+    /** Largest chunk from sourcePos on which no unmuted buffer crosses a page boundary
+        or its period, and the non-silent pages under it (excludedLayer left out). */
+    int gatherChunk(int channel, int sourcePos, int numSamples, int excludedLayer,
+                    const float** sources, int& numSources) const;
+
+    PagedBuffer base;
+    int basePeriod = 0;
+    std::array<PagedBuffer, maxLayers> layers;
+    std::array<int, maxLayers> layerPeriods {};
+    std::array<bool, maxLayers> layerMuted {};
+    int numLayers = 0;
+};
+
+//==============================================================================
+/**
+    Merges one layer into a copy of the base pages, off the audio thread.
+    - The audio thread fills the job (start): it shares the base and layer pages and
+      allocates the result pages, so the background thread never touches the pool.
+    - The background thread sums them (run).
+    - The audio thread installs or discards the result (install / reset) and releases everything.
+*/
+struct FlattenJob
+{
+    enum Status { Idle, Pending, Done };
+
+    /** PREPARE: message thread, while the flattener is not serviced. */
+    void prepare(PagePool& pool, int maxSamples);
+
+    /** AUDIO: returns false (and leaves the job idle) if the pool cannot supply the result pages. */
+    bool start(const LoopImage& image, int layerIndex, juce::uint32 generation);
+
+    /** BACKGROUND */
+    void run();
+
+    /** AUDIO: moves the result pages into image's base and drops the layer.
+        When the periods differ the base is materialised up to the longer one. */
+    void install(LoopImage& image);
+
+    /** AUDIO: forgets the job (result discarded if not installed). */
+    void reset();
+
+    std::atomic<int> status { Idle };
+    int layerIndex = -1;
+    juce::uint32 generation = 0;
+
+private:
+    int basePeriod = 0, layerPeriod = 0, resultPeriod = 0;
+    PagedBuffer base, layer, result;
+};
@@ -9,40 +9,62 @@ LoopTrack::~LoopTrack()
 {
 }
 
-void LoopTrack::prepareToPlay(double sampleRate, int samplesPerBlock)
+void LoopTrack::prepareToPlay(double sampleRate, int samplesPerBlock, PagePool& pool)
 {
     trackSampleRate = sampleRate;
 
-    // Allocate the buffer for the maximum supported loop time (e.g., 5 mins)
-    // We do this here (or in constructor) to AVOID allocation in processBlock
+    // Size the page tables for the maximum supported loop time (e.g., 5 mins).
+    // Only the tables are allocated here; pages are pulled from the pool
+    // (pre-zeroed, lock-free) as recording grows, so processBlock never allocates.
     int totalSamples = static_cast<int>(sampleRate * maxLoopLengthSeconds);
     
-    // Assuming stereo for now (2 channels). 
-    // If your plugin supports changeable channel counts, pass that in prepareToPlay.
-    loopBuffer.setSize(2, totalSamples);
-    loopBuffer.clear();
-    
-    undoBuffer.setSize(2, totalSamples);
-    undoBuffer.clear();
+    // Pages are stereo (AudioPage::numChannels).
+    loopImage.prepare(pool, totalSamples);
+    history.prepare(pool, totalSamples);
+    fxCaptureBuffer.prepare(pool, totalSamples);
+    flattenJob.prepare(pool, totalSamples);
+    pendingLayerOp.store(0);
+
+    for (auto& slot : retired)
+    {
+        slot.image.prepare(pool, totalSamples);
+        slot.fxCapture.prepare(pool, totalSamples);
+        slot.history.prepare(pool, totalSamples);
+        slot.pending.store(false);
+    }
+    nextRetired = 0;
+    retireHeld = false;
 
-    fxCaptureBuffer.setSize(2, totalSamples);
-    fxCaptureBuffer.clear();
+    outputBuffer.setSize(AudioPage::numChannels, juce::jmax(1, samplesPerBlock));
+    outputBuffer.clear();
+    hasOutput = false;
 
     clear();
 }
 
-void LoopTrack::processBlock(juce::AudioBuffer<float>& outputBuffer, const juce::AudioBuffer<float>& inputBuffer,
+bool LoopTrack::processBlock(const juce::AudioBuffer<float>& inputBuffer,
                              const juce::AudioBuffer<float>& sidechainBuffer,
                              juce::int64 globalTotalSamples, bool isMasterTrack, int masterLoopLength, bool anySoloActive)
 {
-    const int numSamples = outputBuffer.getNumSamples();
+    const int numSamples = inputBuffer.getNumSamples();
+    hasOutput = false;
+
+    // Content a clear() couldn't swap out yet goes as soon as a slot is free
+    retireContent();
+
+    // Layer edits and background flattening run whatever the state
+    serviceLayers();
+
     State state = currentState.load();
 
     // If stopped or empty, we generally don't output sound, 
     // providing we aren't currently recording the first pass.
     if (state == State::Stopped || (state == State::Empty && state != State::Recording))
     {
-        return;
+        // A stopped loop still being replaced (e.g. a loaded session) keeps filling its pages
+        if (mReplace.active)
+            processReplaceChunk(0, numSamples);
+        return false;
     }
     
     // Check Solo/Mute logic
@@ -80,10 +102,7 @@ void LoopTrack::processBlock(juce::AudioBuffer<float>& outputBuffer, const juce:
             // IMPORTANT: Dfinir la longueur de loop AVANT de passer en Playing
             loopLengthSamples = targetLen;
             
-            LOG("SLAVE REC FINISHED | recorded=" + juce::String(recordedSamplesCurrent) + 
-                " loopLen=" + juce::String(loopLengthSamples) + 
-                " mult=" + juce::String(mult) + 
-                " offset=" + juce::String(recordingStartOffset));
+            TRACE(SlaveRecFinished, index, recordedSamplesCurrent, loopLengthSamples, mult, recordingStartOffset);
             
             setPlaying();
             state = State::Playing;
@@ -103,7 +122,7 @@ void LoopTrack::processBlock(juce::AudioBuffer<float>& outputBuffer, const juce:
         {
              // Linear recording
              writePos = playbackPosition;
-             currentLoopLength = loopBuffer.getNumSamples(); // Prevent overflow
+             currentLoopLength = loopImage.getCapacity(); // Prevent overflow
         }
         else
         {
@@ -133,15 +152,12 @@ void LoopTrack::processBlock(juce::AudioBuffer<float>& outputBuffer, const juce:
                   recordingStartOffset = static_cast<int>(globalTotalSamples % masterLoopLength);
                   recordingStartGlobalSample = globalTotalSamples;
                   
-                  LOG("SLAVE REC START | offset=" + juce::String(recordingStartOffset) + 
-                      " globalSample=" + juce::String((juce::int64)globalTotalSamples) +
-                      " masterLen=" + juce::String(masterLoopLength) + 
-                      " targetMult=" + juce::String(targetMultiplier));
+                  TRACE(SlaveRecStart, index, recordingStartOffset, globalTotalSamples, masterLoopLength, targetMultiplier);
               }
              
              // Enregistrer linairement depuis position 0 dans notre buffer
              writePos = recordedSamplesCurrent;
-             currentLoopLength = loopBuffer.getNumSamples(); 
+             currentLoopLength = loopImage.getCapacity(); 
              
              // Calculer la longueur cible avec le multiplicateur
              float mult = targetMultiplier;
@@ -199,43 +215,63 @@ void LoopTrack::processBlock(juce::AudioBuffer<float>& outputBuffer, const juce:
             break;
 
         case State::Playing:
-            // Continuously capture sidechain into staging buffer for later one-shot replace
-            if (loopLengthSamples > 0)
+            // Capture the sidechain into the staging buffer while an FX replace is armed
+            if (loopLengthSamples > 0 && fxCaptureArmed.load())
                 captureSidechain(sidechainBuffer, numSamples, readPos, currentLoopLength);
 
             // We must update position even if silent
             if (shouldBeSilent)
             {
-                 handlePlayback(outputBuffer, numSamples, readPos, currentLoopLength, true);
+                 handlePlayback(numSamples, readPos, currentLoopLength, true);
             }
             else
             {
-                handlePlayback(outputBuffer, numSamples, readPos, currentLoopLength, false);
+                handlePlayback(numSamples, readPos, currentLoopLength, false);
             }
             break;
 
         case State::Overdubbing:
-             // Continuously capture sidechain into staging buffer for later one-shot replace
-             if (loopLengthSamples > 0)
+             // Capture the sidechain into the staging buffer while an FX replace is armed
+             if (loopLengthSamples > 0 && fxCaptureArmed.load())
                  captureSidechain(sidechainBuffer, numSamples, readPos, currentLoopLength);
 
-             handleOverdub(outputBuffer, inputBuffer, numSamples, readPos, currentLoopLength, shouldBeSilent);
+             handleOverdub(inputBuffer, numSamples, readPos, currentLoopLength, shouldBeSilent);
             break;
 
         default:
             break;
     }
+
+    return hasOutput;
+}
+
+void LoopTrack::beginOutput(int numSamples)
+{
+    // The processor never renders more than the prepared sub-block; this only guards other callers
+    if (outputBuffer.getNumSamples() < numSamples)
+        outputBuffer.setSize(AudioPage::numChannels, numSamples, false, false, true);
+
+    outputBuffer.clear(0, numSamples);
+    hasOutput = true;
 }
 
 void LoopTrack::clear()
 {
+    // An empty track has nothing to hand back (clearing one takes no slot)
+    if (currentState.load() != State::Empty || isReplacing() || history.canUndo() || history.canRedo())
+        retireHeld = true;
+
     currentState.store(State::Empty);
     loopLengthSamples = 0;
     playbackPosition = 0;
     recordedSamplesCurrent = 0;
-    loopBuffer.clear();
-    undoLoopLengthSamples = 0;
-    hasUndo = false;
+
+    // Hand the pages back to the pool without walking the page tables here:
+    // swap them with an empty retired set and let the background thread
+    // release (and zero) them.
+    retireContent();
+    invalidateFlatten();
+    ++contentGeneration;
     
     // IMPORTANT : Rinitialiser le targetMultiplier  1.0 (valeur par dfaut)
     targetMultiplier = 1.0f;
@@ -244,10 +280,57 @@ void LoopTrack::clear()
     recordingStartOffset = 0;
     recordingStartGlobalSample = 0;
     fxCaptureSamplesWritten = 0;
+    fxCaptureArmed.store(false);
 
     // Cancel any in-flight progressive replace
-    mReplace.active = false;
-    mReplace.source = nullptr;
+    cancelReplace();
+}
+
+bool LoopTrack::retireContent()
+{
+    if (!retireHeld)
+        return true;
+
+    auto& slot = retired[(size_t)nextRetired];
+    if (slot.pending.load())
+        return false;
+
+    loopImage.swapWith(slot.image);
+    fxCaptureBuffer.swapWith(slot.fxCapture);
+    history.swapLevelsWith(slot.history);
+    slot.pending.store(true);
+
+    nextRetired = (nextRetired + 1) % numRetiredSlots;
+    retireHeld = false;
+    return true;
+}
+
+bool LoopTrack::runBackgroundTasks()
+{
+    bool didWork = false;
+
+    if (flattenJob.status.load() == FlattenJob::Pending)
+    {
+        flattenJob.run();
+        didWork = true;
+    }
+
+    for (auto& slot : retired)
+    {
+        if (slot.pending.load())
+        {
+            slot.image.releaseAll(PagePool::Caller::Background);
+            slot.fxCapture.releaseAll(PagePool::Caller::Background);
+            slot.history.clear(PagePool::Caller::Background);
+            slot.pending.store(false);
+            didWork = true;
+        }
+    }
+
+    // Undo levels dropped by the audio thread (redo levels on a push, the oldest over depth or budget)
+    didWork |= history.releaseRetired();
+
+    return didWork;
 }
 
 //==============================================================================
@@ -255,97 +338,50 @@ void LoopTrack::clear()
 
 void LoopTrack::saveUndo()
 {
+    // Every edit of the loop saves the previous version first
+    ++contentGeneration;
+
     // Back up the current loop buffer and length
     int len = loopLengthSamples;
     if (len > 0)
     {
-        // We only copy the valid part
-        for (int ch = 0; ch < undoBuffer.getNumChannels(); ++ch)
-            undoBuffer.copyFrom(ch, 0, loopBuffer, ch, 0, len);
-        
-        undoLoopLengthSamples = len;
-        hasUndo = true;
+        // Copy-on-write snapshot: the history level shares the loop's pages and a
+        // page is only duplicated when the loop first writes to it afterwards.
+        // Pushing drops the redo levels and evicts the oldest levels over depth/budget.
+        history.push(loopImage, len);
     }
 }
 
 void LoopTrack::performUndo()
 {
-    if (hasUndo && undoLoopLengthSamples > 0)
-    {
-        // Stop any active recording/overdubbing first
-        if (currentState.load() == State::Recording || currentState.load() == State::Overdubbing)
-            setPlaying();
+    if (!history.canUndo() || !retireContent()) return;
 
-        // Swap Logic (Undo <-> Current)
-        // This effectively makes "Undo" toggle between two states (Undo/Redo)
-        
-        // 1. Temp copy current to temp buffer? 
-        // Or simplified: We just want to restore the OLD state.
-        // But the user asked: "si on rappuie sur undo a fait un redo"
-        // So we swap.
-        
-        // We need a temp buffer or just swap content if both are same size.
-        // Since undoBuffer and loopBuffer are full size allocated, we can just swap content pointer? 
-        // No, AudioBuffer doesn't own memory like that easily without pointer swap.
-        // Let's do a deep copy swap for safety or use a temp cache if we had one.
-        // For simplicity: We will just COPY undo -> loop, and SAVE loop -> undo BEFORE that.
-        
-        // A full swap is better.
-        // We do it manually with a temp buffer would be slow.
-        // Optimized:
-        // We can just swap the data via copying.
-        
-        int currentLen = loopLengthSamples;
-        int restoredLen = undoLoopLengthSamples;
-        
-        // 1. Copy Current -> Temp (Using the high part of undo buffer? Risky)
-        // Let's assume we just Restore for now, implementing Swap for Redo requires 3rd buffer or smart swaping.
-        // "Undo" typically implies "Revert". "Redo" implies "Revert the Revert".
-        // So swapping is the correct logic.
-        
-        // We can use a trick: Swap the contents.
-        // juce::AudioBuffer doesn't support move assignment easily to swap internal arrays exposed publicly.
-        // But we can copy.
-        
-        // Limit: This is running on Message Thread (button click) usually.
-        // Copying 5 minutes of audio double precision... might take a few milliseconds.
-        // Let's protect against Audio Thread access? 
-        // In a "Simple Looper", we might accept a glitch or use a SpinLock.
-        
-        // SWAP IMPLEMENTATION:
-        
-        // 1. Read Undo to Temp? No.
-        // We'll proceed with simple copy for now, assuming user invoked Rec/Overdub -> SaveUndo.
-        // If we want Undo/Redo, we should have swapped.
-        
-        // To support "Redo", we treat the current state as the new "Undo" state before restoring.
-        
-        // A -> B (Undo saves A)
-        // Undo Called:
-        // Temp = B
-        // B = A
-        // A = Temp
-        
-        // We need a temporary buffer. We can allocate one locally on UI thread.
-        // Or just use the unsued part of the buffer if we know we have space? (Risky)
-        
-        // Let's just do a direct swap loop.
-        int maxLen = juce::jmax(currentLen, restoredLen);
-        for (int ch = 0; ch < loopBuffer.getNumChannels(); ++ch)
-        {
-            auto* d1 = loopBuffer.getWritePointer(ch);
-            auto* d2 = undoBuffer.getWritePointer(ch);
-            for (int i = 0; i < maxLen; ++i)
-            {
-                std::swap(d1[i], d2[i]);
-            }
-        }
-        
-        loopLengthSamples = restoredLen;
-        undoLoopLengthSamples = currentLen;
-        
-        // hasUndo remains true (to allow Redo)
-    }
+    // Stop any active recording/overdubbing first
+    if (currentState.load() == State::Recording || currentState.load() == State::Overdubbing)
+        setPlaying();
+
+    // A progressive replace would keep writing into the restored pages
+    cancelReplace();
+
+    // Both images are page tables sharing unchanged pages, so swapping them
+    // only exchanges page pointers. The current loop becomes the nearest redo level.
+    history.undo(loopImage, loopLengthSamples);
+    invalidateFlatten();
+    ++contentGeneration;
+}
+
+void LoopTrack::performRedo()
+{
+    if (!history.canRedo() || !retireContent()) return;
+
+    if (currentState.load() == State::Recording || currentState.load() == State::Overdubbing)
+        setPlaying();
+
+    cancelReplace();
+
+    history.redo(loopImage, loopLengthSamples);
+    invalidateFlatten();
+    ++contentGeneration;
 }
 
 void LoopTrack::multiplyLoop()
@@ -357,18 +393,18 @@ void LoopTrack::multiplyLoop()
         return;
     }
     
-    // Check bounds
-    if (loopLengthSamples * 2 > loopBuffer.getNumSamples()) return;
+    // Check bounds (later passes are stored over the whole doubled length)
+    if (loopLengthSamples * 2 > loopImage.getCapacity()) return;
     
     saveUndo();
     
-    // Copy [0..len] to [len..2*len]
-    for (int ch = 0; ch < loopBuffer.getNumChannels(); ++ch)
-    {
-        loopBuffer.copyFrom(ch, loopLengthSamples, loopBuffer, ch, 0, loopLengthSamples);
-    }
-    
+    // Metadata only: every buffer keeps its period, so [0..len] simply plays twice.
+    // Nothing is copied until an overdub writes into the second repetition.
     loopLengthSamples *= 2;
+
+    // A pass in progress continues in a layer covering the new length
+    if (currentState.load() == State::Overdubbing)
+        loopImage.pushLayer(loopLengthSamples);
 }
 
 void LoopTrack::divideLoop()
@@ -385,7 +421,10 @@ void LoopTrack::divideLoop()
     
     saveUndo();
     
+    // Metadata only: content past the new length is no longer repeated
     loopLengthSamples /= 2;
+    loopImage.clampPeriods(loopLengthSamples);
+    invalidateFlatten();
 }
 
 //==============================================================================
@@ -398,11 +437,17 @@ void LoopTrack::setRecording()
     // Use 'Overdub' to add to existing.
     if (currentState.load() == State::Empty)
     {
+        if (!retireContent())
+        {
+            TRACE(ClearedContentHeld, index);
+            return;
+        }
+
         playbackPosition = 0;
         loopLengthSamples = 0; // Reset length
         recordedSamplesCurrent = 0;
         
-        LOG("LoopTrack: RECORDING started | targetMult=" + juce::String(targetMultiplier));
+        TRACE(RecordingStarted, index, targetMultiplier);
         
         currentState.store(State::Recording);
     }
@@ -418,53 +463,75 @@ void LoopTrack::setOverdubbing()
         if (currentState.load() != State::Overdubbing)
         {
             saveUndo();
+
+            // Each pass gets its own layer; once all are in use the pass goes into the top one
+            if (loopImage.getNumLayers() == LoopImage::maxLayers)
+                invalidateFlatten();
+            loopImage.pushLayer(loopLengthSamples);
         }
 
         currentState.store(State::Overdubbing);
     }
 }
 
-void LoopTrack::setPlaying()
+void LoopTrack::finishFirstRecording()
 {
-    // If we were recording, this transition DEFINES the loop length
-    if (currentState.load() == State::Recording)
+    // If master track (linear recording), use playbackPosition
+    if (playbackPosition > 0)
     {
-        // If master track (linear recording), use playbackPosition
-        if (playbackPosition > 0)
-        {
-            loopLengthSamples = playbackPosition;
-            LOG("LoopTrack: MASTER REC->PLAY | len=" + juce::String(loopLengthSamples) + 
-                " playbackPos=" + juce::String(playbackPosition));
-        }
-        else if (recordedSamplesCurrent > 0)
-        {
-            // SLAVE TRACK Logic
-            // If we recorded as a slave, the loop length is handled externally or implicitly.
-            // We ensure loopLengthSamples is valid if it wasn't already set.
-            // Note: processBlock usually sets this for slaves, but just in case:
-            if (loopLengthSamples == 0)
-                 loopLengthSamples = recordedSamplesCurrent; // Fallback
-            
-            LOG("LoopTrack: SLAVE REC->PLAY | len=" + juce::String(loopLengthSamples) + 
-                " recordedSamples=" + juce::String(recordedSamplesCurrent) + 
-                " targetMult=" + juce::String(targetMultiplier));
-        }
+        loopLengthSamples = playbackPosition;
+        TRACE(MasterRecToPlay, index, loopLengthSamples, playbackPosition);
+    }
+    else if (recordedSamplesCurrent > 0)
+    {
+        // SLAVE TRACK Logic
+        // If we recorded as a slave, the loop length is handled externally or implicitly.
+        // We ensure loopLengthSamples is valid if it wasn't already set.
+        // Note: processBlock usually sets this for slaves, but just in case:
+        if (loopLengthSamples == 0)
+             loopLengthSamples = recordedSamplesCurrent; // Fallback
         
-        playbackPosition = 0; // Reset to start for playback
-        LOG("LoopTrack: Playback position RESET to 0");
+        TRACE(SlaveRecToPlay, index, loopLengthSamples, recordedSamplesCurrent, targetMultiplier);
     }
+    
+    playbackPosition = 0; // Reset to start for playback
+    TRACE(PlaybackReset, index);
 
+    // Smooth the loop boundary to eliminate the click when recording stops
     if (loopLengthSamples > 0)
     {
-        // Smooth the loop boundary to eliminate the click when recording stops
-        applyCrossfade(loopBuffer, loopLengthSamples, 128);
+        loopImage.setBasePeriod(loopLengthSamples);
+        applyCrossfade(loopImage.getBase(), loopLengthSamples, 128);
+    }
+}
+
+void LoopTrack::setPlaying()
+{
+    const State previousState = currentState.load();
+
+    // If we were recording, this transition DEFINES the loop length
+    if (previousState == State::Recording)
+        finishFirstRecording();
+
+    if (loopLengthSamples > 0)
+    {
+        // After an overdub, smooth the boundary of the pass's own layer
+        if (previousState == State::Overdubbing && loopImage.getNumLayers() > 0)
+        {
+            int top = loopImage.getNumLayers() - 1;
+            auto& layer = loopImage.getLayer(top);
+            int period = loopImage.getLayerPeriod(top);
+            int lastPage = (period - 1) >> AudioPage::shift;
+            if (layer.getPage(0) != nullptr || layer.getPage(lastPage) != nullptr)
+                applyCrossfade(layer, period, 128);
+        }
 
         currentState.store(State::Playing);
-        LOG("LoopTrack: State = PLAYING");
+        TRACE(StatePlaying, index);
     }
     else
     {
-        LOG_ERROR("LoopTrack: Cannot play - loopLength is 0!");
+        TRACE(PlayWithoutLoop, index);
     }
 }
 
@@ -472,10 +539,7 @@ void LoopTrack::stop()
 {
     // If we press stop while recording, we define the loop length but go silent
     if (currentState.load() == State::Recording)
-    {
-        loopLengthSamples = playbackPosition;
-        playbackPosition = 0;
-    }
+        finishFirstRecording();
     
     if (loopLengthSamples > 0)
     {
@@ -486,13 +550,31 @@ void LoopTrack::stop()
 
 void LoopTrack::setLoopFromMix(const juce::AudioBuffer<float>& mixedBuffer, int length, int startOffset, juce::int64 startGlobalSample)
 {
-    if (length <= 0 || length > loopBuffer.getNumSamples()) return;
+    if (length <= 0 || length > loopImage.getCapacity()) return;
+
+    // Check before touching anything: the fresh pages below must not fail halfway
+    if (!loopImage.getBase().canAllocate(length))
+    {
+        TRACE(LoopFromMixNoPages, index);
+        return;
+    }
+    if (!retireContent())
+    {
+        TRACE(ClearedContentHeld, index);
+        return;
+    }
 
     saveUndo();
 
-    loopBuffer.clear();
-    for (int ch = 0; ch < juce::jmin(loopBuffer.getNumChannels(), mixedBuffer.getNumChannels()); ++ch)
-        loopBuffer.copyFrom(ch, 0, mixedBuffer, ch, 0, length);
+    // The old content lives on in the undo snapshot; start from fresh pages
+    // rather than copying shared ones we are about to overwrite.
+    loopImage.releaseAll();
+    loopImage.getBase().ensureAllocated(0, length);
+    loopImage.setBasePeriod(length);
+    invalidateFlatten();
+
+    for (int ch = 0; ch < juce::jmin(loopImage.getNumChannels(), mixedBuffer.getNumChannels()); ++ch)
+        loopImage.getBase().copyFrom(ch, 0, mixedBuffer.getReadPointer(ch), length);
 
     loopLengthSamples = length;
     playbackPosition = 0;
@@ -501,7 +583,7 @@ void LoopTrack::setLoopFromMix(const juce::AudioBuffer<float>& mixedBuffer, int
     recordingStartGlobalSample = startGlobalSample;
     currentState.store(State::Playing);
 
-    LOG("LoopTrack::setLoopFromMix | len=" + juce::String(length) + " offset=" + juce::String(startOffset) + " globalSample=" + juce::String(startGlobalSample));
+    TRACE(LoopFromMix, index, length, startOffset, startGlobalSample);
 }
 
 void LoopTrack::overdubFromBuffer(const juce::AudioBuffer<float>& inputBuffer, int inputLength, juce::int64 inputStartGlobalSample)
@@ -515,8 +597,13 @@ void LoopTrack::overdubFromBuffer(const juce::AudioBuffer<float>& inputBuffer, i
     if (elapsed < 0) elapsed = 0;
     int writeStart = static_cast<int>(elapsed % loopLengthSamples);
 
-    // Add input audio on top of existing loop buffer, with wrapping
-    int numCh = juce::jmin(loopBuffer.getNumChannels(), inputBuffer.getNumChannels());
+    // Add input audio as a new layer on top of the existing loop, with wrapping
+    if (loopImage.getNumLayers() == LoopImage::maxLayers)
+        invalidateFlatten();
+    auto& layer = loopImage.pushLayer(loopLengthSamples);
+    const int layerPeriod = loopImage.getLayerPeriod(loopImage.getNumLayers() - 1);
+
+    int numCh = juce::jmin(loopImage.getNumChannels(), inputBuffer.getNumChannels());
     for (int ch = 0; ch < numCh; ++ch)
     {
         int remaining = inputLength;
@@ -527,7 +614,9 @@ void LoopTrack::overdubFromBuffer(const juce::AudioBuffer<float>& inputBuffer, i
         {
             int toEnd = loopLengthSamples - dstPos;
             int chunk = juce::jmin(remaining, toEnd);
-            loopBuffer.addFrom(ch, dstPos, inputBuffer, ch, srcOffset, chunk);
+            int writable = juce::jmin(chunk, layerPeriod - dstPos);
+            if (writable > 0)
+                layer.addFrom(ch, dstPos, inputBuffer.getReadPointer(ch, srcOffset), writable);
             srcOffset += chunk;
             dstPos += chunk;
             if (dstPos >= loopLengthSamples) dstPos = 0;
@@ -535,8 +624,61 @@ void LoopTrack::overdubFromBuffer(const juce::AudioBuffer<float>& inputBuffer, i
         }
     }
 
-    LOG("LoopTrack::overdubFromBuffer | inputLen=" + juce::String(inputLength) +
-        " writeStart=" + juce::String(writeStart) + " loopLen=" + juce::String(loopLengthSamples));
+    TRACE(OverdubFromBuffer, index, inputLength, writeStart, loopLengthSamples);
+}
+
+//==============================================================================
+// Layers
+
+void LoopTrack::serviceLayers()
+{
+    State state = currentState.load();
+
+    // 1. Layer edits requested by the UI (a pass can't be deleted while it is being written)
+    int op = pendingLayerOp.exchange(0);
+    if (op != 0)
+    {
+        auto type = (LayerOp)(op >> 8);
+        int index = op & 0xff;
+        if (index < loopImage.getNumLayers())
+        {
+            if (type == LayerOp::Delete && state != State::Overdubbing)
+            {
+                saveUndo();
+                loopImage.removeLayer(index);
+            }
+            else if (type == LayerOp::Mute || type == LayerOp::Unmute)
+            {
+                loopImage.setLayerMuted(index, type == LayerOp::Mute);
+                ++contentGeneration;
+            }
+            invalidateFlatten();
+        }
+    }
+
+    // 2. Install a finished merge, unless the image changed since it was started
+    if (flattenJob.status.load() == FlattenJob::Done)
+    {
+        if (flattenJob.generation == imageGeneration)
+        {
+            flattenJob.install(loopImage);
+            invalidateFlatten();
+        }
+        else
+        {
+            flattenJob.reset();
+        }
+    }
+
+    // 3. Too many passes: merge the oldest audible one into the base in the background
+    if (flattenJob.status.load() == FlattenJob::Idle
+        && loopImage.getNumLayers() > maxLayers
+        && state != State::Recording && state != State::Overdubbing && !mReplace.active)
+    {
+        int index = loopImage.getOldestMergeableLayer();
+        if (index >= 0)
+            flattenJob.start(loopImage, index, imageGeneration);
+    }
 }
 
 //==============================================================================
@@ -548,7 +690,9 @@ void LoopTrack::handleRecording(const juce::AudioBuffer<float>& inputBuffer, int
     // We just write linearly into the buffer.
     
     // Safety check: don't overflow the max allocated buffer
-    if (startWritePos + numSamples >= loopBuffer.getNumSamples())
+    // (or the page pool, if the background thread can't keep up)
+    if (startWritePos + numSamples >= loopImage.getCapacity()
+        || !loopImage.getBase().ensureAllocated(startWritePos, numSamples))
     {
         // Handle buffer overflow (auto-finish loop or stop)
         setPlaying(); 
@@ -558,13 +702,13 @@ void LoopTrack::handleRecording(const juce::AudioBuffer<float>& inputBuffer, int
     }
 
     // Copy input to loop buffer
-    for (int channel = 0; channel < juce::jmin(inputBuffer.getNumChannels(), loopBuffer.getNumChannels()); ++channel)
+    for (int channel = 0; channel < juce::jmin(inputBuffer.getNumChannels(), loopImage.getNumChannels()); ++channel)
     {
-        loopBuffer.copyFrom(channel, startWritePos, inputBuffer, channel, 0, numSamples);
+        loopImage.getBase().copyFrom(channel, startWritePos, inputBuffer.getReadPointer(channel), numSamples);
     }
 }
 
-void LoopTrack::handlePlayback(juce::AudioBuffer<float>& outputBuffer, int numSamples, int startReadPos, int loopEndRes, bool shouldBeSilent)
+void LoopTrack::handlePlayback(int numSamples, int startReadPos, int loopEndRes, bool shouldBeSilent)
 {
     if (loopEndRes <= 0)
         return;
@@ -582,12 +726,13 @@ void LoopTrack::handlePlayback(juce::AudioBuffer<float>& outputBuffer, int numSa
     if (isMuted.load())
         return;
 
-    float currentGain = gain.load();
+    // Unity gain: the volume is applied when the processor mixes the bus
+    beginOutput(numSamples);
 
     // During progressive replace, read from the source buffer (complete correct audio)
     // so there's no discontinuity between replaced and unreplaced regions.
-    const juce::AudioBuffer<float>& readBuf =
-        (mReplace.active && mReplace.source) ? *mReplace.source : loopBuffer;
+    const juce::AudioBuffer<float>* replaceSource =
+        (mReplace.active && mReplace.source) ? &mReplace.source->audio : nullptr;
 
     // Circular buffer read
     int samplesToDo = numSamples;
@@ -607,9 +752,12 @@ void LoopTrack::handlePlayback(juce::AudioBuffer<float>& outputBuffer, int numSa
              break;
 
         // Add loop content to main output (Summing)
-        for (int channel = 0; channel < juce::jmin(outputBuffer.getNumChannels(), readBuf.getNumChannels()); ++channel)
+        for (int channel = 0; channel < juce::jmin(outputBuffer.getNumChannels(), loopImage.getNumChannels()); ++channel)
         {
-            outputBuffer.addFrom(channel, currentOutputOffset, readBuf, channel, localReadPos, chunk, currentGain);
+            if (replaceSource != nullptr)
+                outputBuffer.copyFrom(channel, currentOutputOffset, *replaceSource, channel, localReadPos, chunk);
+            else
+                loopImage.addTo(channel, localReadPos, outputBuffer.getWritePointer(channel, currentOutputOffset), chunk);
         }
 
         currentOutputOffset += chunk;
@@ -626,6 +774,13 @@ void LoopTrack::captureSidechain(const juce::AudioBuffer<float>& sidechainBuffer
 {
     if (loopEndRes <= 0) return;
 
+    // The loop changed length (multiply, divide, undo): the pass starts over
+    if (loopEndRes != fxCaptureLength)
+    {
+        fxCaptureLength = loopEndRes;
+        fxCaptureSamplesWritten = 0;
+    }
+
     int samplesToDo = numSamples;
     int srcOffset = 0;
     int localPos = startWritePos;
@@ -639,9 +794,16 @@ void LoopTrack::captureSidechain(const juce::AudioBuffer<float>& sidechainBuffer
         int chunk = juce::jmin(samplesToDo, samplesToEnd);
         if (chunk <= 0) break;
 
+        bool written = true;
         for (int ch = 0; ch < juce::jmin(sidechainBuffer.getNumChannels(), fxCaptureBuffer.getNumChannels()); ++ch)
+            written = fxCaptureBuffer.copyFrom(ch, localPos, sidechainBuffer.getReadPointer(ch, srcOffset), chunk) && written;
+
+        // A capture with holes would become a loop with holes
+        if (!written)
         {
-            fxCaptureBuffer.copyFrom(ch, localPos, sidechainBuffer, ch, srcOffset, chunk);
+            TRACE(FxReplaceNoPages, index);
+            cancelFxCapture();
+            return;
         }
 
         srcOffset += chunk;
@@ -652,41 +814,76 @@ void LoopTrack::captureSidechain(const juce::AudioBuffer<float>& sidechainBuffer
         if (localPos >= loopEndRes)
             localPos = 0;
     }
+
+    if (fxCaptureSamplesWritten >= loopEndRes)
+        applyFxReplace();
 }
 
-void LoopTrack::applyFxReplace()
+void LoopTrack::toggleFxReplace()
 {
+    if (fxCaptureArmed.load())
+    {
+        cancelFxCapture();
+        return;
+    }
     if (loopLengthSamples <= 0) return;
-    if (fxCaptureSamplesWritten < loopLengthSamples) return;
 
+    fxCaptureSamplesWritten = 0;
+    fxCaptureLength = loopLengthSamples;
+    fxCaptureArmed.store(true);
+    TRACE(FxReplaceArmed, index, loopLengthSamples);
+}
+
+void LoopTrack::cancelFxCapture()
+{
+    fxCaptureArmed.store(false);
+    fxCaptureSamplesWritten = 0;
+    fxCaptureBuffer.releaseAll();
+}
+
+void LoopTrack::applyFxReplace()
+{
     saveUndo();
 
-    for (int ch = 0; ch < juce::jmin(loopBuffer.getNumChannels(), fxCaptureBuffer.getNumChannels()); ++ch)
-    {
-        loopBuffer.copyFrom(ch, 0, fxCaptureBuffer, ch, 0, loopLengthSamples);
-    }
+    // The capture already holds a full loop: take its pages instead of copying.
+    // The old loop pages stay referenced by the undo snapshot only; the next
+    // capture pass starts on fresh pages.
+    loopImage.releaseAll();
+    loopImage.getBase().swapWith(fxCaptureBuffer);
+    loopImage.setBasePeriod(loopLengthSamples);
+    invalidateFlatten();
 
     fxCaptureSamplesWritten = 0;
-    LOG("FX Replace applied | loopLen=" + juce::String(loopLengthSamples));
+    fxCaptureArmed.store(false);
+    TRACE(FxReplaceApplied, index, loopLengthSamples);
 }
 
-void LoopTrack::handleOverdub(juce::AudioBuffer<float>& outputBuffer, const juce::AudioBuffer<float>& inputBuffer, int numSamples, int startReadPos, int loopEndRes, bool shouldBeSilent)
+void LoopTrack::handleOverdub(const juce::AudioBuffer<float>& inputBuffer, int numSamples, int startReadPos, int loopEndRes, bool shouldBeSilent)
 {
     if (loopEndRes <= 0) return;
 
-    // Overdub = Playback existing + Write new input on top
+    // Overdub = Playback existing + Write new input on top, into this pass's layer
+    if (loopImage.getNumLayers() == 0) return;
+    ++contentGeneration;
+    auto& layer = loopImage.getLayer(loopImage.getNumLayers() - 1);
+
+    // Normally the loop length; shorter only when every layer was already in use
+    const int layerPeriod = loopImage.getLayerPeriod(loopImage.getNumLayers() - 1);
     
     // Cache atomic values
     bool muted = isMuted.load();
-    float currentGain = gain.load();
     
     // During progressive replace, read from the source buffer
-    const juce::AudioBuffer<float>& readBuf =
-        (mReplace.active && mReplace.source) ? *mReplace.source : loopBuffer;
+    const juce::AudioBuffer<float>* replaceSource =
+        (mReplace.active && mReplace.source) ? &mReplace.source->audio : nullptr;
     
     // If effective silence is forced (e.g. valid loop but soloed out), we treat as muted output
     if (shouldBeSilent) muted = true;
 
+    // Unity gain: the volume is applied when the processor mixes the bus
+    if (!muted)
+        beginOutput(numSamples);
+
     int samplesToDo = numSamples;
     int currentOffset = 0;
     int localPos = startReadPos;
@@ -702,16 +899,27 @@ void LoopTrack::handleOverdub(juce::AudioBuffer<float>& outputBuffer, const juce
         
         if (chunk <= 0) break;
 
-        for (int channel = 0; channel < juce::jmin(outputBuffer.getNumChannels(), loopBuffer.getNumChannels()); ++channel)
+        for (int channel = 0; channel < juce::jmin(outputBuffer.getNumChannels(), loopImage.getNumChannels()); ++channel)
         {
-            // 1. Output the existing loop audio (if not muted)
-            if (!muted)
+            const float* input = inputBuffer.getReadPointer(channel, currentOffset);
+
+            // Common case: play the loop and add the input to this pass's layer in one sweep
+            // (no feedback control in this looper: previous passes are kept as they are)
+            if (!muted && replaceSource == nullptr)
             {
-                outputBuffer.addFrom(channel, currentOffset, readBuf, channel, localPos, chunk, currentGain);
+                loopImage.overdubTop(channel, localPos, outputBuffer.getWritePointer(channel, currentOffset),
+                                     input, chunk);
+                continue;
             }
 
+            // 1. Output the existing loop audio (if not muted)
+            if (!muted)
+                outputBuffer.copyFrom(channel, currentOffset, *replaceSource, channel, localPos, chunk);
+
             // 2. Input -> Add to Storage (Constructive interference / Summing)
-            loopBuffer.addFrom(channel, localPos, inputBuffer, channel, currentOffset, chunk);
+            int writable = juce::jmin(chunk, layerPeriod - localPos);
+            if (writable > 0)
+                layer.addFrom(channel, localPos, input, writable);
         }
 
         currentOffset += chunk;
@@ -723,13 +931,30 @@ void LoopTrack::handleOverdub(juce::AudioBuffer<float>& outputBuffer, const juce
     }
 }
 
-void LoopTrack::beginProgressiveReplace(const juce::AudioBuffer<float>* source, int length,
+void LoopTrack::beginProgressiveReplace(StagingBuffer* source, int length,
                                          int startOffset, juce::int64 startGlobal)
 {
-    if (!source || length <= 0 || length > loopBuffer.getNumSamples()) return;
+    if (!source || length <= 0 || length > loopImage.getCapacity()
+        || length > source->audio.getNumSamples()) return;
+
+    if (!retireContent())
+    {
+        TRACE(ClearedContentHeld, index);
+        return;
+    }
+
+    // Take the new reference first: source may be the buffer being replaced from
+    StagingBufferPool::retain(source);
+    cancelReplace();
 
     saveUndo();
 
+    // Playback reads the source until the copy completes, so the old pages
+    // (still held by the undo snapshot) can be dropped instead of copied-on-write.
+    loopImage.releaseAll();
+    loopImage.setBasePeriod(length);
+    invalidateFlatten();
+
     mReplace.source    = source;
     mReplace.length    = length;
     mReplace.cursor    = 0;
@@ -746,16 +971,18 @@ void LoopTrack::beginProgressiveReplace(const juce::AudioBuffer<float>* source,
     if (currentState.load() == State::Empty)
         currentState.store(State::Playing);
 
-    LOG("beginProgressiveReplace | len=" + juce::String(length));
+    TRACE(ReplaceBegin, index, length);
 }
 
 void LoopTrack::processReplaceChunk(int playheadPos, int blockSize)
 {
     if (!mReplace.active || !mReplace.source) return;
 
-    int numCh = juce::jmin(loopBuffer.getNumChannels(), mReplace.source->getNumChannels());
+    const auto& source = mReplace.source->audio;
+    int numCh = juce::jmin(loopImage.getNumChannels(), source.getNumChannels());
     int len   = mReplace.length;
 
+    // Returns how many samples were copied (less than count if the page pool ran dry)
     auto copyRegion = [&](int startPos, int count) {
         int pos = startPos;
         int rem = count;
@@ -763,31 +990,40 @@ void LoopTrack::processReplaceChunk(int playheadPos, int blockSize)
             if (pos >= len) pos -= len;
             int toEnd = len - pos;
             int chunk  = juce::jmin(rem, toEnd);
+            if (!loopImage.getBase().ensureAllocated(pos, chunk))
+                break;
             for (int ch = 0; ch < numCh; ++ch)
-                loopBuffer.copyFrom(ch, pos, *mReplace.source, ch, pos, chunk);
+                loopImage.getBase().copyFrom(ch, pos, source.getReadPointer(ch, pos), chunk);
             pos += chunk;
             rem -= chunk;
         }
+        return count - rem;
     };
 
     // Sequential fill only  safe because playback reads from mReplace.source,
-    // not from loopBuffer. No read/write conflict possible.
+    // not from loopImage. No read/write conflict possible.
     int budget = juce::jmin(blockSize * 16, mReplace.remaining);
     if (budget > 0)
     {
-        copyRegion(mReplace.cursor, budget);
-        mReplace.cursor    = (mReplace.cursor + budget) % len;
-        mReplace.remaining -= budget;
+        int copied = copyRegion(mReplace.cursor, budget);
+        mReplace.cursor    = (mReplace.cursor + copied) % len;
+        mReplace.remaining -= copied;
     }
 
     if (mReplace.remaining <= 0)
     {
-        mReplace.active = false;
-        mReplace.source = nullptr;
-        LOG("Progressive replace complete");
+        cancelReplace(); // done: hand the staging buffer back
+        TRACE(ReplaceComplete, index);
     }
 }
 
+void LoopTrack::cancelReplace()
+{
+    StagingBufferPool::release(mReplace.source);
+    mReplace.source = nullptr;
+    mReplace.active = false;
+}
+
 void LoopTrack::applyCrossfade(juce::AudioBuffer<float>& buffer, int loopLength, int fadeSamples)
 {
     if (loopLength <= 0 || fadeSamples <= 0) return;
@@ -813,3 +1049,26 @@ void LoopTrack::applyCrossfade(juce::AudioBuffer<float>& buffer, int loopLength,
         }
     }
 }
+
+void LoopTrack::applyCrossfade(PagedBuffer& buffer, int loopLength, int fadeSamples)
+{
+    if (loopLength <= 0 || fadeSamples <= 0) return;
+    fadeSamples = juce::jmin(fadeSamples, loopLength / 2);
+
+    // Same blend as the AudioBuffer version, sample by sample through the page table
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        for (int i = 0; i < fadeSamples; ++i)
+        {
+            float fadeIn  = (float)i / (float)fadeSamples;
+            float fadeOut = 1.0f - fadeIn;
+
+            int tailPos = loopLength - fadeSamples + i;
+            float headSample = buffer.getSample(ch, i);
+            float tailSample = buffer.getSample(ch, tailPos);
+
+            buffer.setSample(ch, i,       headSample * fadeIn + tailSample * fadeOut);
+            buffer.setSample(ch, tailPos, tailSample * fadeOut + headSample * fadeIn);
+        }
+    }
+}
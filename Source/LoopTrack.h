@@ -1,7 +1,12 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
 #include <atomic>
+#include "PagedBuffer.h"
+#include "LoopImage.h"
+#include "LoopHistory.h"
+#include "StagingBuffer.h"
 
 /**
     Represents a single independent loop track with a state machine and circular buffer.
@@ -22,24 +27,34 @@ public:
     ~LoopTrack();
 
     //==============================================================================
-    /** PREPARE: Allocates memory and sets sample rate. 
-        maxLoopLengthSeconds determines the buffer size. */
-    void prepareToPlay(double sampleRate, int samplesPerBlock);
+    /** PREPARE: Sizes the page tables and sets sample rate.
+        maxLoopLengthSeconds determines the maximum loop length; sample memory
+        is drawn from the shared pool only as the loop is recorded. */
+    void prepareToPlay(double sampleRate, int samplesPerBlock, PagePool& pool);
 
     /** PROCESS: Main audio callback.
-        - outputBuffer: The main mix to add our loop audio to.
-        - inputBuffer: The incoming audio to record/overdub.
+        - inputBuffer: The incoming audio to record/overdub (its length is the block length).
         - globalTotalSamples: The total monotonic sample count since transport start (for global sync).
         - isMasterTrack: If true, this track is defining the master loop length.
         - masterLoopLength: The length of the master loop in samples.
-        - anySoloActive: If true, track only plays if it is soloed. */
-     void processBlock(juce::AudioBuffer<float>& outputBuffer, const juce::AudioBuffer<float>& inputBuffer,
+        - anySoloActive: If true, track only plays if it is soloed.
+        Returns true if the track played: its audio is then in getOutput(), without the
+        volume applied (the processor mixes every track of a bus in one pass). */
+    bool processBlock(const juce::AudioBuffer<float>& inputBuffer,
                       const juce::AudioBuffer<float>& sidechainBuffer,
                       juce::int64 globalTotalSamples, bool isMasterTrack, int masterLoopLength, bool anySoloActive);
 
-    /** RESET: Clears the buffer and state. */
+    /** Playback of the last processBlock (first inputBuffer.getNumSamples() samples), at unity gain. */
+    const juce::AudioBuffer<float>& getOutput() const { return outputBuffer; }
+    float getVolume() const { return gain.load(); }
+
+    /** RESET: Clears the buffer and state. O(1): the pages are released by runBackgroundTasks(). */
     void clear();
 
+    /** BACKGROUND: merges a pending overdub layer and releases cleared content.
+        Must run on the page pool's maintenance thread. Returns true if there was work. */
+    bool runBackgroundTasks();
+
     //==============================================================================
     // State Controls
     void setRecording();
@@ -50,11 +65,14 @@ public:
     void setVolume(float newVolume) { gain.store(newVolume); }
     void setMuted(bool shouldBeMuted) { isMuted.store(shouldBeMuted); }
     void setSolo(bool shouldBeSolo) { isSolo.store(shouldBeSolo); }
-    // FX Replace: one-shot apply of captured sidechain audio
-    void applyFxReplace();
-    bool isFxCaptureReady() const { return loopLengthSamples > 0 && fxCaptureSamplesWritten >= loopLengthSamples; }
+    // FX Replace: arms a capture of the sidechain over the next full loop pass, which
+    // then replaces the loop (or cancels the capture in progress). Capture pages are
+    // only taken while armed; the page pool running dry cancels the capture.
+    void toggleFxReplace();
+    bool isFxCaptureArmed() const { return fxCaptureArmed.load(); }
     
     // Configuration
+    void setIndex(int newIndex) { index = newIndex; } // track number in trace records
     void setTargetMultiplier(float multiplier) 
     { 
         if (multiplier < 1.0f / 64.0f) multiplier = 1.0f / 64.0f;
@@ -70,9 +88,12 @@ public:
     bool isMutedState() const { return isMuted.load(); }
 
     // Buffer access (for bounce back / after loop)
-    const juce::AudioBuffer<float>& getLoopBuffer() const { return loopBuffer; }
+    const LoopImage& getLoopImage() const { return loopImage; }
     int getRecordingStartOffset() const { return recordingStartOffset; }
     juce::int64 getRecordingStartGlobalSample() const { return recordingStartGlobalSample; }
+    /** AUDIO: changes with every edit of what the loop plays (overdub, undo, clear, ...), so
+        a result computed from an earlier snapshot can tell it is stale. */
+    juce::uint32 getContentGeneration() const { return contentGeneration; }
     void setLoopFromMix(const juce::AudioBuffer<float>& mixedBuffer, int length, int startOffset = 0, juce::int64 startGlobalSample = 0);
     void overdubFromBuffer(const juce::AudioBuffer<float>& inputBuffer, int inputLength, juce::int64 inputStartGlobalSample);
 
@@ -80,22 +101,45 @@ public:
     void multiplyLoop();
     void divideLoop();
     void performUndo();
-    bool canUndo() const { return hasUndo; }
+    void performRedo();
+    bool canUndo() const { return history.canUndo(); }
+    bool canRedo() const { return history.canRedo(); }
+    int getNumUndoLevels() const { return history.getNumUndoLevels(); }
+
+    // History size: levels kept and memory cap (pages not shared with the live loop)
+    void setUndoDepth(int levels) { if (levels != history.getDepth()) history.setDepth(levels); }
+    void setUndoBudgetPages(int pages) { history.setBudgetPages(pages); }
+
+    // Overdub layers: one per pass, merged into the base in the background
+    // once there are more than maxLayers (1..LoopImage::maxLayers).
+    void setMaxLayers(int layers) { maxLayers = juce::jlimit(1, LoopImage::maxLayers, layers); }
+    int getNumLayers() const { return loopImage.getNumLayers(); }
+    bool isLayerMuted(int index) const { return index < loopImage.getNumLayers() && loopImage.isLayerMuted(index); }
+
+    // Layer edits from the UI thread, applied at the start of the next block
+    void requestLayerMute(int index, bool shouldBeMuted) { pendingLayerOp.store(encodeLayerOp(shouldBeMuted ? LayerOp::Mute : LayerOp::Unmute, index)); }
+    void requestLayerDelete(int index) { pendingLayerOp.store(encodeLayerOp(LayerOp::Delete, index)); }
 
     // Crossfade utility: smooth the loop boundary to avoid clicks
     static void applyCrossfade(juce::AudioBuffer<float>& buffer, int loopLength, int fadeSamples);
+    static void applyCrossfade(PagedBuffer& buffer, int loopLength, int fadeSamples);
 
     // Progressive buffer replacement: spreads copy over multiple processBlock calls.
     // Playhead region is refreshed first so audio is immediately correct.
-    void beginProgressiveReplace(const juce::AudioBuffer<float>* source, int length,
+    // The track holds a reference on source until the copy completes or is cancelled.
+    void beginProgressiveReplace(StagingBuffer* source, int length,
                                  int startOffset = 0, juce::int64 startGlobal = 0);
     void processReplaceChunk(int playheadPos, int blockSize);
     bool isReplacing() const { return mReplace.active; }
+    /** Buffer playback reads from while a replace is in progress, else nullptr. */
+    StagingBuffer* getReplaceSource() const { return mReplace.active ? mReplace.source : nullptr; }
 
 private:
+    void cancelReplace();
+
     // Progressive replace state
     struct ProgressiveReplace {
-        const juce::AudioBuffer<float>* source = nullptr;
+        StagingBuffer* source = nullptr;
         int length = 0;
         int cursor = 0;
         int remaining = 0;
@@ -104,10 +148,12 @@ private:
     ProgressiveReplace mReplace;
 
     // Audio Data
-    juce::AudioBuffer<float> loopBuffer;
-    juce::AudioBuffer<float> undoBuffer; // Buffer for undo state
-    juce::AudioBuffer<float> fxCaptureBuffer; // Staging buffer for FX Replace
+    LoopImage loopImage;    // Base recording + overdub layers
+    LoopHistory history;    // Undo/redo levels (copy-on-write snapshots)
+    PagedBuffer fxCaptureBuffer; // Staging buffer for FX Replace
     int fxCaptureSamplesWritten = 0;
+    int fxCaptureLength = 0;     // loop length the capture is for
+    std::atomic<bool> fxCaptureArmed { false };
     double trackSampleRate = 44100.0;
     
     // Playback/Recording Logic
@@ -116,6 +162,10 @@ private:
     std::atomic<bool> isMuted { false };
     std::atomic<bool> isSolo { false }; // New Solo state
 
+    // Rendered playback (unity gain), mixed into the output bus by the processor
+    juce::AudioBuffer<float> outputBuffer;
+    bool hasOutput = false;
+
     int playbackPosition = 0;       // Current read/write head position
     int loopLengthSamples = 0;      // Defined after first recording finishes
     
@@ -124,14 +174,43 @@ private:
     juce::int64 recordingStartGlobalSample = 0; // Absolute global sample count at recording start
     
     // Undo State
-    int undoLoopLengthSamples = 0;
-    bool hasUndo = false;
     void saveUndo();
 
+    // Layers
+    enum class LayerOp { None, Mute, Unmute, Delete };
+    static int encodeLayerOp(LayerOp op, int index) { return ((int)op << 8) | (index & 0xff); }
+    std::atomic<int> pendingLayerOp { 0 };
+    int maxLayers = 4;
+
+    FlattenJob flattenJob;
+    juce::uint32 imageGeneration = 0; // bumped by every edit a pending flatten would miss
+    void invalidateFlatten() { ++imageGeneration; }
+    juce::uint32 contentGeneration = 0; // bumped by every audible edit (getContentGeneration)
+    void serviceLayers();
+
+    // Content dropped by clear(): swapped out in O(1), released in the background.
+    // A ring of slots, so clears in quick succession don't wait for the background
+    // thread. If every slot is still pending the cleared content stays in place,
+    // silent, until a slot frees up; edits that would build on it are refused.
+    struct RetiredContent
+    {
+        LoopImage image;
+        PagedBuffer fxCapture;
+        LoopHistory history;
+        std::atomic<bool> pending { false };
+    };
+    static constexpr int numRetiredSlots = 4;
+    std::array<RetiredContent, numRetiredSlots> retired;
+    int nextRetired = 0;            // the slot the next clear fills
+    bool retireHeld = false;        // cleared content not swapped out yet
+    /** Swaps held content into the next slot. False if it's still pending. */
+    bool retireContent();
+
     // Configuration
+    int index = -1;
     float targetMultiplier = 1.0f; // How many bars (relative to master) to record
     
-    // Allocating 5 minutes per track by default to avoid reallocation on audio thread
+    // Page tables cover 5 minutes per track; pages themselves come from the pool on demand
     const int maxLoopLengthSeconds = 300; 
     
     // For fixed length recording
@@ -139,9 +218,17 @@ private:
 
     // Helpers
     void handleRecording(const juce::AudioBuffer<float>& inputBuffer, int numSamples, int startWritePos);
-    void handlePlayback(juce::AudioBuffer<float>& outputBuffer, int numSamples, int startReadPos, int loopEndRes, bool shouldBeSilent);
-    void handleOverdub(juce::AudioBuffer<float>& outputBuffer, const juce::AudioBuffer<float>& inputBuffer, int numSamples, int startReadPos, int loopEndRes, bool shouldBeSilent);
+    void handlePlayback(int numSamples, int startReadPos, int loopEndRes, bool shouldBeSilent);
+    void handleOverdub(const juce::AudioBuffer<float>& inputBuffer, int numSamples, int startReadPos, int loopEndRes, bool shouldBeSilent);
+    /** Clears the start of outputBuffer for this block's playback. */
+    void beginOutput(int numSamples);
+    /** Recording -> Playing or Stopped: defines the loop length and smooths the
+        base's boundary. */
+    void finishFirstRecording();
     void captureSidechain(const juce::AudioBuffer<float>& sidechainBuffer, int numSamples, int startWritePos, int loopEndRes);
+    /** A full pass captured: its pages become the loop. */
+    void applyFxReplace();
+    void cancelFxCapture();
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LoopTrack)
 };
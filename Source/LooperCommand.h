@@ -0,0 +1,55 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "LockFreeQueue.h"
+
+/**
+    One looper action, stamped with the sample at which it must take effect.
+    The time is on the processor's free-running sample clock (see
+    SimpleLooperAudioProcessor::getCommandTime), so processBlock can split the
+    block exactly where the command lands.
+*/
+struct LooperCommand
+{
+    enum class Type
+    {
+        RecPlay,    // Empty -> Recording -> Playing -> Overdubbing -> Playing ...
+        Stop,
+        Undo,
+        Redo,
+        Multiply,
+        Divide,
+        AfterLoop,
+        Clear,
+        FxReplace,
+        Bounce,     // global (track ignored)
+        Reset       // global (track ignored)
+    };
+
+    Type type = Type::Stop;
+    int track = 0;
+    juce::int64 sampleTime = 0;
+    juce::uint32 generation = 0; // Reset: the reset generation it starts (0: the next one)
+};
+
+/** Display name (menus, logs). */
+inline const char* getCommandName(LooperCommand::Type type)
+{
+    switch (type)
+    {
+        case LooperCommand::Type::RecPlay:   return "Rec/Play";
+        case LooperCommand::Type::Stop:      return "Stop";
+        case LooperCommand::Type::Undo:      return "Undo";
+        case LooperCommand::Type::Redo:      return "Redo";
+        case LooperCommand::Type::Multiply:  return "Multiply";
+        case LooperCommand::Type::Divide:    return "Divide";
+        case LooperCommand::Type::AfterLoop: return "After Loop";
+        case LooperCommand::Type::Clear:     return "Clear";
+        case LooperCommand::Type::FxReplace: return "FX Replace";
+        case LooperCommand::Type::Bounce:    return "Bounce Back";
+        case LooperCommand::Type::Reset:     return "Reset All";
+    }
+    return "";
+}
+
+using LooperCommandQueue = LockFreeQueue<LooperCommand, 256>;
@@ -0,0 +1,81 @@
+#include "MidiLearn.h"
+
+MidiLearn::MidiLearn()
+{
+    for (auto& binding : bindings)
+        binding.store(none);
+}
+
+void MidiLearn::startLearning(LooperCommand::Type type, int track)
+{
+    learnTarget.store(encode(type, track));
+}
+
+void MidiLearn::cancelLearning()
+{
+    learnTarget.store(none);
+}
+
+void MidiLearn::forget(LooperCommand::Type type, int track)
+{
+    const int target = encode(type, track);
+    for (auto& binding : bindings)
+    {
+        int expected = target;
+        binding.compare_exchange_strong(expected, none);
+    }
+}
+
+void MidiLearn::clearAll()
+{
+    for (auto& binding : bindings)
+        binding.store(none);
+}
+
+juce::String MidiLearn::describeBinding(LooperCommand::Type type, int track) const
+{
+    const int target = encode(type, track);
+    for (int slot = 0; slot < numSlots; ++slot)
+    {
+        if (bindings[(size_t)slot].load() != target) continue;
+
+        int number  = slot % 128;
+        int channel = (slot / 128) % 16;
+        auto source = (Source)(slot / (16 * 128));
+
+        juce::String name = (source == Source::Note)
+            ? "Note " + juce::MidiMessage::getMidiNoteName(number, true, true, 3)
+            : "CC " + juce::String(number);
+        return name + " / Ch " + juce::String(channel + 1);
+    }
+    return {};
+}
+
+std::vector<MidiLearn::Binding> MidiLearn::getBindings() const
+{
+    std::vector<Binding> result;
+    for (int slot = 0; slot < numSlots; ++slot)
+    {
+        const int binding = bindings[(size_t)slot].load();
+        if (binding == none) continue;
+
+        result.push_back({ (Source)(slot / (16 * 128)), (slot / 128) % 16, slot % 128,
+                           decodeType(binding), decodeTrack(binding) });
+    }
+    return result;
+}
+
+void MidiLearn::setBindings(const std::vector<Binding>& newBindings)
+{
+    clearAll();
+    for (const auto& binding : newBindings)
+    {
+        if ((int)binding.source < 0 || (int)binding.source > (int)Source::Controller
+            || binding.channel < 0 || binding.channel >= 16 || binding.number < 0 || binding.number >= 128
+            || (int)binding.type < 0 || (int)binding.type > (int)LooperCommand::Type::Reset
+            || binding.track < 0 || binding.track > 0xff)
+            continue;
+
+        bindings[(size_t)slotIndex(binding.source, binding.channel, binding.number)].store(encode(binding.type, binding.track));
+    }
+}
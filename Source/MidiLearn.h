@@ -0,0 +1,115 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <vector>
+#include "LooperCommand.h"
+
+/**
+    MIDI-learn table: note-on / CC (per channel) -> looper command.
+
+    Triggers:
+    - Note: note-on with velocity > 0 (note-off ignored)
+    - CC: value rising to >= 64 from below (pedal press; the release is ignored)
+
+    The audio thread parses the incoming MidiBuffer directly (process), so a
+    trigger lands on the exact sample offset of its event. Bindings are atomics:
+    the message thread edits them while the audio thread reads, without locks.
+    A command may have several bindings; a note/CC drives one command.
+*/
+class MidiLearn
+{
+public:
+    enum class Source { Note, Controller };
+
+    MidiLearn();
+
+    //==============================================================================
+    // Message thread
+    /** The next note-on / CC press received binds to this command. */
+    void startLearning(LooperCommand::Type type, int track);
+    void cancelLearning();
+    bool isLearning() const { return learnTarget.load() != none; }
+    bool isLearning(LooperCommand::Type type, int track) const { return learnTarget.load() == encode(type, track); }
+
+    /** Removes every binding to this command. */
+    void forget(LooperCommand::Type type, int track);
+    void clearAll();
+
+    /** e.g. "Note C3 / Ch 1", "CC 64 / Ch 2" (first binding), or empty. */
+    juce::String describeBinding(LooperCommand::Type type, int track) const;
+
+    /** One note / CC -> command binding (session state). */
+    struct Binding
+    {
+        Source source = Source::Note;
+        int channel = 0;  // 0-15
+        int number = 0;   // note or controller
+        LooperCommand::Type type = LooperCommand::Type::RecPlay;
+        int track = 0;
+    };
+
+    std::vector<Binding> getBindings() const;
+    /** Replaces every binding. Out of range entries are ignored. */
+    void setBindings(const std::vector<Binding>& newBindings);
+
+    //==============================================================================
+    /** AUDIO: calls trigger(type, track, samplePosition) for each mapped event, in order. */
+    template <typename Callback>
+    void process(const juce::MidiBuffer& midi, Callback&& trigger)
+    {
+        for (const auto metadata : midi)
+        {
+            if (metadata.numBytes < 3) continue;
+
+            const int status  = metadata.data[0] & 0xf0;
+            const int channel = metadata.data[0] & 0x0f;
+            const int number  = metadata.data[1] & 0x7f;
+            const int value   = metadata.data[2] & 0x7f;
+
+            int slot = -1;
+            if (status == 0x90 && value > 0)
+            {
+                slot = slotIndex(Source::Note, channel, number);
+            }
+            else if (status == 0xb0)
+            {
+                auto& wasHigh = controllerHigh[(size_t)(channel * 128 + number)];
+                bool isHigh = value >= 64;
+                if (isHigh && !wasHigh)
+                    slot = slotIndex(Source::Controller, channel, number);
+                wasHigh = isHigh;
+            }
+
+            if (slot < 0) continue;
+
+            // Learning: this event becomes the binding instead of triggering
+            int target = learnTarget.load();
+            if (target != none && learnTarget.compare_exchange_strong(target, none))
+            {
+                bindings[(size_t)slot].store(target);
+                continue;
+            }
+
+            int binding = bindings[(size_t)slot].load(std::memory_order_relaxed);
+            if (binding != none)
+                trigger(decodeType(binding), decodeTrack(binding), metadata.samplePosition);
+        }
+    }
+
+private:
+    static constexpr int none = -1;
+    static constexpr int numSlots = 2 * 16 * 128;
+
+    static int slotIndex(Source source, int channel, int number) { return ((int)source * 16 + channel) * 128 + number; }
+    static int encode(LooperCommand::Type type, int track) { return ((int)type << 8) | (track & 0xff); }
+    static LooperCommand::Type decodeType(int binding) { return (LooperCommand::Type)(binding >> 8); }
+    static int decodeTrack(int binding) { return binding & 0xff; }
+
+    std::array<std::atomic<int>, numSlots> bindings;
+    std::atomic<int> learnTarget { none };
+
+    // Last CC state per channel/controller, for press detection (audio thread only)
+    std::array<bool, 16 * 128> controllerHigh {};
+
+    JUCE_DECLARE_NON_COPYABLE(MidiLearn)
+};
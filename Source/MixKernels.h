@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__AVX__)
+ #include <immintrin.h>
+ #define MIXKERNELS_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+ #include <emmintrin.h>
+ #define MIXKERNELS_SSE 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+ #include <arm_neon.h>
+ #define MIXKERNELS_NEON 1
+#endif
+
+/**
+    Inner loops used to mix loop storage into audio buffers.
+    Plain C++ without JUCE so they can be built and benchmarked on their own
+    (Benchmarks/OverdubKernelBench.cpp).
+    The fixed-arity versions are written so the compiler vectorises them:
+    every source is read once and dest is read/written once per sample,
+    however many sources are summed.
+*/
+namespace MixKernels
+{
+    /** dest[i] += gain * a[i] */
+    inline void addSum1(float* __restrict dest, const float* __restrict a, float gain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += gain * a[i];
+    }
+
+    /** dest[i] += gain * (a[i] + b[i]) */
+    inline void addSum2(float* __restrict dest, const float* __restrict a, const float* __restrict b,
+                        float gain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += gain * (a[i] + b[i]);
+    }
+
+    /** dest[i] += gain * (a[i] + b[i] + c[i]) */
+    inline void addSum3(float* __restrict dest, const float* __restrict a, const float* __restrict b,
+                        const float* __restrict c, float gain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += gain * ((a[i] + b[i]) + c[i]);
+    }
+
+    /** dest[i] += gain * (a[i] + b[i] + c[i] + d[i]) */
+    inline void addSum4(float* __restrict dest, const float* __restrict a, const float* __restrict b,
+                        const float* __restrict c, const float* __restrict d, float gain, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += gain * ((a[i] + b[i]) + (c[i] + d[i]));
+    }
+
+    /** dest[i] += gain * sum(sources[k][i]), in groups of up to four sources per pass. */
+    inline void addSum(float* dest, const float* const* sources, int numSources, float gain, int numSamples)
+    {
+        int k = 0;
+        for (; k + 4 <= numSources; k += 4)
+            addSum4(dest, sources[k], sources[k + 1], sources[k + 2], sources[k + 3], gain, numSamples);
+
+        switch (numSources - k)
+        {
+            case 3: addSum3(dest, sources[k], sources[k + 1], sources[k + 2], gain, numSamples); break;
+            case 2: addSum2(dest, sources[k], sources[k + 1], gain, numSamples); break;
+            case 1: addSum1(dest, sources[k], gain, numSamples); break;
+            default: break;
+        }
+    }
+
+    //==============================================================================
+    // Bus mixing: dest[i] += sum(gains[k] * sources[k][i])
+
+    inline void addWeighted1(float* __restrict dest, const float* __restrict a, float ga, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += ga * a[i];
+    }
+
+    inline void addWeighted2(float* __restrict dest, const float* __restrict a, const float* __restrict b,
+                             float ga, float gb, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += ga * a[i] + gb * b[i];
+    }
+
+    inline void addWeighted3(float* __restrict dest, const float* __restrict a, const float* __restrict b,
+                             const float* __restrict c, float ga, float gb, float gc, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += (ga * a[i] + gb * b[i]) + gc * c[i];
+    }
+
+    inline void addWeighted4(float* __restrict dest, const float* __restrict a, const float* __restrict b,
+                             const float* __restrict c, const float* __restrict d,
+                             float ga, float gb, float gc, float gd, int numSamples)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += (ga * a[i] + gb * b[i]) + (gc * c[i] + gd * d[i]);
+    }
+
+    inline void addWeighted8(float* __restrict dest, const float* __restrict a, const float* __restrict b,
+                             const float* __restrict c, const float* __restrict d,
+                             const float* __restrict e, const float* __restrict f,
+                             const float* __restrict g, const float* __restrict h,
+                             const float* gains, int numSamples)
+    {
+        const float ga = gains[0], gb = gains[1], gc = gains[2], gd = gains[3];
+        const float ge = gains[4], gf = gains[5], gg = gains[6], gh = gains[7];
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] += ((ga * a[i] + gb * b[i]) + (gc * c[i] + gd * d[i]))
+                     + ((ge * e[i] + gf * f[i]) + (gg * g[i] + gh * h[i]));
+    }
+
+    /** dest[i] += sum(gains[k] * sources[k][i]), in groups of up to eight sources per pass,
+        so dest is read and written once per eight sources instead of once per source. */
+    inline void addWeighted(float* dest, const float* const* sources, const float* gains, int numSources, int numSamples)
+    {
+        int k = 0;
+        for (; k + 8 <= numSources; k += 8)
+            addWeighted8(dest, sources[k], sources[k + 1], sources[k + 2], sources[k + 3],
+                         sources[k + 4], sources[k + 5], sources[k + 6], sources[k + 7], gains + k, numSamples);
+
+        if (k + 4 <= numSources)
+        {
+            addWeighted4(dest, sources[k], sources[k + 1], sources[k + 2], sources[k + 3],
+                         gains[k], gains[k + 1], gains[k + 2], gains[k + 3], numSamples);
+            k += 4;
+        }
+
+        switch (numSources - k)
+        {
+            case 3: addWeighted3(dest, sources[k], sources[k + 1], sources[k + 2], gains[k], gains[k + 1], gains[k + 2], numSamples); break;
+            case 2: addWeighted2(dest, sources[k], sources[k + 1], gains[k], gains[k + 1], numSamples); break;
+            case 1: addWeighted1(dest, sources[k], gains[k], numSamples); break;
+            default: break;
+        }
+    }
+
+    //==============================================================================
+    /** Overdub in one pass over the loop:
+            out[i]  += gain * (loop[i] + other[i])     (other may be nullptr)
+            loop[i]  = loop[i] * feedback + in[i]
+        The loop is read once instead of once for playback and again for the write.
+        Scalar reference, also used for heads and tails. */
+    inline void overdubScalar(float* __restrict out, float* __restrict loop, const float* __restrict in,
+                              const float* __restrict other, float gain, float feedback, int numSamples)
+    {
+        if (other != nullptr)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                float existing = loop[i];
+                out[i] += gain * (existing + other[i]);
+                loop[i] = existing * feedback + in[i];
+            }
+        }
+        else
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                float existing = loop[i];
+                out[i] += gain * existing;
+                loop[i] = existing * feedback + in[i];
+            }
+        }
+    }
+
+    namespace detail
+    {
+       #if MIXKERNELS_AVX
+        constexpr int overdubWidth = 8;
+       #elif MIXKERNELS_SSE || MIXKERNELS_NEON
+        constexpr int overdubWidth = 4;
+       #else
+        constexpr int overdubWidth = 1;
+       #endif
+
+        /** Vector body of overdub; numSamples is a multiple of overdubWidth.
+            AlignedLoop: loop is vector-aligned, so its load/store can be aligned. */
+        template <bool HasOther, bool AlignedLoop>
+        inline void overdubVector(float* __restrict out, float* __restrict loop, const float* __restrict in,
+                                  const float* __restrict other, float gain, float feedback, int numSamples)
+        {
+           #if MIXKERNELS_AVX
+            const __m256 g = _mm256_set1_ps(gain), fb = _mm256_set1_ps(feedback);
+            for (int i = 0; i < numSamples; i += overdubWidth)
+            {
+                __m256 existing = AlignedLoop ? _mm256_load_ps(loop + i) : _mm256_loadu_ps(loop + i);
+                __m256 mix = HasOther ? _mm256_add_ps(existing, _mm256_loadu_ps(other + i)) : existing;
+                _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(g, mix)));
+                __m256 written = _mm256_add_ps(_mm256_mul_ps(existing, fb), _mm256_loadu_ps(in + i));
+                if (AlignedLoop) _mm256_store_ps(loop + i, written); else _mm256_storeu_ps(loop + i, written);
+            }
+           #elif MIXKERNELS_SSE
+            const __m128 g = _mm_set1_ps(gain), fb = _mm_set1_ps(feedback);
+            for (int i = 0; i < numSamples; i += overdubWidth)
+            {
+                __m128 existing = AlignedLoop ? _mm_load_ps(loop + i) : _mm_loadu_ps(loop + i);
+                __m128 mix = HasOther ? _mm_add_ps(existing, _mm_loadu_ps(other + i)) : existing;
+                _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(g, mix)));
+                __m128 written = _mm_add_ps(_mm_mul_ps(existing, fb), _mm_loadu_ps(in + i));
+                if (AlignedLoop) _mm_store_ps(loop + i, written); else _mm_storeu_ps(loop + i, written);
+            }
+           #elif MIXKERNELS_NEON
+            // NEON loads and stores have no alignment requirement
+            const float32x4_t g = vdupq_n_f32(gain), fb = vdupq_n_f32(feedback);
+            for (int i = 0; i < numSamples; i += overdubWidth)
+            {
+                float32x4_t existing = vld1q_f32(loop + i);
+                float32x4_t mix = HasOther ? vaddq_f32(existing, vld1q_f32(other + i)) : existing;
+                vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(g, mix)));
+                vst1q_f32(loop + i, vaddq_f32(vmulq_f32(existing, fb), vld1q_f32(in + i)));
+            }
+           #else
+            overdubScalar(out, loop, in, HasOther ? other : nullptr, gain, feedback, numSamples);
+           #endif
+        }
+
+        /** One sample of overdub, for heads and tails (a few samples: not worth a loop
+            the compiler would vectorise again behind its own checks). */
+        template <bool HasOther>
+        inline void overdubSample(float* out, float* loop, const float* in, const float* other,
+                                  float gain, float feedback, int i)
+        {
+            float existing = loop[i];
+            out[i] += gain * (HasOther ? existing + other[i] : existing);
+            loop[i] = existing * feedback + in[i];
+        }
+
+        template <bool HasOther>
+        inline void overdub(float* __restrict out, float* __restrict loop, const float* __restrict in,
+                            const float* __restrict other, float gain, float feedback, int numSamples)
+        {
+            int i = 0;
+
+            // Scalar head until the loop is aligned, so its loads and stores never split a cache line
+            if (numSamples >= 2 * overdubWidth)
+            {
+                auto misalignment = (int)((reinterpret_cast<std::uintptr_t>(loop) / sizeof(float)) & (overdubWidth - 1));
+                int head = misalignment == 0 ? 0 : overdubWidth - misalignment;
+                for (; i < head; ++i)
+                    overdubSample<HasOther>(out, loop, in, other, gain, feedback, i);
+            }
+
+            const int body = ((numSamples - i) / overdubWidth) * overdubWidth;
+            const float* otherAt = HasOther ? other + i : nullptr;
+
+            if ((reinterpret_cast<std::uintptr_t>(loop + i) % (overdubWidth * sizeof(float))) == 0)
+                overdubVector<HasOther, true>(out + i, loop + i, in + i, otherAt, gain, feedback, body);
+            else
+                overdubVector<HasOther, false>(out + i, loop + i, in + i, otherAt, gain, feedback, body);
+
+            for (i += body; i < numSamples; ++i)
+                overdubSample<HasOther>(out, loop, in, other, gain, feedback, i);
+        }
+    }
+
+    /** overdubScalar, hand-vectorised (AVX, SSE2 or NEON, whichever the build targets).
+        Scalar head until the loop pointer (the stream read and written back) is
+        vector-aligned, unaligned out / in / other, scalar tail. */
+    inline void overdub(float* __restrict out, float* __restrict loop, const float* __restrict in,
+                        const float* __restrict other, float gain, float feedback, int numSamples)
+    {
+        if (other != nullptr)
+            detail::overdub<true>(out, loop, in, other, gain, feedback, numSamples);
+        else
+            detail::overdub<false>(out, loop, in, other, gain, feedback, numSamples);
+    }
+}
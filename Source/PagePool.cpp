@@ -0,0 +1,140 @@
+#include "PagePool.h"
+
+PagePool::PagePool()
+{
+}
+
+PagePool::~PagePool()
+{
+}
+
+void PagePool::prepare(int newMaxPages, int minReservePages)
+{
+    maxPages   = juce::jmax(1, newMaxPages);
+    minReserve = juce::jlimit(0, maxPages, minReservePages);
+
+    // Drop everything from a previous run: tracks have already forgotten their pages.
+    storage.clear();
+    storage.reserve((size_t)maxPages);
+    numAllocated.store(0);
+    reserveHint.store(0);
+
+    // AbstractFifo keeps one slot unused
+    freeFifo.setTotalSize(maxPages + 1);
+    freeFifo.reset();
+    releaseFifo.setTotalSize(maxPages + 1);
+    releaseFifo.reset();
+    otherReleaseFifo.setTotalSize(maxPages + 1);
+    otherReleaseFifo.reset();
+    freeSlots.assign((size_t)maxPages + 1, nullptr);
+    releaseSlots.assign((size_t)maxPages + 1, nullptr);
+    otherReleaseSlots.assign((size_t)maxPages + 1, nullptr);
+
+    // Allocate the initial reserve right away so the first recording never waits
+    useTimeSlice();
+}
+
+AudioPage* PagePool::allocate()
+{
+    AudioPage* page = nullptr;
+    {
+        const juce::SpinLock::ScopedLockType lock(renderSideLock);
+        page = pop(freeFifo, freeSlots);
+    }
+    if (page != nullptr)
+        page->refCount.store(1);
+    return page;
+}
+
+void PagePool::release(AudioPage* page)
+{
+    if (page == nullptr) return;
+    if (page->refCount.fetch_sub(1) > 1) return; // still shared
+
+    // The release list holds every page in the pool, so it can never be full
+    const juce::SpinLock::ScopedLockType lock(renderSideLock);
+    bool pushed = push(releaseFifo, releaseSlots, page);
+    jassert(pushed);
+    juce::ignoreUnused(pushed);
+}
+
+void PagePool::releaseFromBackground(AudioPage* page)
+{
+    if (page == nullptr) return;
+    if (page->refCount.fetch_sub(1) > 1) return;
+
+    std::memset(page->data, 0, sizeof(page->data));
+    bool pushed = push(freeFifo, freeSlots, page);
+    jassert(pushed);
+    juce::ignoreUnused(pushed);
+}
+
+void PagePool::releaseFromOtherThread(AudioPage* page)
+{
+    if (page == nullptr) return;
+    if (page->refCount.fetch_sub(1) > 1) return;
+
+    // Like the audio thread's list, it can hold every page in the pool
+    const juce::ScopedLock lock(otherReleaseLock);
+    bool pushed = push(otherReleaseFifo, otherReleaseSlots, page);
+    jassert(pushed);
+    juce::ignoreUnused(pushed);
+}
+
+void PagePool::release(AudioPage* page, Caller caller)
+{
+    switch (caller)
+    {
+        case Caller::Audio:       release(page); break;
+        case Caller::Background:  releaseFromBackground(page); break;
+        case Caller::OtherThread: releaseFromOtherThread(page); break;
+    }
+}
+
+int PagePool::useTimeSlice()
+{
+    // 1. Zero released pages and put them back on the free list
+    auto recycle = [this](juce::AbstractFifo& fifo, std::vector<AudioPage*>& slots)
+    {
+        while (auto* page = pop(fifo, slots))
+        {
+            std::memset(page->data, 0, sizeof(page->data));
+            push(freeFifo, freeSlots, page);
+        }
+    };
+    recycle(releaseFifo, releaseSlots);
+    recycle(otherReleaseFifo, otherReleaseSlots);
+
+    // 2. Grow until the free reserve covers what the audio thread may ask for next
+    int target = juce::jmax(minReserve, reserveHint.load());
+    while (freeFifo.getNumReady() < target && (int)storage.size() < maxPages)
+    {
+        storage.push_back(std::make_unique<AudioPage>()); // value-initialised = zeroed
+        push(freeFifo, freeSlots, storage.back().get());
+        numAllocated.store((int)storage.size());
+    }
+
+    // Poll faster while the audio thread is eating into the reserve
+    return freeFifo.getNumReady() < target ? 1 : 10;
+}
+
+bool PagePool::push(juce::AbstractFifo& fifo, std::vector<AudioPage*>& slots, AudioPage* page)
+{
+    if (fifo.getFreeSpace() < 1) return false;
+
+    auto scope = fifo.write(1);
+    if (scope.blockSize1 > 0)      slots[(size_t)scope.startIndex1] = page;
+    else if (scope.blockSize2 > 0) slots[(size_t)scope.startIndex2] = page;
+    return true;
+}
+
+AudioPage* PagePool::pop(juce::AbstractFifo& fifo, std::vector<AudioPage*>& slots)
+{
+    if (fifo.getNumReady() < 1) return nullptr;
+
+    AudioPage* page = nullptr;
+    auto scope = fifo.read(1);
+    if (scope.blockSize1 > 0)      page = slots[(size_t)scope.startIndex1];
+    else if (scope.blockSize2 > 0) page = slots[(size_t)scope.startIndex2];
+    return page;
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+
+/**
+    Fixed-size block of stereo sample memory.
+    Loop storage is built from these so memory follows the loops actually recorded.
+    Pages are reference counted so several PagedBuffers (loop, undo snapshots)
+    can share them; a shared page is copied before it is written (copy-on-write).
+*/
+struct AudioPage
+{
+    static constexpr int numChannels = 2;
+    static constexpr int shift       = 14;              // 16384 samples per page
+    static constexpr int numSamples  = 1 << shift;
+    static constexpr int mask        = numSamples - 1;
+
+    float data[numChannels][numSamples];
+    std::atomic<int> refCount { 0 };
+
+    bool isShared() const { return refCount.load() > 1; }
+};
+
+/**
+    Pool of pre-zeroed AudioPages shared by all tracks.
+    - allocate() / release() are realtime-safe and must only be called from the audio thread,
+      or from the render workers rendering tracks on its behalf (RenderWorkerPool): a spin
+      lock, held for one list operation, keeps their side of the free / release lists
+      single-threaded. No other thread ever takes it.
+    - Snapshots released elsewhere (message thread, session encoder, stem exporter) go
+      through releaseFromOtherThread(): their own release list, which the background
+      thread drains.
+    - Growing the pool and zeroing released pages happens in useTimeSlice(),
+      on a background thread, so the audio thread never touches the heap.
+*/
+class PagePool : public juce::TimeSliceClient
+{
+public:
+    /** The thread dropping page references, i.e. which release path it takes. */
+    enum class Caller
+    {
+        Audio,          // release(): the audio thread and the render workers
+        Background,     // releaseFromBackground(): the thread running useTimeSlice()
+        OtherThread     // releaseFromOtherThread(): any other thread
+    };
+
+    PagePool();
+    ~PagePool() override;
+
+    //==============================================================================
+    /** PREPARE: Message thread only, while no track holds pages and the pool is not serviced.
+        maxPages caps the total memory, minReservePages are allocated immediately. */
+    void prepare(int maxPages, int minReservePages);
+
+    /** AUDIO / render workers: pops a zeroed page with one reference, or returns nullptr
+        if the free reserve is exhausted. */
+    AudioPage* allocate();
+
+    /** Adds a reference to a page that is being shared. */
+    static void retain(AudioPage* page) { if (page != nullptr) page->refCount.fetch_add(1); }
+
+    /** AUDIO / render workers: drops a reference; the last one hands the page back to be
+        zeroed in the background. */
+    void release(AudioPage* page);
+
+    /** release() for the thread that runs useTimeSlice(): the last reference zeroes
+        the page and puts it straight back on the free list. */
+    void releaseFromBackground(AudioPage* page);
+
+    /** release() for any other thread: the last reference goes on a release list of
+        its own (not realtime-safe: the threads using it share a lock). */
+    void releaseFromOtherThread(AudioPage* page);
+
+    /** The release path of caller. */
+    void release(AudioPage* page, Caller caller);
+
+    /** How many free pages the audio thread may need at once (e.g. to replace the longest loop). */
+    void setReserveHint(int pages) { reserveHint.store(pages); }
+
+    int getNumAllocatedPages() const { return numAllocated.load(); }
+    int getNumFreePages() const { return freeFifo.getNumReady(); }
+    int getMaxPages() const { return maxPages; }
+
+    static int pagesForSamples(int numSamples)
+    {
+        return (numSamples + AudioPage::numSamples - 1) >> AudioPage::shift;
+    }
+
+    //==============================================================================
+    /** BACKGROUND: recycles released pages and tops the free reserve back up. */
+    int useTimeSlice() override;
+
+private:
+    static bool push(juce::AbstractFifo& fifo, std::vector<AudioPage*>& slots, AudioPage* page);
+    static AudioPage* pop(juce::AbstractFifo& fifo, std::vector<AudioPage*>& slots);
+
+    // Owned pages. Only the background thread appends once prepare() has returned.
+    std::vector<std::unique_ptr<AudioPage>> storage;
+
+    // Free list (background -> audio) and release list (audio -> background)
+    juce::AbstractFifo freeFifo { 1 };
+    juce::AbstractFifo releaseFifo { 1 };
+    std::vector<AudioPage*> freeSlots;
+    std::vector<AudioPage*> releaseSlots;
+
+    // Release list of the other threads (other threads -> background)
+    juce::AbstractFifo otherReleaseFifo { 1 };
+    std::vector<AudioPage*> otherReleaseSlots;
+    juce::CriticalSection otherReleaseLock;
+
+    // Serialises allocate() / release() between the audio thread and the render workers
+    juce::SpinLock renderSideLock;
+
+    int maxPages = 0;
+    int minReserve = 0;
+    std::atomic<int> reserveHint { 0 };
+    std::atomic<int> numAllocated { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(PagePool)
+};
@@ -0,0 +1,222 @@
+#include "PagedBuffer.h"
+
+void PagedBuffer::prepare(PagePool& newPool, int maxSamples)
+{
+    pool = &newPool;
+    pages.assign((size_t)PagePool::pagesForSamples(juce::jmax(0, maxSamples)), nullptr);
+}
+
+bool PagedBuffer::ensureAllocated(int startSample, int numSamples)
+{
+    if (numSamples <= 0) return true;
+
+    int first = startSample >> AudioPage::shift;
+    int last  = (startSample + numSamples - 1) >> AudioPage::shift;
+    if (first < 0 || last >= (int)pages.size()) return false;
+
+    for (int p = first; p <= last; ++p)
+        if (getPageForWrite(p) == nullptr)
+            return false;
+
+    return true;
+}
+
+void PagedBuffer::releaseAll(PagePool::Caller caller)
+{
+    for (auto& page : pages)
+    {
+        if (page != nullptr)
+        {
+            pool->release(page, caller);
+            page = nullptr;
+        }
+    }
+}
+
+void PagedBuffer::shareFrom(const PagedBuffer& other)
+{
+    if (&other == this) return;
+    jassert(other.pages.size() == pages.size());
+
+    for (size_t i = 0; i < pages.size(); ++i)
+    {
+        auto* incoming = i < other.pages.size() ? other.pages[i] : nullptr;
+        if (incoming == pages[i]) continue;
+
+        PagePool::retain(incoming);
+        if (pages[i] != nullptr)
+            pool->release(pages[i]);
+        pages[i] = incoming;
+    }
+}
+
+bool PagedBuffer::canAllocate(int numSamples) const
+{
+    // Only the audio thread allocates, so the free count can only grow until we use it
+    return pool != nullptr && pool->getNumFreePages() >= PagePool::pagesForSamples(numSamples);
+}
+
+int PagedBuffer::countPagesNotIn(const PagedBuffer& other) const
+{
+    int count = 0;
+    for (size_t i = 0; i < pages.size(); ++i)
+        if (pages[i] != nullptr && (i >= other.pages.size() || other.pages[i] != pages[i]))
+            ++count;
+    return count;
+}
+
+AudioPage* PagedBuffer::getPageForWrite(int pageIndex)
+{
+    auto& page = pages[(size_t)pageIndex];
+    if (pool == nullptr)
+        return page;
+
+    if (page == nullptr)
+    {
+        page = pool->allocate();
+    }
+    else if (page->isShared())
+    {
+        // Copy-on-write: detach from the snapshot before the first write
+        auto* copy = pool->allocate();
+        if (copy == nullptr)
+            return nullptr;
+
+        std::memcpy(copy->data, page->data, sizeof(page->data));
+        pool->release(page);
+        page = copy;
+    }
+    return page;
+}
+
+//==============================================================================
+// Every accessor walks page boundaries the same way the track walks the loop wrap.
+
+bool PagedBuffer::copyFrom(int channel, int destPos, const float* source, int numSamples)
+{
+    bool complete = true;
+    while (numSamples > 0)
+    {
+        int pageIndex = destPos >> AudioPage::shift;
+        int offset    = destPos & AudioPage::mask;
+        int chunk     = juce::jmin(numSamples, AudioPage::numSamples - offset);
+
+        if (pageIndex >= (int)pages.size()) return false;
+
+        if (auto* page = getPageForWrite(pageIndex))
+            juce::FloatVectorOperations::copy(page->data[channel] + offset, source, chunk);
+        else
+            complete = false;
+
+        source     += chunk;
+        destPos    += chunk;
+        numSamples -= chunk;
+    }
+    return complete;
+}
+
+bool PagedBuffer::addFrom(int channel, int destPos, const float* source, int numSamples, float gain)
+{
+    bool complete = true;
+    while (numSamples > 0)
+    {
+        int pageIndex = destPos >> AudioPage::shift;
+        int offset    = destPos & AudioPage::mask;
+        int chunk     = juce::jmin(numSamples, AudioPage::numSamples - offset);
+
+        if (pageIndex >= (int)pages.size()) return false;
+
+        if (auto* page = getPageForWrite(pageIndex))
+        {
+            if (gain == 1.0f)
+                juce::FloatVectorOperations::add(page->data[channel] + offset, source, chunk);
+            else
+                juce::FloatVectorOperations::addWithMultiply(page->data[channel] + offset, source, gain, chunk);
+        }
+        else
+        {
+            complete = false;
+        }
+
+        source     += chunk;
+        destPos    += chunk;
+        numSamples -= chunk;
+    }
+    return complete;
+}
+
+void PagedBuffer::copyTo(int channel, int sourcePos, float* dest, int numSamples) const
+{
+    while (numSamples > 0)
+    {
+        int pageIndex = sourcePos >> AudioPage::shift;
+        int offset    = sourcePos & AudioPage::mask;
+        int chunk     = juce::jmin(numSamples, AudioPage::numSamples - offset);
+
+        const AudioPage* page = pageIndex < (int)pages.size() ? pages[(size_t)pageIndex] : nullptr;
+        if (page != nullptr)
+            juce::FloatVectorOperations::copy(dest, page->data[channel] + offset, chunk);
+        else
+            juce::FloatVectorOperations::clear(dest, chunk);
+
+        dest       += chunk;
+        sourcePos  += chunk;
+        numSamples -= chunk;
+    }
+}
+
+void PagedBuffer::addTo(int channel, int sourcePos, float* dest, int numSamples, float gain) const
+{
+    while (numSamples > 0)
+    {
+        int pageIndex = sourcePos >> AudioPage::shift;
+        int offset    = sourcePos & AudioPage::mask;
+        int chunk     = juce::jmin(numSamples, AudioPage::numSamples - offset);
+
+        // Unallocated pages are silent: nothing to add
+        const AudioPage* page = pageIndex < (int)pages.size() ? pages[(size_t)pageIndex] : nullptr;
+        if (page != nullptr)
+            juce::FloatVectorOperations::addWithMultiply(dest, page->data[channel] + offset, gain, chunk);
+
+        dest       += chunk;
+        sourcePos  += chunk;
+        numSamples -= chunk;
+    }
+}
+
+float PagedBuffer::getSample(int channel, int pos) const
+{
+    int pageIndex = pos >> AudioPage::shift;
+    const AudioPage* page = pageIndex < (int)pages.size() ? pages[(size_t)pageIndex] : nullptr;
+    return page != nullptr ? page->data[channel][pos & AudioPage::mask] : 0.0f;
+}
+
+void PagedBuffer::setSample(int channel, int pos, float value)
+{
+    int pageIndex = pos >> AudioPage::shift;
+    if (pageIndex >= (int)pages.size()) return;
+
+    if (auto* page = getPageForWrite(pageIndex))
+        page->data[channel][pos & AudioPage::mask] = value;
+}
+
+AudioPage* PagedBuffer::detachPage(int pageIndex)
+{
+    auto* page = pages[(size_t)pageIndex];
+    pages[(size_t)pageIndex] = nullptr;
+    return page;
+}
+
+void PagedBuffer::attachPage(int pageIndex, AudioPage* page)
+{
+    auto& slot = pages[(size_t)pageIndex];
+    if (slot != nullptr)
+        pool->release(slot);
+    slot = page;
+}
+
+void PagedBuffer::swapWith(PagedBuffer& other) noexcept
+{
+    std::swap(pool, other.pool);
+    pages.swap(other.pages);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include "PagePool.h"
+
+/**
+    Stereo sample store made of AudioPages taken from a shared PagePool.
+    Pages are only pulled from the pool when a region is first written,
+    and unallocated regions read back as silence.
+    Buffers can share pages (shareFrom); a shared page is copied on its first
+    write, so a snapshot costs O(pages) pointer copies instead of a sample copy.
+    All methods except prepare() are realtime-safe (audio thread).
+*/
+class PagedBuffer
+{
+public:
+    PagedBuffer() = default;
+
+    /** PREPARE: Sizes the page table for maxSamples. Forgets current pages without releasing them. */
+    void prepare(PagePool& pool, int maxSamples);
+
+    int getNumChannels() const { return AudioPage::numChannels; }
+    int getCapacity() const { return (int)pages.size() << AudioPage::shift; }
+
+    /** True if the pool can supply numSamples worth of fresh pages right now. */
+    bool canAllocate(int numSamples) const;
+
+    /** Number of pages held here that other does not hold at the same index,
+        i.e. what this buffer costs on top of other. */
+    int countPagesNotIn(const PagedBuffer& other) const;
+
+    /** Makes sure every page covering [startSample, startSample + numSamples) exists
+        and is not shared, i.e. can be written without pulling from the pool.
+        Returns false if the pool could not supply them. */
+    bool ensureAllocated(int startSample, int numSamples);
+
+    /** Drops every page reference (pages go back to the pool once unshared).
+        caller: the thread calling, when it isn't the audio thread (see PagePool). */
+    void releaseAll(PagePool::Caller caller = PagePool::Caller::Audio);
+
+    /** Makes this buffer reference the same pages as other (copy-on-write snapshot). */
+    void shareFrom(const PagedBuffer& other);
+
+    //==============================================================================
+    // Writing (allocates pages on demand, returns false if samples had to be dropped)
+    bool copyFrom(int channel, int destPos, const float* source, int numSamples);
+    bool addFrom(int channel, int destPos, const float* source, int numSamples, float gain = 1.0f);
+
+    // Reading
+    void copyTo(int channel, int sourcePos, float* dest, int numSamples) const;
+    void addTo(int channel, int sourcePos, float* dest, int numSamples, float gain = 1.0f) const;
+
+    float getSample(int channel, int pos) const;
+    void setSample(int channel, int pos, float value);
+
+    void swapWith(PagedBuffer& other) noexcept;
+
+    //==============================================================================
+    // Raw page access (background flattening). No copy-on-write here.
+    int getNumPages() const { return (int)pages.size(); }
+    const AudioPage* getPage(int pageIndex) const { return pages[(size_t)pageIndex]; }
+
+    /** Only for pages this buffer holds exclusively (refCount == 1). */
+    AudioPage* getExclusivePage(int pageIndex) { return pages[(size_t)pageIndex]; }
+
+    /** Gives up a page without releasing it: the caller takes over the reference. */
+    AudioPage* detachPage(int pageIndex);
+
+    /** Stores a page, taking over the caller's reference; the previous page is released. */
+    void attachPage(int pageIndex, AudioPage* page);
+
+private:
+    AudioPage* getPageForWrite(int pageIndex);
+
+    PagePool* pool = nullptr;
+    std::vector<AudioPage*> pages;
+};
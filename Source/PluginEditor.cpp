@@ -8,7 +8,7 @@
 #include "PluginEditor.h"
 
 SimpleLooperAudioProcessorEditor::SimpleLooperAudioProcessorEditor (SimpleLooperAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
+    : AudioProcessorEditor (&p), audioProcessor (p), dspLoadPanel (p.getProfiler())
 {
     setLookAndFeel(&customLnf);
 
@@ -17,10 +17,14 @@ SimpleLooperAudioProcessorEditor::SimpleLooperAudioProcessorEditor (SimpleLooper
     for (auto& trackPtr : tracks)
     {
         auto comp = std::make_unique<TrackComponent>(audioProcessor, *trackPtr, trackIndex++);
-        addAndMakeVisible(*comp);
+        trackList.addAndMakeVisible(*comp);
         trackComponents.push_back(std::move(comp));
     }
 
+    addAndMakeVisible(trackViewport);
+    trackViewport.setViewedComponent(&trackList, false);
+    trackViewport.setScrollBarsShown(true, false);
+
     auto setupGlobalBtn = [&](juce::TextButton& btn, juce::Colour col) {
         addAndMakeVisible(btn);
         btn.setClickingTogglesState(true);
@@ -37,6 +41,11 @@ SimpleLooperAudioProcessorEditor::SimpleLooperAudioProcessorEditor (SimpleLooper
     mBounceAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(
         audioProcessor.apvts, "bounce_back", bounceButton);
 
+    // Not a parameter: it opens a menu
+    setupGlobalBtn(stemsButton, Colours_::stop.darker(0.3f));
+    stemsButton.setClickingTogglesState(false);
+    stemsButton.onClick = [this] { showStemsMenu(); };
+
     addAndMakeVisible(bpmLabel);
     bpmLabel.setText("BPM: --", juce::dontSendNotification);
     bpmLabel.setColour(juce::Label::textColourId, Colours_::textPrimary);
@@ -59,7 +68,10 @@ SimpleLooperAudioProcessorEditor::SimpleLooperAudioProcessorEditor (SimpleLooper
     mMidiSyncChannelAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ComboBoxAttachment>(
         audioProcessor.apvts, "midi_sync_channel", midiSyncChannelSelector);
 
-    setSize(720, 680);
+    addAndMakeVisible(dspLoadPanel);
+    dspLoadPanel.onExpandedChange = [this] { resized(); };
+
+    setSize(800, 680);
     startTimerHz(30);
 }
 
@@ -74,10 +86,35 @@ void SimpleLooperAudioProcessorEditor::timerCallback()
     bool isFirst = audioProcessor.isFirstLoop();
     double bpm = audioProcessor.getBpm();
 
-    stateLabel.setText(isFirst ? "WAITING FOR FIRST LOOP" : "LOOPING",
-                       juce::dontSendNotification);
-    stateLabel.setColour(juce::Label::textColourId,
-                          isFirst ? Colours_::dub : Colours_::play);
+    if (audioProcessor.getMidiLearn().isLearning())
+    {
+        stateLabel.setText("MIDI LEARN: PRESS A NOTE / PEDAL", juce::dontSendNotification);
+        stateLabel.setColour(juce::Label::textColourId, Colours_::afterloop);
+    }
+    else
+    {
+        // Last bounce: from the press to the result playing
+        juce::String state = isFirst ? "WAITING FOR FIRST LOOP" : "LOOPING";
+        double bounceMs = audioProcessor.getLastBounceLatencyMs();
+        if (!isFirst && bounceMs >= 0.0)
+            state += "   BOUNCE " + juce::String(juce::roundToInt(bounceMs)) + " ms";
+
+        switch (audioProcessor.getStemExportState())
+        {
+            case SimpleLooperAudioProcessor::ExportState::Running:
+                state += "   STEMS " + juce::String(juce::roundToInt(audioProcessor.getStemExportProgress() * 100.0f)) + "%";
+                break;
+            case SimpleLooperAudioProcessor::ExportState::Done:   state += "   STEMS SAVED";  break;
+            case SimpleLooperAudioProcessor::ExportState::Failed: state += "   STEMS FAILED"; break;
+            case SimpleLooperAudioProcessor::ExportState::Idle:   break;
+        }
+
+        stateLabel.setText(state, juce::dontSendNotification);
+        stateLabel.setColour(juce::Label::textColourId,
+                              isFirst ? Colours_::dub : Colours_::play);
+    }
+
+    stemsButton.setEnabled(audioProcessor.getStemExportState() != SimpleLooperAudioProcessor::ExportState::Running);
 
     if (bpm > 0)
         bpmLabel.setText(juce::String(bpm, 1) + " BPM", juce::dontSendNotification);
@@ -87,6 +124,94 @@ void SimpleLooperAudioProcessorEditor::timerCallback()
     repaint();
 }
 
+void SimpleLooperAudioProcessorEditor::mouseDown(const juce::MouseEvent& e)
+{
+    // Right-click on the header: MIDI learn for the global commands
+    // (each track panel has its own menu)
+    if (e.mods.isPopupMenu())
+        showMidiLearnMenu();
+}
+
+void SimpleLooperAudioProcessorEditor::showMidiLearnMenu()
+{
+    using Cmd = LooperCommand::Type;
+    static const Cmd commands[] = { Cmd::Bounce, Cmd::Reset };
+    constexpr int forgetBase = 100, cancelId = 200;
+
+    auto& learn = audioProcessor.getMidiLearn();
+    juce::PopupMenu menu;
+    menu.addSectionHeader("MIDI Learn");
+
+    for (int i = 0; i < 2; ++i)
+    {
+        auto binding = learn.describeBinding(commands[i], 0);
+        juce::String name = getCommandName(commands[i]);
+        menu.addItem(1 + i, binding.isEmpty() ? name : name + "  [" + binding + "]",
+                     true, learn.isLearning(commands[i], 0));
+        if (binding.isNotEmpty())
+            menu.addItem(forgetBase + i, "Forget " + name);
+    }
+
+    if (learn.isLearning())
+    {
+        menu.addSeparator();
+        menu.addItem(cancelId, "Cancel learning");
+    }
+
+    menu.showMenuAsync(juce::PopupMenu::Options(),
+        [this](int result)
+        {
+            auto& learn = audioProcessor.getMidiLearn();
+            if (result == cancelId)
+                learn.cancelLearning();
+            else if (result >= forgetBase && result < forgetBase + 2)
+                learn.forget(commands[result - forgetBase], 0);
+            else if (result >= 1 && result <= 2)
+                learn.startLearning(commands[result - 1], 0);
+        });
+}
+
+void SimpleLooperAudioProcessorEditor::showStemsMenu()
+{
+    enum { exportWav = 1, exportFlac, includeMix, chooseFolder };
+
+    const bool hasLoops = !audioProcessor.isFirstLoop();
+    juce::PopupMenu menu;
+    menu.addSectionHeader("Export stems");
+    menu.addItem(exportWav,  "Export WAV (32-bit float)", hasLoops);
+    menu.addItem(exportFlac, "Export FLAC (24-bit)", hasLoops);
+    menu.addSeparator();
+    menu.addItem(includeMix, "Include the mix", true, stemsIncludeMix);
+    menu.addItem(chooseFolder, "Folder: " + stemsFolder.getFullPathName() + "...");
+
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&stemsButton),
+        [this](int result)
+        {
+            if (result == includeMix)
+            {
+                stemsIncludeMix = !stemsIncludeMix;
+            }
+            else if (result == chooseFolder)
+            {
+                stemsChooser = std::make_unique<juce::FileChooser>("Export stems to", stemsFolder);
+                stemsChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectDirectories,
+                    [this](const juce::FileChooser& chooser)
+                    {
+                        if (chooser.getResult() != juce::File())
+                            stemsFolder = chooser.getResult();
+                    });
+            }
+            else if (result == exportWav || result == exportFlac)
+            {
+                StemExport::Options options;
+                options.folder = stemsFolder.getChildFile("Stems " + juce::Time::getCurrentTime().formatted("%Y-%m-%d %H-%M-%S"));
+                options.format = result == exportFlac ? StemExport::Format::Flac : StemExport::Format::Wav;
+                options.includeMix = stemsIncludeMix;
+                audioProcessor.exportStems(options);
+            }
+        });
+}
+
 void SimpleLooperAudioProcessorEditor::paint (juce::Graphics& g)
 {
     g.fillAll(Colours_::bg);
@@ -104,10 +229,12 @@ void SimpleLooperAudioProcessorEditor::resized()
 
     // Header bar
     auto header = area.removeFromTop(48);
-    auto headerRight = header.removeFromRight(360).reduced(8);
+    auto headerRight = header.removeFromRight(440).reduced(8);
     resetButton.setBounds(headerRight.removeFromRight(70));
     headerRight.removeFromRight(4);
     bounceButton.setBounds(headerRight.removeFromRight(70));
+    headerRight.removeFromRight(4);
+    stemsButton.setBounds(headerRight.removeFromRight(70));
     headerRight.removeFromRight(10);
     midiSyncChannelSelector.setBounds(headerRight.removeFromRight(76));
     headerRight.removeFromRight(6);
@@ -120,10 +247,19 @@ void SimpleLooperAudioProcessorEditor::resized()
 
     area.removeFromTop(4);
 
+    dspLoadPanel.setBounds(area.removeFromBottom(dspLoadPanel.getPreferredHeight()));
+
+    trackViewport.setBounds(area.withTrimmedBottom(8));
     if (trackComponents.empty()) return;
 
-    int trackH = (area.getHeight() - 8) / static_cast<int>(trackComponents.size());
-    auto tracksArea = area.reduced(8, 0);
+    // Share the height while every track gets at least minTrackHeight, then scroll
+    const int numTracks = static_cast<int>(trackComponents.size());
+    int trackH = juce::jmax(minTrackHeight, trackViewport.getHeight() / numTracks);
+    bool scrolls = trackH * numTracks > trackViewport.getHeight();
+
+    int listWidth = trackViewport.getWidth() - (scrolls ? trackViewport.getScrollBarThickness() : 0);
+    trackList.setSize(listWidth, trackH * numTracks);
+    auto tracksArea = trackList.getLocalBounds().reduced(8, 0);
 
     for (auto& comp : trackComponents)
     {
@@ -4,6 +4,7 @@
 #include "PluginProcessor.h"
 #include "TrackComponent.h"
 #include "CustomLookAndFeel.h"
+#include "DspLoadPanel.h"
 
 class SimpleLooperAudioProcessorEditor  : public juce::AudioProcessorEditor,
                                             public juce::Timer
@@ -15,16 +16,30 @@ public:
     void paint (juce::Graphics&) override;
     void resized() override;
     void timerCallback() override;
+    void mouseDown(const juce::MouseEvent& e) override;
 
 private:
     SimpleLooperAudioProcessor& audioProcessor;
     CustomLookAndFeel customLnf;
 
+    // Track panels, stacked in a scrollable list once they no longer fit
+    static constexpr int minTrackHeight = 100;
+    juce::Viewport trackViewport;
+    juce::Component trackList;
     std::vector<std::unique_ptr<TrackComponent>> trackComponents;
 
+    void showMidiLearnMenu();
+
     juce::TextButton resetButton  { "RESET" };
     juce::TextButton bounceButton { "BOUNCE" };
 
+    // Stem export: each export goes to a new timestamped folder inside stemsFolder
+    juce::TextButton stemsButton  { "STEMS" };
+    juce::File stemsFolder { juce::File::getSpecialLocation(juce::File::userMusicDirectory).getChildFile("SimpleLooper Stems") };
+    bool stemsIncludeMix = true;
+    std::unique_ptr<juce::FileChooser> stemsChooser;
+    void showStemsMenu();
+
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mResetAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment> mBounceAttachment;
 
@@ -35,5 +50,7 @@ private:
 
     std::unique_ptr<juce::AudioProcessorValueTreeState::ComboBoxAttachment> mMidiSyncChannelAttachment;
 
+    DspLoadPanel dspLoadPanel;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SimpleLooperAudioProcessorEditor)
 };
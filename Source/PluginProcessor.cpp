@@ -8,72 +8,131 @@
 
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
+#include "MixKernels.h"
 
 //==============================================================================
-SimpleLooperAudioProcessor::SimpleLooperAudioProcessor()
+static int validTrackCount(int numTracks)
+{
+    return juce::jlimit(1, SimpleLooperAudioProcessor::MAX_TRACKS, numTracks);
+}
+
+#ifndef JucePlugin_PreferredChannelConfigurations
+juce::AudioProcessor::BusesProperties SimpleLooperAudioProcessor::createBusesProperties(int numTracks)
+{
+    BusesProperties buses;
+   #if ! JucePlugin_IsMidiEffect
+    #if ! JucePlugin_IsSynth
+    buses = buses.withInput("Input", juce::AudioChannelSet::stereo(), true);
+    for (int i = 0; i < numTracks; ++i)
+        buses = buses.withInput("FX Return " + juce::String(i + 1), juce::AudioChannelSet::stereo(), false);
+    #endif
+
+    auto outputNames = getOutputNames(numTracks);
+    for (int i = 0; i < outputNames.size(); ++i)
+        buses = buses.withOutput(outputNames[i], juce::AudioChannelSet::stereo(), i == 0);
+   #endif
+    return buses;
+}
+#endif
+
+juce::StringArray SimpleLooperAudioProcessor::getOutputNames(int numTracks)
+{
+    // Monitor + one stereo pair per track
+    juce::StringArray names { "Monitor 1/2" };
+    for (int i = 1; i <= numTracks; ++i)
+        names.add("Output " + juce::String(2 * i + 1) + "/" + juce::String(2 * i + 2));
+    return names;
+}
+
+SimpleLooperAudioProcessor::SimpleLooperAudioProcessor(int numTracks)
 #ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor (BusesProperties()
-                     #if ! JucePlugin_IsMidiEffect
-                      #if ! JucePlugin_IsSynth
-                       .withInput  ("Input",        juce::AudioChannelSet::stereo(), true)
-                       .withInput  ("FX Return 1",  juce::AudioChannelSet::stereo(), false)
-                       .withInput  ("FX Return 2",  juce::AudioChannelSet::stereo(), false)
-                       .withInput  ("FX Return 3",  juce::AudioChannelSet::stereo(), false)
-                       .withInput  ("FX Return 4",  juce::AudioChannelSet::stereo(), false)
-                       .withInput  ("FX Return 5",  juce::AudioChannelSet::stereo(), false)
-                       .withInput  ("FX Return 6",  juce::AudioChannelSet::stereo(), false)
-                      #endif
-                       .withOutput ("Monitor 1/2",   juce::AudioChannelSet::stereo(), true)
-                       .withOutput ("Output 3/4",    juce::AudioChannelSet::stereo(), false)
-                       .withOutput ("Output 5/6",    juce::AudioChannelSet::stereo(), false)
-                       .withOutput ("Output 7/8",    juce::AudioChannelSet::stereo(), false)
-                       .withOutput ("Output 9/10",   juce::AudioChannelSet::stereo(), false)
-                       .withOutput ("Output 11/12",  juce::AudioChannelSet::stereo(), false)
-                       .withOutput ("Output 13/14",  juce::AudioChannelSet::stereo(), false)
-                     #endif
-                       ),
-       apvts(*this, nullptr, "PARAMETERS", createParameterLayout())
+     : AudioProcessor (createBusesProperties(validTrackCount(numTracks))),
+       apvts(*this, nullptr, "PARAMETERS", createParameterLayout(validTrackCount(numTracks))),
 #else
-     : apvts(*this, nullptr, "PARAMETERS", createParameterLayout())
+     : apvts(*this, nullptr, "PARAMETERS", createParameterLayout(validTrackCount(numTracks))),
 #endif
+       mNumTracks(validTrackCount(numTracks))
 {
     // Initialiser le logger EN PREMIER
     DebugLogger::getInstance().initialize();
-    
-    LOG_SEP("PLUGIN CONSTRUCTOR");
+    TRACE(PluginCreated, -1, mNumTracks);
     
     // Initialize tracks immediately so they exist for the Editor
-    int numTracks = NUM_TRACKS;
-    for (int i = 0; i < numTracks; ++i)
+    for (int i = 0; i < mNumTracks; ++i)
     {
         mTracks.push_back(std::make_unique<LoopTrack>());
-        LOG("Track " + juce::String(i) + " created");
+        mTracks.back()->setIndex(i);
     }
 
+    // Everything sized by the track count is allocated here, never on the audio thread
+    mFxReturnCache.resize((size_t)mNumTracks);
+    mControls.resize(mNumTracks);
+    mMixPlan.resize(mNumTracks);
+    mJob.sources = std::vector<LoopJob::Source>((size_t)mNumTracks);
+    mSessionSources = std::vector<LoopJob::Source>((size_t)mNumTracks);
+    mSaveInfos.resize((size_t)mNumTracks);
+    mEncoderSources = std::vector<LoopJob::Source>((size_t)mNumTracks);
+    mExportSources = std::vector<LoopJob::Source>((size_t)mNumTracks);
+    mSessionInstalls = std::vector<SessionInstall>((size_t)mNumTracks);
+    mSessionCache.resize(mNumTracks);
+
     // Cache APVTS parameter pointers for real-time access in processBlock
-    for (int i = 0; i < NUM_TRACKS; ++i)
+    for (int i = 0; i < mNumTracks; ++i)
     {
         auto idx = juce::String(i);
-        mParamVol[i]       = apvts.getRawParameterValue("vol_" + idx);
-        mParamRecPlay[i]   = apvts.getRawParameterValue("rec_" + idx);
-        mParamStop[i]      = apvts.getRawParameterValue("stop_" + idx);
-        mParamMute[i]      = apvts.getRawParameterValue("mute_" + idx);
-        mParamSolo[i]      = apvts.getRawParameterValue("solo_" + idx);
-        mParamAfterLoop[i] = apvts.getRawParameterValue("afterloop_" + idx);
-        mParamClear[i]     = apvts.getRawParameterValue("clear_" + idx);
-        mParamUndo[i]      = apvts.getRawParameterValue("undo_" + idx);
-        mParamMul[i]       = apvts.getRawParameterValue("mul_" + idx);
-        mParamDiv[i]       = apvts.getRawParameterValue("div_" + idx);
-        mParamOutSelect[i] = apvts.getRawParameterValue("out_select_" + idx);
-        mParamResample[i]  = apvts.getRawParameterValue("resample_" + idx);
-    }
-    mParamBounce          = apvts.getRawParameterValue("bounce_back");
-    mParamReset           = apvts.getRawParameterValue("reset_all");
+        mControls.volumeParam[(size_t)i]    = apvts.getRawParameterValue("vol_" + idx);
+        mControls.muteParam[(size_t)i]      = apvts.getRawParameterValue("mute_" + idx);
+        mControls.soloParam[(size_t)i]      = apvts.getRawParameterValue("solo_" + idx);
+        mControls.undoDepthParam[(size_t)i] = apvts.getRawParameterValue("undo_depth_" + idx);
+        mControls.outSelectParam[(size_t)i] = apvts.getRawParameterValue("out_select_" + idx);
+    }
     mParamMidiSyncChannel = apvts.getRawParameterValue("midi_sync_channel");
+    mParamUndoMemory      = apvts.getRawParameterValue("undo_memory_mb");
+    mParamOverdubLayers   = apvts.getRawParameterValue("overdub_layers");
+    mParamRenderThreads   = apvts.getRawParameterValue("render_threads");
+
+    // Trigger parameters become timestamped commands
+    using Cmd = LooperCommand::Type;
+    for (int i = 0; i < mNumTracks; ++i)
+    {
+        auto idx = juce::String(i);
+        addCommandTrigger("rec_" + idx,       Cmd::RecPlay,   i);
+        addCommandTrigger("stop_" + idx,      Cmd::Stop,      i);
+        addCommandTrigger("afterloop_" + idx, Cmd::AfterLoop, i);
+        addCommandTrigger("clear_" + idx,     Cmd::Clear,     i);
+        addCommandTrigger("undo_" + idx,      Cmd::Undo,      i);
+        addCommandTrigger("redo_" + idx,      Cmd::Redo,      i);
+        addCommandTrigger("mul_" + idx,       Cmd::Multiply,  i);
+        addCommandTrigger("div_" + idx,       Cmd::Divide,    i);
+        addCommandTrigger("resample_" + idx,  Cmd::FxReplace, i);
+    }
+    addCommandTrigger("bounce_back", Cmd::Bounce, 0);
+    addCommandTrigger("reset_all",   Cmd::Reset,  0);
+
+    // Output routing changes rebuild the mix plan
+    for (int i = 0; i < mNumTracks; ++i)
+        apvts.addParameterListener("out_select_" + juce::String(i), &mRoutingListener);
 }
 
 SimpleLooperAudioProcessor::~SimpleLooperAudioProcessor()
 {
+    mStemExporter.stopThread(4000);
+    mSessionLoader.stopThread(2000);
+    mSessionEncoder.stopThread(2000);
+    mRenderWorkers.stop();
+    mJobWorker.signalThreadShouldExit();
+    mJobWorker.wake();
+    mJobWorker.stopThread(2000);
+    for (auto& trigger : mCommandTriggers)
+        apvts.removeParameterListener(trigger->paramID, trigger.get());
+    for (int i = 0; i < mNumTracks; ++i)
+        apvts.removeParameterListener("out_select_" + juce::String(i), &mRoutingListener);
+
+    mBackgroundThread.removeTimeSliceClient(&mTrackMaintenance);
+    mBackgroundThread.removeTimeSliceClient(&mPagePool);
+    mBackgroundThread.stopThread(2000);
+
+    DebugLogger::getInstance().shutdown();
 }
 
 //==============================================================================
@@ -141,45 +200,114 @@ void SimpleLooperAudioProcessor::changeProgramName (int index, const juce::Strin
 //==============================================================================
 void SimpleLooperAudioProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    LOG_SEP("PREPARE TO PLAY");
-    LOG_VALUE("Sample Rate", sampleRate);
-    LOG_VALUE("Samples Per Block", samplesPerBlock);
+    TRACE(PrepareToPlay, -1, sampleRate, samplesPerBlock);
     
     // --- INITIALIZATION ---
 
-    // 1. Prepare auxiliary input buffer
-    // We need at least the number of input channels and the block size
+    // 1. Sub-block size: every scratch buffer below is sized for it, once. processBlock
+    // splits larger host blocks, so nothing is reallocated on the audio thread.
+    mSubBlockSize = juce::jlimit(1, MAX_SUB_BLOCK_SAMPLES, samplesPerBlock);
+
+    // Prepare auxiliary input buffer
+    // We need at least the number of input channels and the sub-block size
     int numInputChannels = getTotalNumInputChannels();
     // Safety check for 0 channels (rare but possible)
     if (numInputChannels == 0) numInputChannels = 2; 
 
-    mInputCache.setSize(numInputChannels, samplesPerBlock);
-    for (int i = 0; i < NUM_TRACKS; ++i)
+    mInputCache.setSize(numInputChannels, mSubBlockSize);
+    for (auto& fxCache : mFxReturnCache)
     {
-        mFxReturnCache[i].setSize(2, samplesPerBlock);
-        mFxReturnCache[i].clear();
+        fxCache.setSize(2, mSubBlockSize);
+        fxCache.clear();
     }
 
-    // 2. Setup Loop Tracks
+    // 2. Setup the page pool. The cap matches the old worst case
+    // (loop + undo + FX capture for 5 minutes per track), but pages are only
+    // allocated as loops grow. Deeper undo history is bounded by undo_memory_mb.
+    // Stop servicing the pool (and the tracks' background work) while it is rebuilt.
+    mBackgroundThread.removeTimeSliceClient(&mTrackMaintenance);
+    mBackgroundThread.removeTimeSliceClient(&mPagePool);
+    mJobWorker.signalThreadShouldExit();
+    mJobWorker.wake();
+    mJobWorker.stopThread(2000);
+    mRenderWorkers.stop();
+    mSessionEncoder.stopThread(2000);
+    mStemExporter.stopThread(4000); // an export in progress fails (its pages are rebuilt)
+    for (auto* sources : { &mEncoderSources, &mExportSources })
+        for (auto& source : *sources)
+            releaseSource(source, PagePool::Caller::OtherThread); // a snapshot taken just before the thread stopped
+    int pagesPerBuffer = PagePool::pagesForSamples(static_cast<int>(sampleRate * 300.0));
+    mPagePool.prepare(mNumTracks * 3 * pagesPerBuffer,
+                      PagePool::pagesForSamples(static_cast<int>(sampleRate * PAGE_RESERVE_SECONDS)));
+
+    // 3. Setup Loop Tracks
     // Tracks are already created in constructor. Just prepare them.
     for (int i = 0; i < mTracks.size(); ++i)
     {
-        LOG_TRACK(i, "PREPARE", "");
-        mTracks[i]->prepareToPlay(sampleRate, samplesPerBlock);
+        TRACE(TrackPrepared, i);
+        mTracks[i]->prepareToPlay(sampleRate, mSubBlockSize, mPagePool);
     }
 
-    // 3. Setup Retrospective Buffer (After Loop) - 5 minutes circular buffer
+    mBackgroundThread.addTimeSliceClient(&mPagePool);
+    mBackgroundThread.addTimeSliceClient(&mTrackMaintenance);
+    if (!mBackgroundThread.isThreadRunning())
+        mBackgroundThread.startThread(juce::Thread::Priority::background);
+
+    // 4. Setup Retrospective Buffer (After Loop) - 5 minutes circular buffer
     int retroSize = static_cast<int>(sampleRate * 300.0);
     mRetrospectiveBuffer.setSize(2, retroSize);
     mRetrospectiveBuffer.clear();
     mRetroWritePos = 0;
     mRetroBufferSize = retroSize;
 
-    // 4. Pre-allocate work buffer for bounce/afterloop operations
-    mWorkBuffer.setSize(2, retroSize);
-    mWorkBuffer.clear();
+    // 5. Bounce / After Loop: staging buffers (grown by the worker as needed)
+    // and per-track snapshot tables
+    mStagingBuffers.prepare(2);
+
+    for (auto& source : mJob.sources)
+    {
+        source.image.prepare(mPagePool, retroSize);
+        source.replaceSource = nullptr;
+        source.used = false;
+    }
+    mJob.output = nullptr;
+    mJob.status.store(LoopJob::Idle);
+    mJobWorker.startThread(juce::Thread::Priority::low);
+
+    // 6. Render workers: one per spare core (render_threads picks how many take part).
+    // Waiting longer than a quarter of a sub-block for them is a missed deadline.
+    if (mNumTracks > 1)
+        mRenderWorkers.start(juce::jmin(RenderWorkerPool::maxWorkers, juce::SystemStats::getNumCpus() - 1,
+                                        mNumTracks - 1),
+                             sampleRate, mSubBlockSize);
+    mRenderDeadlineMs = 0.25 * 1000.0 * mSubBlockSize / sampleRate;
+
+    // 7. Load profiler: per-track series, counter calibration
+    mProfiler.prepare(mNumTracks, sampleRate);
+
+    // 8. Buses may have been enabled / disabled: route again. Push every control.
+    mMixPlanDirty.store(true);
+    mControlsSynced = false;
+
+    // 9. Session state and stem export: snapshot tables, then the background encoder.
+    // Loops of a session restored earlier are installed by the first blocks.
+    {
+        const juce::ScopedLock sessionLock(mSessionLock);
+        for (auto* sources : { &mSessionSources, &mEncoderSources, &mExportSources })
+        {
+            for (auto& source : *sources)
+            {
+                source.image.prepare(mPagePool, retroSize);
+                source.replaceSource = nullptr;
+                source.used = false;
+            }
+        }
+    }
+    mEncoderSnapshot.store(SnapshotIdle);
+    mSaveSnapshot.store(SnapshotIdle);
+    mSessionEncoder.startThread(juce::Thread::Priority::background);
     
-    LOG("Preparation complete");
+    TRACE(PrepareComplete, -1);
 }
 
 void SimpleLooperAudioProcessor::releaseResources()
@@ -229,60 +357,91 @@ bool SimpleLooperAudioProcessor::isBusesLayoutSupported (const BusesLayout& layo
 void SimpleLooperAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
     juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
+    const auto profileStart = mProfiler.beginBlock() ? DspProfiler::now() : 0;
+
+    const int numSamples = buffer.getNumSamples();
+    const juce::int64 blockStart = mSampleClock.load();
+    mAudioThreadId.store(juce::Thread::getCurrentThreadId());
+    mBlockStartSample.store(blockStart);
+    mBlockStartMs.store(juce::Time::getMillisecondCounterHiRes());
+    mLastBlockSize.store(numSamples);
+
+    // Commands (UI, host automation, MIDI) for the whole host block. Each one is applied
+    // at its own sample, in whichever sub-block that falls.
+    {
+        DspProfiler::Scope scope(mProfiler, DspProfiler::Commands);
+        collectCommands();
+        mMidiLearn.process(midiMessages, [this, blockStart](LooperCommand::Type type, int track, int samplePosition)
+        {
+            scheduleCommand({ type, track, blockStart + samplePosition });
+        });
+    }
 
-    // --- SNAPSHOT ALL INPUTS before touching the buffer ---
+    // Host blocks larger than the sub-block size (more than announced in prepareToPlay,
+    // or above MAX_SUB_BLOCK_SAMPLES) are processed in pieces: no scratch buffer is ever
+    // resized here, and parameters are read at least once per sub-block.
+    for (int offset = 0; offset < numSamples; offset += mSubBlockSize)
+        processSubBlock(buffer, midiMessages, offset, juce::jmin(mSubBlockSize, numSamples - offset));
 
-    // Ensure our input cache is big enough (in case block size changes or wasn't set right)
-    if (mInputCache.getNumSamples() < buffer.getNumSamples())
-        mInputCache.setSize(juce::jmax(1, totalNumInputChannels), buffer.getNumSamples());
+    mProfiler.addStage(DspProfiler::Total, DspProfiler::now() - profileStart);
+    mProfiler.endBlock(numSamples);
+}
 
-    // Snapshot main input (Bus 0)
-    auto mainInputBuf = getBusBuffer(buffer, true, 0);
-    for (int ch = 0; ch < mainInputBuf.getNumChannels(); ++ch)
-        mInputCache.copyFrom(ch, 0, mainInputBuf, ch, 0, buffer.getNumSamples());
+void SimpleLooperAudioProcessor::processSubBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages,
+                                                 int offset, int numSamples)
+{
+    jassert(numSamples <= mInputCache.getNumSamples());
 
-    // Snapshot per-track FX Return inputs (Buses 1-8) if enabled
-    for (int t = 0; t < NUM_TRACKS; ++t)
     {
-        if (mFxReturnCache[t].getNumSamples() < buffer.getNumSamples())
-            mFxReturnCache[t].setSize(2, buffer.getNumSamples());
-        mFxReturnCache[t].clear(0, buffer.getNumSamples());
+        DspProfiler::Scope scope(mProfiler, DspProfiler::InputSnapshot);
+
+        // --- SNAPSHOT ALL INPUTS before touching the buffer ---
+        // (the caches hold this sub-block from their sample 0)
 
-        int fxBusIdx = t + 1; // Bus 0 = main input, Buses 1-4 = FX Returns
-        if (fxBusIdx < getBusCount(true) && getBus(true, fxBusIdx)->isEnabled())
+        // Snapshot main input (Bus 0)
+        auto mainInputBuf = getBusBuffer(buffer, true, 0);
+        for (int ch = 0; ch < juce::jmin(mainInputBuf.getNumChannels(), mInputCache.getNumChannels()); ++ch)
+            mInputCache.copyFrom(ch, 0, mainInputBuf, ch, offset, numSamples);
+
+        // Snapshot per-track FX Return inputs (Buses 1..numTracks) if enabled
+        for (int t = 0; t < mNumTracks; ++t)
         {
-            auto fxBuf = getBusBuffer(buffer, true, fxBusIdx);
-            for (int ch = 0; ch < juce::jmin(2, fxBuf.getNumChannels()); ++ch)
-                mFxReturnCache[t].copyFrom(ch, 0, fxBuf, ch, 0, buffer.getNumSamples());
+            mFxReturnCache[t].clear(0, numSamples);
+
+            int fxBusIdx = t + 1; // Bus 0 = main input, then one FX Return per track
+            if (fxBusIdx < getBusCount(true) && getBus(true, fxBusIdx)->isEnabled())
+            {
+                auto fxBuf = getBusBuffer(buffer, true, fxBusIdx);
+                for (int ch = 0; ch < juce::jmin(2, fxBuf.getNumChannels()); ++ch)
+                    mFxReturnCache[t].copyFrom(ch, 0, fxBuf, ch, offset, numSamples);
+            }
         }
-    }
 
-    // --- CLEAR ALL output buses to prevent FX Return bleed ---
-    // Input and output buses share channels in the buffer (e.g. FX Return 1 and
-    // Output 3/4 both map to channels 2-3). Without clearing, FX Return audio
-    // passes straight through to the output, causing feedback.
-    for (int bus = 0; bus < getBusCount(false); ++bus)
-    {
-        if (getBus(false, bus)->isEnabled())
+        // --- CLEAR ALL output buses to prevent FX Return bleed ---
+        // Input and output buses share channels in the buffer (e.g. FX Return 1 and
+        // Output 3/4 both map to channels 2-3). Without clearing, FX Return audio
+        // passes straight through to the output, causing feedback.
+        for (int bus = 0; bus < getBusCount(false); ++bus)
         {
-            auto outBuf = getBusBuffer(buffer, false, bus);
-            outBuf.clear(0, buffer.getNumSamples());
+            if (getBus(false, bus)->isEnabled())
+            {
+                auto outBuf = getBusBuffer(buffer, false, bus);
+                outBuf.clear(offset, numSamples);
+            }
         }
-    }
 
-    // Re-add main input to Main Output for input monitoring
-    {
-        auto mainOutBuf = getBusBuffer(buffer, false, 0);
-        for (int ch = 0; ch < juce::jmin(mInputCache.getNumChannels(), mainOutBuf.getNumChannels()); ++ch)
-            mainOutBuf.copyFrom(ch, 0, mInputCache, ch, 0, buffer.getNumSamples());
+        // Re-add main input to Main Output for input monitoring
+        {
+            auto mainOutBuf = getBusBuffer(buffer, false, 0);
+            for (int ch = 0; ch < juce::jmin(mInputCache.getNumChannels(), mainOutBuf.getNumChannels()); ++ch)
+                mainOutBuf.copyFrom(ch, offset, mInputCache, ch, 0, numSamples);
+        }
     }
 
     // 2. Record input into retrospective buffer (circular) for After Loop feature
     if (mRetroBufferSize > 0)
     {
-        int numSamples = buffer.getNumSamples();
+        DspProfiler::Scope scope(mProfiler, DspProfiler::RetroWrite);
         int retroCh = juce::jmin(mInputCache.getNumChannels(), mRetrospectiveBuffer.getNumChannels());
         for (int ch = 0; ch < retroCh; ++ch)
         {
@@ -300,10 +459,106 @@ void SimpleLooperAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer,
         mRetroWritePos = (mRetroWritePos + numSamples) % mRetroBufferSize;
     }
 
-    // 3. Handle DAW parameter triggers (MIDI mapped via Ableton Configure, etc.)
-    handleParameterChanges();
+    // A track whose render ran late is still being rendered on a worker: nothing
+    // touches the tracks (parameters, commands, jobs) until it has finished
+    const bool tracksFree = mRenderWorkers.isIdle();
+
+    // 3. Sync continuous parameters (volume, mute, solo, undo settings)
+    if (tracksFree)
+    {
+        DspProfiler::Scope scope(mProfiler, DspProfiler::Parameters);
+        handleParameterChanges();
+    }
+
+    // 4. The sub-block is split at each command's sample, so a punch in/out lands
+    // exactly where it was stamped or where the MIDI event sits.
+    const juce::int64 blockStart = mSampleClock.load();
+
+    int segmentStart = 0;
+    while (segmentStart < numSamples)
+    {
+        // Apply everything due up to here (late commands apply at the block start)
+        if (mNumScheduled > 0 && tracksFree)
+        {
+            DspProfiler::Scope scope(mProfiler, DspProfiler::Commands);
+            while (mNumScheduled > 0 && mScheduled[0].sampleTime <= blockStart + segmentStart)
+            {
+                applyCommand(mScheduled[0]);
+                std::move(mScheduled.begin() + 1, mScheduled.begin() + mNumScheduled, mScheduled.begin());
+                --mNumScheduled;
+            }
+        }
+
+        int segmentEnd = numSamples;
+        if (mNumScheduled > 0 && mScheduled[0].sampleTime < blockStart + numSamples)
+            segmentEnd = (int)(mScheduled[0].sampleTime - blockStart);
+
+        DebugLogger::getInstance().setSampleTime(blockStart + segmentStart);
+        processSegment(buffer, offset, segmentStart, segmentEnd - segmentStart);
+        segmentStart = segmentEnd;
+    }
+
+    mSampleClock.store(blockStart + numSamples);
+
+    // 5. Execute deferred heavy operations (bounce, afterloop)
+    if (tracksFree)
+    {
+        DspProfiler::Scope scope(mProfiler, DspProfiler::PendingOps);
+        executePendingOperations();
+    }
+
+    // 6. Output MIDI Clock (24 PPQN) based on detected BPM + optional MIDI pulse on selected channel
+    {
+        DspProfiler::Scope scope(mProfiler, DspProfiler::MidiClock);
+
+        double bpm = mBpm.load();
+        if (bpm > 10.0 && mPrimaryLoopLengthSamples.load() > 0 && !mIsFirstLoop.load())
+        {
+            int syncChannel = 1;
+            if (mParamMidiSyncChannel != nullptr)
+                syncChannel = juce::jlimit(1, 16, juce::roundToInt(mParamMidiSyncChannel->load()) + 1);
+
+            if (!mMidiClockRunning)
+            {
+                // Send MIDI Start
+                midiMessages.addEvent(juce::MidiMessage(0xFA), offset);
+                // Optional pulse to help routing/monitoring on virtual MIDI tracks
+                midiMessages.addEvent(juce::MidiMessage::noteOn(syncChannel, mMidiPulseNote, (juce::uint8)1), offset);
+                midiMessages.addEvent(juce::MidiMessage::noteOff(syncChannel, mMidiPulseNote), offset + juce::jmin(4, numSamples - 1));
+                mMidiClockRunning = true;
+                mMidiClockAccumulator = 0.0;
+            }
+
+            double samplesPerTick = (getSampleRate() * 60.0) / (bpm * 24.0);
+
+            while (mMidiClockAccumulator < (double)numSamples)
+            {
+                int tickPos = static_cast<int>(mMidiClockAccumulator);
+                if (tickPos >= numSamples) break;
+                midiMessages.addEvent(juce::MidiMessage(0xF8), offset + tickPos);
+                // Also mirror each clock tick as a very short note pulse on the selected MIDI channel.
+                // Some hosts/devices route channel messages more reliably than real-time MIDI clock.
+                midiMessages.addEvent(juce::MidiMessage::noteOn(syncChannel, mMidiPulseNote, (juce::uint8)1), offset + tickPos);
+                int offPos = juce::jmin(numSamples - 1, tickPos + 1);
+                midiMessages.addEvent(juce::MidiMessage::noteOff(syncChannel, mMidiPulseNote), offset + offPos);
+                mMidiClockAccumulator += samplesPerTick;
+            }
+            mMidiClockAccumulator -= (double)numSamples;
+        }
+        else if (mMidiClockRunning)
+        {
+            // Send MIDI Stop
+            midiMessages.addEvent(juce::MidiMessage(0xFC), offset);
+            mMidiClockRunning = false;
+            mMidiClockAccumulator = 0.0;
+        }
+    }
+}
 
-    // 4. Track Control Logic
+void SimpleLooperAudioProcessor::processSegment(juce::AudioBuffer<float>& buffer, int bufferOffset,
+                                                int startSample, int numSamples)
+{
+    // 1. Track Control Logic
     // Access via pointer
     if (!mTracks.empty())
     {
@@ -328,10 +583,7 @@ void SimpleLooperAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer,
                  mPrimaryLoopLengthSamples.store(len);
                  calculateBpm(len, getSampleRate());
                  
-                 LOG_SEP("FIRST LOOP COMPLETED");
-                 LOG_VALUE("Master Loop Length", len);
-                 LOG_VALUE("BPM", mBpm.load());
-                 LOG_VALUE("Global Position", mGlobalPlaybackPosition);
+                 TRACE(FirstLoopCompleted, -1, len, mBpm.load(), mGlobalPlaybackPosition);
                  
                  // Switch mode
                  mIsFirstLoop.store(false);
@@ -340,108 +592,164 @@ void SimpleLooperAudioProcessor::processBlock(juce::AudioBuffer<float>& buffer,
         }
     }
 
-    // 3. Process All Tracks
+    // 2. Process All Tracks
     int masterLength = mPrimaryLoopLengthSamples.load();
     bool isFirstLoopPhase = mIsFirstLoop.load();
     juce::int64 currentGlobalTotal = mGlobalTotalSamples.load();
 
-    // Check for Global Solo
-    bool anySolo = false;
-    for (auto& t : mTracks)
+    // Global Solo (from the solo flags gathered by handleParameterChanges)
+    const bool anySolo = mAnySolo;
+
+    // Longest loop, so the page pool keeps enough free pages to rewrite it
+    // in one go (after loop, bounce, undo)
+    int longestLoop = 0;
+
+    juce::AudioBuffer<float> inputSegment(mInputCache.getArrayOfWritePointers(), mInputCache.getNumChannels(),
+                                          startSample, numSamples);
+
+    // If Master Track changes status (e.g. multiplied/divided), we need to update mPrimaryLoopLengthSamples.
+    // Checked before any track renders, so every track sees the same master length.
+    if (!mTracks.empty() && masterLength > 0 && !isFirstLoopPhase)
     {
-        if (t->getSolo())
-        {
-            anySolo = true;
-            break;
-        }
+         // Check if loop length changed
+         int currentLen = mTracks[0]->getLoopLengthSamples();
+         if (currentLen > 0 && currentLen != masterLength)
+         {
+             // Update global length
+             masterLength = currentLen;
+             mPrimaryLoopLengthSamples.store(masterLength);
+         }
     }
 
-    for (size_t i = 0; i < mTracks.size(); ++i)
+    // Render every track, on the render workers when enabled (otherwise all here, in order)
+    mSegmentRender = { &inputSegment, startSample, numSamples, currentGlobalTotal, masterLength, anySolo };
     {
-        bool isMaster = (i == 0);
-        
-        // If Master Track changes status (e.g. multiplied/divided), we need to update mPrimaryLoopLengthSamples
-        if (isMaster && masterLength > 0 && !isFirstLoopPhase)
-        {
-             // Check if loop length changed
-             int currentLen = mTracks[i]->getLoopLengthSamples();
-             if (currentLen > 0 && currentLen != masterLength)
-             {
-                 // Update global length
-                 masterLength = currentLen;
-                 mPrimaryLoopLengthSamples.store(masterLength);
-             }
-        }
-        
-        // Determine output bus for this track from APVTS parameter
-        int outChoice = (i < NUM_TRACKS) ? juce::roundToInt(mParamOutSelect[i]->load()) : 0;
-        int targetBus = outChoice;
-        
-        // Safety: fallback to main output if selected bus is out of range or disabled
-        if (targetBus < 0 || targetBus >= getBusCount(false)
-            || !getBus(false, targetBus)->isEnabled())
-            targetBus = 0;
-        
-        auto busBuffer = getBusBuffer(buffer, false, targetBus);
-        
-        auto& fxCache = (i < NUM_TRACKS) ? mFxReturnCache[i] : mFxReturnCache[0];
-        mTracks[i]->processBlock(busBuffer, mInputCache, fxCache, currentGlobalTotal, isMaster, masterLength, anySolo);
+        DspProfiler::Scope scope(mProfiler, DspProfiler::Tracks);
+        const int lateBefore = mRenderWorkers.getNumLateTasks();
+        mRenderWorkers.run(mNumTracks, &SimpleLooperAudioProcessor::renderTrack, this, mRenderDeadlineMs);
+
+        // A worker preempted past the block keeps its track: silent until it finishes
+        if (mRenderWorkers.getNumLateTasks() != lateBefore)
+            for (int i = 0; i < mNumTracks; ++i)
+                if (!mRenderWorkers.wasRendered(i))
+                    TRACE(RenderTrackLate, i);
+    }
+
+    for (auto& track : mTracks)
+        longestLoop = juce::jmax(longestLoop, track->getLoopLengthSamples());
+
+    mPagePool.setReserveHint(PagePool::pagesForSamples(longestLoop));
+
+    // Sum the tracks into their output buses
+    {
+        DspProfiler::Scope scope(mProfiler, DspProfiler::Mix);
+        if (mMixPlanDirty.exchange(false))
+            rebuildMixPlan();
+        mixTracks(buffer, bufferOffset + startSample, numSamples);
     }
     
-    // 4. Update Global Transport (Playback & Synchronization)
+    // 3. Update Global Transport (Playback & Synchronization)
     if (!isFirstLoopPhase && masterLength > 0)
     {
-        mGlobalPlaybackPosition += buffer.getNumSamples();
+        mGlobalPlaybackPosition += numSamples;
         mGlobalPlaybackPosition %= masterLength;
         
-        mGlobalTotalSamples.store(currentGlobalTotal + buffer.getNumSamples());
+        mGlobalTotalSamples.store(currentGlobalTotal + numSamples);
     }
+}
 
-    // 5. Execute deferred heavy operations (bounce, afterloop)
-    executePendingOperations();
+void SimpleLooperAudioProcessor::renderTrack(void* processor, int trackIndex)
+{
+    auto& p = *static_cast<SimpleLooperAudioProcessor*>(processor);
+    const auto& s = p.mSegmentRender;
+    const auto i = (size_t)trackIndex;
+    DspProfiler::Scope scope(p.mProfiler, DspProfiler::NumStages + trackIndex);
+
+    // View on this segment only (no allocation: AudioBuffer refers to the existing channels)
+    auto& fxCache = p.mFxReturnCache[i];
+    juce::AudioBuffer<float> fxSegment(fxCache.getArrayOfWritePointers(), fxCache.getNumChannels(),
+                                       s.startSample, s.numSamples);
+
+    p.mControls.playing[i] = p.mTracks[i]->processBlock(*s.input, fxSegment, s.globalTotal,
+                                                        trackIndex == 0, s.masterLength, s.anySolo);
+}
 
-    // 6. Output MIDI Clock (24 PPQN) based on detected BPM + optional MIDI pulse on selected channel
-    double bpm = mBpm.load();
-    if (bpm > 10.0 && masterLength > 0 && !isFirstLoopPhase)
+void SimpleLooperAudioProcessor::MixPlan::resize(int numTracks)
+{
+    busOfTrack.assign((size_t)numTracks, 0);
+    tracks.assign((size_t)numTracks, 0);
+    busStart.assign((size_t)numTracks + 2, 0); // numTracks + 1 buses
+    sources.assign((size_t)numTracks, nullptr);
+    gains.assign((size_t)numTracks, 0.0f);
+}
+
+void SimpleLooperAudioProcessor::rebuildMixPlan()
+{
+    const int numBuses = (int)mMixPlan.busStart.size() - 1;
+    const int usableBuses = juce::jmin(getBusCount(false), numBuses);
+
+    // Output bus of each track from its APVTS parameter
+    std::fill(mMixPlan.busStart.begin(), mMixPlan.busStart.end(), 0);
+    for (int i = 0; i < mNumTracks; ++i)
     {
-        int syncChannel = 1;
-        if (mParamMidiSyncChannel != nullptr)
-            syncChannel = juce::jlimit(1, 16, juce::roundToInt(mParamMidiSyncChannel->load()) + 1);
+        int targetBus = juce::roundToInt(mControls.outSelectParam[(size_t)i]->load());
 
-        if (!mMidiClockRunning)
-        {
-            // Send MIDI Start
-            midiMessages.addEvent(juce::MidiMessage(0xFA), 0);
-            // Optional pulse to help routing/monitoring on virtual MIDI tracks
-            midiMessages.addEvent(juce::MidiMessage::noteOn(syncChannel, mMidiPulseNote, (juce::uint8)1), 0);
-            midiMessages.addEvent(juce::MidiMessage::noteOff(syncChannel, mMidiPulseNote), juce::jmin(4, buffer.getNumSamples() - 1));
-            mMidiClockRunning = true;
-            mMidiClockAccumulator = 0.0;
-        }
+        // Safety: fallback to main output if selected bus is out of range or disabled
+        if (targetBus < 0 || targetBus >= usableBuses || !getBus(false, targetBus)->isEnabled())
+            targetBus = 0;
+
+        mMixPlan.busOfTrack[(size_t)i] = targetBus;
+        ++mMixPlan.busStart[(size_t)targetBus + 1];
+    }
 
-        double samplesPerTick = (getSampleRate() * 60.0) / (bpm * 24.0);
-        int numSamples = buffer.getNumSamples();
+    // Group the tracks by bus (counting sort, track order kept within a bus)
+    for (int bus = 0; bus < numBuses; ++bus)
+        mMixPlan.busStart[(size_t)bus + 1] += mMixPlan.busStart[(size_t)bus];
 
-        while (mMidiClockAccumulator < (double)numSamples)
-        {
-            int tickPos = static_cast<int>(mMidiClockAccumulator);
-            if (tickPos >= numSamples) break;
-            midiMessages.addEvent(juce::MidiMessage(0xF8), tickPos);
-            // Also mirror each clock tick as a very short note pulse on the selected MIDI channel.
-            // Some hosts/devices route channel messages more reliably than real-time MIDI clock.
-            midiMessages.addEvent(juce::MidiMessage::noteOn(syncChannel, mMidiPulseNote, (juce::uint8)1), tickPos);
-            int offPos = juce::jmin(numSamples - 1, tickPos + 1);
-            midiMessages.addEvent(juce::MidiMessage::noteOff(syncChannel, mMidiPulseNote), offPos);
-            mMidiClockAccumulator += samplesPerTick;
-        }
-        mMidiClockAccumulator -= (double)numSamples;
+    for (int i = 0; i < mNumTracks; ++i)
+    {
+        auto& next = mMixPlan.busStart[(size_t)mMixPlan.busOfTrack[(size_t)i]];
+        mMixPlan.tracks[(size_t)next++] = i;
     }
-    else if (mMidiClockRunning)
+
+    // The fill pass moved each start to the next bus's start: shift back
+    for (int bus = numBuses; bus > 0; --bus)
+        mMixPlan.busStart[(size_t)bus] = mMixPlan.busStart[(size_t)bus - 1];
+    mMixPlan.busStart[0] = 0;
+}
+
+void SimpleLooperAudioProcessor::mixTracks(juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+{
+    const int numBuses = juce::jmin(getBusCount(false), (int)mMixPlan.busStart.size() - 1);
+
+    for (int bus = 0; bus < numBuses; ++bus)
     {
-        // Send MIDI Stop
-        midiMessages.addEvent(juce::MidiMessage(0xFC), 0);
-        mMidiClockRunning = false;
-        mMidiClockAccumulator = 0.0;
+        const int first = mMixPlan.busStart[(size_t)bus];
+        const int last  = mMixPlan.busStart[(size_t)bus + 1];
+        if (first == last) continue;
+
+        auto busBuffer = getBusBuffer(buffer, false, bus);
+        for (int ch = 0; ch < busBuffer.getNumChannels(); ++ch)
+        {
+            // Gather the tracks of this bus that played, then sum them in one go
+            int numSources = 0;
+            for (int k = first; k < last; ++k)
+            {
+                const int t = mMixPlan.tracks[(size_t)k];
+                if (!mRenderWorkers.wasRendered(t) || !mControls.playing[(size_t)t]) continue;
+
+                const auto& output = mTracks[(size_t)t]->getOutput();
+                if (ch >= output.getNumChannels()) continue;
+
+                mMixPlan.sources[(size_t)numSources] = output.getReadPointer(ch);
+                mMixPlan.gains[(size_t)numSources]   = mControls.volume[(size_t)t];
+                ++numSources;
+            }
+
+            if (numSources > 0)
+                MixKernels::addWeighted(busBuffer.getWritePointer(ch, startSample), mMixPlan.sources.data(),
+                                        mMixPlan.gains.data(), numSources, numSamples);
+        }
     }
 }
 
@@ -459,406 +767,1583 @@ juce::AudioProcessorEditor* SimpleLooperAudioProcessor::createEditor()
 //==============================================================================
 void SimpleLooperAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-}
-
-void SimpleLooperAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
-{
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-}
+    const juce::ScopedLock sessionLock(mSessionLock);
 
-void SimpleLooperAudioProcessor::calculateBpm(int lengthSamples, double sampleRate)
-{
-    if (lengthSamples <= 0 || sampleRate <= 0) return;
-    
-    double durationSecs = (double)lengthSamples / sampleRate;
-    
-    // Calculate raw BPM based on the assumption that the loop is 1 Beat
-    double rawBpm = 60.0 / durationSecs; 
-    
-    // Sanity Check & Adjustment (Target 70-140 BPM)
-    // If BPM is too low (long loop), assume it contains multiple beats/bars
-    while (rawBpm < 70.0)
+    juce::MemoryBlock parameters;
     {
-        rawBpm *= 2.0;
+        juce::MemoryOutputStream out(parameters, false);
+        auto state = apvts.copyState();
+        removeCommandTriggers(state);
+        state.writeToStream(out);
     }
-    // If BPM is too high (short loop), assume it's a fraction of a beat (though less common for loopers)
-    while (rawBpm > 140.0)
+    const auto bindings = mMidiLearn.getBindings();
+
+    // 1. Transport and track snapshots, taken together between two blocks by the
+    // audio thread. O(pages) there, as for the encoder: the callback lock is never
+    // held for it while the host is processing. The audio stays in the shared pages,
+    // which the audio thread copies on write if it overdubs meanwhile.
+    awaitSnapshot(mSaveSnapshot, &SimpleLooperAudioProcessor::takeSaveSnapshot, SAVE_STALLED_MS, nullptr);
+    auto transport = mSaveTransport;
+
+    // Loops of a session still loading are written as they were read (a track with
+    // a file still importing is written as it plays). A restored session whose reset
+    // the audio thread hasn't applied yet replaces every track, and the transport.
+    std::vector<const SessionLoad*> loads;
+    std::vector<bool> loading((size_t)mNumTracks, false);
+    bool restorePending = false;
+    for (const auto& load : mSessionLoads)
     {
-        rawBpm /= 2.0;
+        const auto& slot = mSessionInstalls[(size_t)load.info.index];
+        const bool installed = slot.load == &load && slot.status.load() == SessionInstall::Done;
+        if (load.file != juce::File() || load.superseded || installed || isNewerGeneration(mSaveGeneration, load.resetGeneration))
+            continue;
+
+        loads.push_back(&load);
+        loading[(size_t)load.info.index] = true;
+        restorePending |= isNewerGeneration(load.resetGeneration, mSaveGeneration);
     }
-    
-    mBpm.store(rawBpm);
-    
-    // Log finding (debug)
-    // DBG("Calculated BPM: " << rawBpm);
-}
-
-void SimpleLooperAudioProcessor::resetAll()
-{
-    LOG_SEP("RESET ALL");
-    suspendProcessing(true);
-    resetAllInternal();
-    LOG("Reset complete");
-    LOG_VALUE("IsFirstLoop", true);
-    LOG_VALUE("PrimaryLoopLength", 0);
-    LOG_VALUE("GlobalPosition", 0);
-    suspendProcessing(false);
-}
-
-void SimpleLooperAudioProcessor::resetAllInternal()
-{
-    for (int i = 0; i < mTracks.size(); ++i)
+    if (restorePending)
     {
-        LOG_TRACK(i, "RESET", "");
-        mTracks[i]->clear();
+        transport = mRestoreTransport;
+        transport.sampleRate = mSaveTransport.sampleRate;
+        std::fill(loading.begin(), loading.end(), true);
     }
-        
-    mIsFirstLoop.store(true);
-    mPrimaryLoopLengthSamples.store(0);
-    mGlobalPlaybackPosition = 0;
-    mGlobalTotalSamples.store(0);
-    mBpm.store(0.0);
-}
 
-//==============================================================================
-// Parameter Layout for DAW integration (Ableton Configure, MIDI mapping)
-
-juce::AudioProcessorValueTreeState::ParameterLayout SimpleLooperAudioProcessor::createParameterLayout()
-{
-    juce::AudioProcessorValueTreeState::ParameterLayout layout;
-
-    for (int i = 0; i < NUM_TRACKS; ++i)
+    std::vector<SessionFormat::TrackInfo> infos;
+    infos.reserve(mSessionSources.size());
+    for (int i = 0; i < mNumTracks; ++i)
     {
-        auto idx = juce::String(i);
-        auto name = "Track " + juce::String(i + 1);
-
-        layout.add(std::make_unique<juce::AudioParameterFloat>(
-            juce::ParameterID("vol_" + idx, 1), name + " Volume",
-            juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.8f));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("rec_" + idx, 1), name + " Rec/Play", false));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("mute_" + idx, 1), name + " Mute", false));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("stop_" + idx, 1), name + " Stop", false));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("solo_" + idx, 1), name + " Solo", false));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("afterloop_" + idx, 1), name + " After Loop", false));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("clear_" + idx, 1), name + " Clear", false));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("undo_" + idx, 1), name + " Undo", false));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("mul_" + idx, 1), name + " Multiply", false));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("div_" + idx, 1), name + " Divide", false));
-        layout.add(std::make_unique<juce::AudioParameterChoice>(
-            juce::ParameterID("out_select_" + idx, 1), name + " Output",
-            juce::StringArray{"Monitor 1/2", "Output 3/4", "Output 5/6", "Output 7/8",
-                              "Output 9/10", "Output 11/12", "Output 13/14"}, i + 1));
-        layout.add(std::make_unique<juce::AudioParameterBool>(
-            juce::ParameterID("resample_" + idx, 1), name + " FX Replace", false));
+        auto& source = mSessionSources[(size_t)i];
+        if (loading[(size_t)i])
+            releaseSource(source, PagePool::Caller::OtherThread);
+        else if (source.used)
+            infos.push_back(mSaveInfos[(size_t)i]);
     }
 
-    layout.add(std::make_unique<juce::AudioParameterBool>(
-        juce::ParameterID("bounce_back", 1), "Bounce Back", false));
-    layout.add(std::make_unique<juce::AudioParameterBool>(
-        juce::ParameterID("reset_all", 1), "Reset All", false));
-    layout.add(std::make_unique<juce::AudioParameterChoice>(
-        juce::ParameterID("midi_sync_channel", 1), "MIDI Sync Channel",
-        juce::StringArray{
-            "CH 1", "CH 2", "CH 3", "CH 4", "CH 5", "CH 6", "CH 7", "CH 8",
-            "CH 9", "CH 10", "CH 11", "CH 12", "CH 13", "CH 14", "CH 15", "CH 16"
-        },
-        0));
-
-    return layout;
-}
-
-void SimpleLooperAudioProcessor::handleParameterChanges()
-{
-    for (int i = 0; i < (int)mTracks.size() && i < NUM_TRACKS; ++i)
+    // 2. Loop audio from the snapshots (outside the callback lock): the blocks the
+    // encoder thread has compressed, rendered and hashed to check they're current.
+    // Nothing is encoded here: a stale block is stored uncompressed, next to the
+    // track's current ones, and the encoder is woken so the next save finds it.
+    std::vector<std::vector<SessionAudioCache::Encoded>> audio(infos.size());
+    std::vector<juce::uint64> payloadSizes(infos.size(), SessionFormat::TrackInfo::size);
+    juce::AudioBuffer<float> scratch(AudioPage::numChannels, SessionFormat::blockFrames);
+    bool anyStale = false;
+    for (size_t k = 0; k < infos.size(); ++k)
     {
-        // Volume (continuous, driven by SliderAttachment)
-        float volVal = mParamVol[i]->load();
-        mTracks[i]->setVolume(volVal);
-
-        // Mute (direct sync, driven by ButtonAttachment toggle)
-        bool muVal = mParamMute[i]->load() >= 0.5f;
-        mTracks[i]->setMuted(muVal);
-
-        // Solo (direct sync, driven by ButtonAttachment toggle)
-        bool soVal = mParamSolo[i]->load() >= 0.5f;
-        mTracks[i]->setSolo(soVal);
-
-        // FX Replace trigger (any edge)
-        bool rsmpVal = mParamResample[i]->load() >= 0.5f;
-        if (rsmpVal != mPrevResample[i])
-            mTracks[i]->applyFxReplace();
-        mPrevResample[i] = rsmpVal;
+        auto& info = infos[k];
+        if (findEncodedSessionTrack(info.index, mSessionSources[(size_t)info.index], info.numChannels, scratch, audio[k]))
+        {
+            for (const auto& block : audio[k])
+                payloadSizes[k] += 4 + block->getSize();
+            continue;
+        }
 
-        // Rec/Play trigger (any edge = state cycle, compatible with ButtonAttachment toggle)
-        bool rpVal = mParamRecPlay[i]->load() >= 0.5f;
-        if (rpVal != mPrevRecPlay[i])
+        info.codec = SessionFormat::Codec::PerBlock;
+        for (int block = 0; block < info.getNumBlocks(); ++block)
         {
-            auto state = mTracks[i]->getState();
-            switch (state)
-            {
-                case LoopTrack::State::Empty:       mTracks[i]->setRecording(); break;
-                case LoopTrack::State::Recording:   mTracks[i]->setPlaying(); break;
-                case LoopTrack::State::Playing:     mTracks[i]->setOverdubbing(); break;
-                case LoopTrack::State::Overdubbing:  mTracks[i]->setPlaying(); break;
-                case LoopTrack::State::Stopped:     mTracks[i]->setPlaying(); break;
-            }
+            const auto& encoded = audio[k][(size_t)block];
+            payloadSizes[k] += encoded != nullptr ? SessionFormat::getCompressedBlockSize(*encoded)
+                                                  : SessionFormat::getRawBlockSize(info.numChannels, info.getBlockLength(block));
         }
-        mPrevRecPlay[i] = rpVal;
+        anyStale = true;
+    }
 
-        // Stop trigger (any edge)
-        bool stVal = mParamStop[i]->load() >= 0.5f;
-        if (stVal != mPrevStop[i])
-            mTracks[i]->stop();
-        mPrevStop[i] = stVal;
+    if (anyStale)
+        mSessionEncoder.notify();
+
+    // 3. Exact size first: the stream then writes into the host's block without
+    // it ever being reallocated (and copied) as it grows
+    const juce::uint64 midiSize = 4 + 5 * (juce::uint64)bindings.size();
+    juce::uint64 totalSize = SessionFormat::headerSize
+                           + SessionFormat::chunkHeaderSize + parameters.getSize()
+                           + SessionFormat::chunkHeaderSize + midiSize
+                           + SessionFormat::chunkHeaderSize + SessionFormat::Transport::size;
+    for (const auto size : payloadSizes)
+        totalSize += SessionFormat::chunkHeaderSize + size;
+    for (const auto* load : loads)
+        totalSize += SessionFormat::chunkHeaderSize + SessionFormat::TrackInfo::size + load->audio.getSize();
+
+    destData.setSize((size_t)totalSize + 32); // MemoryOutputStream grows a block it would fill exactly
+    {
+        juce::MemoryOutputStream out(destData, false);
+        SessionFormat::writeHeader(out);
 
-        // After Loop trigger (any edge)
-        bool alVal = mParamAfterLoop[i]->load() >= 0.5f;
-        if (alVal != mPrevAfterLoop[i])
-            mPendingAfterLoop.store(i);
-        mPrevAfterLoop[i] = alVal;
+        SessionFormat::writeChunkHeader(out, SessionFormat::parametersId, parameters.getSize());
+        out.write(parameters.getData(), parameters.getSize());
 
-        // Clear trigger (any edge)
-        bool clVal = mParamClear[i]->load() >= 0.5f;
-        if (clVal != mPrevClear[i])
-            mTracks[i]->clear();
-        mPrevClear[i] = clVal;
+        SessionFormat::writeChunkHeader(out, SessionFormat::midiLearnId, midiSize);
+        out.writeInt((int)bindings.size());
+        for (const auto& binding : bindings)
+        {
+            out.writeByte((char)binding.source);
+            out.writeByte((char)binding.channel);
+            out.writeByte((char)binding.number);
+            out.writeByte((char)binding.type);
+            out.writeByte((char)binding.track);
+        }
 
-        // Undo trigger (any edge)
-        bool udVal = mParamUndo[i]->load() >= 0.5f;
-        if (udVal != mPrevUndo[i])
-            mTracks[i]->performUndo();
-        mPrevUndo[i] = udVal;
+        SessionFormat::writeChunkHeader(out, SessionFormat::transportId, SessionFormat::Transport::size);
+        SessionFormat::write(out, transport);
 
-        // Multiply trigger (any edge)
-        bool mlVal = mParamMul[i]->load() >= 0.5f;
-        if (mlVal != mPrevMul[i])
+        for (const auto* load : loads)
         {
-            if (mTracks[i]->getState() == LoopTrack::State::Empty)
-            {
-                float m = mTracks[i]->getTargetMultiplier() * 2.0f;
-                if (m > 64.0f) m = 64.0f;
-                mTracks[i]->setTargetMultiplier(m);
-            }
-            else
-            {
-                mTracks[i]->multiplyLoop();
-            }
+            SessionFormat::writeChunkHeader(out, SessionFormat::trackId, SessionFormat::TrackInfo::size + load->audio.getSize());
+            SessionFormat::write(out, load->info);
+            out.write(load->audio.getData(), load->audio.getSize());
         }
-        mPrevMul[i] = mlVal;
 
-        // Divide trigger (any edge)
-        bool dvVal = mParamDiv[i]->load() >= 0.5f;
-        if (dvVal != mPrevDiv[i])
+        for (size_t k = 0; k < infos.size(); ++k)
         {
-            if (mTracks[i]->getState() == LoopTrack::State::Empty)
+            SessionFormat::writeChunkHeader(out, SessionFormat::trackId, payloadSizes[k]);
+            SessionFormat::write(out, infos[k]);
+
+            if (infos[k].codec == SessionFormat::Codec::PerBlock)
             {
-                float m = mTracks[i]->getTargetMultiplier() / 2.0f;
-                if (m < 1.0f / 64.0f) m = 1.0f / 64.0f;
-                mTracks[i]->setTargetMultiplier(m);
+                writeSessionTrackBlocks(out, mSessionSources[(size_t)infos[k].index], infos[k].numChannels, audio[k], scratch);
+                continue;
             }
-            else
+
+            for (const auto& block : audio[k])
             {
-                mTracks[i]->divideLoop();
+                out.writeInt((int)block->getSize());
+                out.write(block->getData(), block->getSize());
             }
         }
-        mPrevDiv[i] = dvVal;
-    }
+    } // the stream trims the block to what was written
 
-    // Bounce Back trigger (any edge)
-    bool bnVal = mParamBounce->load() >= 0.5f;
-    if (bnVal != mPrevBounce)
-        mPendingBounce.store(true);
-    mPrevBounce = bnVal;
+    for (auto& source : mSessionSources)
+        releaseSource(source, PagePool::Caller::OtherThread);
+    mSaveSnapshot.store(SnapshotIdle);
+
+    TRACE(SessionSaved, -1, (double)(infos.size() + loads.size()), (double)destData.getSize());
+}
+
+void SimpleLooperAudioProcessor::takeSaveSnapshot()
+{
+    auto& transport = mSaveTransport;
+    transport.sampleRate             = getSampleRate();
+    transport.bpm                    = mBpm.load();
+    transport.primaryLoopLength      = mPrimaryLoopLengthSamples.load();
+    transport.globalPlaybackPosition = mGlobalPlaybackPosition;
+    transport.globalTotalSamples     = mGlobalTotalSamples.load();
+    transport.isFirstLoop            = mIsFirstLoop.load();
+    mSaveGeneration = mResetGeneration;
+
+    for (int i = 0; i < mNumTracks; ++i)
+    {
+        auto& track  = *mTracks[(size_t)i];
+        auto& source = mSessionSources[(size_t)i];
+        const auto state = track.getState();
+
+        // A first pass still recording has no loop yet
+        source.used = false;
+        if (state == LoopTrack::State::Recording || state == LoopTrack::State::Empty)
+            continue;
+
+        snapshotTrack(i, source);
+        if (!source.used) continue;
+
+        auto& info = mSaveInfos[(size_t)i];
+        info.index                      = i;
+        info.state                      = (int)(state == LoopTrack::State::Stopped ? state : LoopTrack::State::Playing);
+        info.length                     = source.length;
+        info.recordingStartOffset       = track.getRecordingStartOffset();
+        info.recordingStartGlobalSample = source.startGlobal;
+        info.targetMultiplier           = track.getTargetMultiplier();
+        info.numChannels                = juce::jmin(AudioPage::numChannels, source.getNumChannels());
+    }
+    mSaveSnapshot.store(SnapshotReady);
+}
+
+bool SimpleLooperAudioProcessor::awaitSnapshot(std::atomic<int>& snapshot, void (SimpleLooperAudioProcessor::*take)(),
+                                               int stalledMs, juce::Thread* thread)
+{
+    snapshot.store(SnapshotRequested);
+    auto lastClock = mSampleClock.load();
+    double lastBlockMs = juce::Time::getMillisecondCounterHiRes();
+
+    while (snapshot.load() != SnapshotReady)
+    {
+        int expected = SnapshotRequested;
+        if (thread != nullptr && thread->threadShouldExit() && snapshot.compare_exchange_strong(expected, SnapshotIdle))
+            return false;
+
+        if (thread != nullptr)
+            thread->wait(5);
+        else
+            juce::Thread::sleep(1);
+
+        // The host stopped calling processBlock (transport stopped, plugin bypassed):
+        // nothing else touches the tracks while the callback lock is held
+        const auto clock = mSampleClock.load();
+        const double nowMs = juce::Time::getMillisecondCounterHiRes();
+        if (clock != lastClock)
+        {
+            lastClock = clock;
+            lastBlockMs = nowMs;
+        }
+        else if (nowMs - lastBlockMs >= stalledMs)
+        {
+            const juce::ScopedLock callbackLock(getCallbackLock());
+            if (snapshot.load() == SnapshotRequested)
+                (this->*take)();
+        }
+    }
+    return true;
+}
+
+void SimpleLooperAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    if (data == nullptr || sizeInBytes <= 0) return;
+
+    // Read in place: the host's data is never copied whole
+    juce::MemoryInputStream in(data, (size_t)sizeInBytes, false);
+    if (!SessionFormat::readHeader(in)) return;
+
+    const juce::ScopedLock sessionLock(mSessionLock);
+
+    SessionFormat::Transport transport;
+    bool hasTransport = false;
+    std::list<SessionLoad> loaded;
+
+    juce::uint32 id = 0;
+    juce::uint64 payloadSize = 0;
+    while (SessionFormat::readChunkHeader(in, id, payloadSize))
+    {
+        const auto chunkEnd = in.getPosition() + (juce::int64)payloadSize;
+
+        if (id == SessionFormat::parametersId)
+        {
+            auto state = juce::ValueTree::readFromStream(in);
+            if (state.hasType(apvts.state.getType()))
+            {
+                // Sessions saved before the triggers were left out still carry them
+                removeCommandTriggers(state);
+                apvts.replaceState(state);
+            }
+        }
+        else if (id == SessionFormat::midiLearnId && payloadSize >= 4)
+        {
+            const auto count = juce::jmin((juce::uint64)(juce::uint32)in.readInt(), (payloadSize - 4) / 5);
+            std::vector<MidiLearn::Binding> bindings((size_t)count);
+            for (auto& binding : bindings)
+            {
+                binding.source  = (MidiLearn::Source)(juce::uint8)in.readByte();
+                binding.channel = (juce::uint8)in.readByte();
+                binding.number  = (juce::uint8)in.readByte();
+                binding.type    = (LooperCommand::Type)(juce::uint8)in.readByte();
+                binding.track   = (juce::uint8)in.readByte();
+            }
+            mMidiLearn.setBindings(bindings);
+        }
+        else if (id == SessionFormat::transportId)
+        {
+            hasTransport = SessionFormat::read(in, payloadSize, transport);
+        }
+        else if (id == SessionFormat::trackId)
+        {
+            // Only the stored (compressed) audio is copied here; the loader decodes it
+            SessionLoad load;
+            if (SessionFormat::read(in, payloadSize, load.info)
+                && load.info.index >= 0 && load.info.index < mNumTracks)
+            {
+                const auto audioSize = (size_t)(chunkEnd - in.getPosition());
+                load.audio.setSize(audioSize);
+                if (in.read(load.audio.getData(), (int)audioSize) == (int)audioSize)
+                {
+                    // A later chunk for the same track wins
+                    loaded.remove_if([&](const SessionLoad& other) { return other.info.index == load.info.index; });
+                    loaded.push_back(std::move(load));
+                }
+            }
+        }
+
+        in.setPosition(chunkEnd);
+    }
+
+    // Replace the whole looper between two blocks, with a reset through the command
+    // queue: the audio thread clears the tracks and starts the session's transport
+    // there, then installs each loop in sync once its generation is current.
+    LooperCommand reset { LooperCommand::Type::Reset, 0, getCommandTime() };
+    reset.generation = ++mResetsRequested;
+    mRestoreGeneration.store(0);
+    mRestoreTransport = hasTransport ? transport : SessionFormat::Transport();
+    mRestoreGeneration.store(reset.generation);
+    if (!pushCommand(reset))
+        return;
+
+    // A session still loading is superseded: loops not decoded yet are dropped, the
+    // others are dropped by the audio thread (the reset above changes the generation)
+    for (auto it = mSessionLoads.begin(); it != mSessionLoads.end();)
+    {
+        if (it->taken)
+            (it++)->superseded = true;
+        else
+            it = mSessionLoads.erase(it);
+    }
+
+    const auto generation = reset.generation;
+    const auto numLoops = loaded.size();
+    for (auto& load : loaded)
+        load.resetGeneration = generation;
+    mSessionLoads.splice(mSessionLoads.end(), loaded);
+
+    if (!mSessionLoader.isThreadRunning())
+        mSessionLoader.startThread(juce::Thread::Priority::low);
+    mSessionLoader.notify();
+
+    // Loops play at the session's speed: there is no rate conversion yet
+    if (hasTransport && getSampleRate() > 0.0 && transport.sampleRate > 0.0 && transport.sampleRate != getSampleRate())
+        TRACE(SessionRateMismatch, -1, transport.sampleRate, getSampleRate());
+
+    TRACE(SessionLoaded, -1, (double)numLoops, (double)sizeInBytes);
+}
+
+void SimpleLooperAudioProcessor::SessionLoader::run()
+{
+    while (!threadShouldExit())
+    {
+        const int waitMs = owner.loadNextSessionTrack();
+        if (waitMs != 0)
+            wait(waitMs); // -1: until the next load
+    }
+}
+
+int SimpleLooperAudioProcessor::loadNextSessionTrack()
+{
+    SessionLoad* next = nullptr;
+    StagingBuffer* buffer = nullptr;
+    bool probeFirst = false;
+    {
+        const juce::ScopedLock sessionLock(mSessionLock);
+
+        // 1. Loops the audio thread has dealt with (installed, or dropped after a reset)
+        for (auto& slot : mSessionInstalls)
+        {
+            if (slot.status.load() != SessionInstall::Done) continue;
+
+            mSessionLoads.remove_if([&](const SessionLoad& load) { return &load == slot.load; });
+            slot.load = nullptr;
+            slot.status.store(SessionInstall::Free);
+        }
+
+        if (mSessionLoads.empty())
+            return -1;
+
+        // 2. The next loop whose track can take one
+        for (auto& load : mSessionLoads)
+        {
+            if (!load.taken && mSessionInstalls[(size_t)load.info.index].status.load() == SessionInstall::Free)
+            {
+                next = &load;
+                break;
+            }
+        }
+        if (next == nullptr)
+            return 10; // the audio thread hasn't installed the previous loop of that track yet
+
+        // 3. An import's length is known once the file's header is read (outside the lock)
+        probeFirst = next->file != juce::File() && next->info.length <= 0;
+
+        // Bounded memory: decoded audio not copied into pages yet stays within the
+        // budget (a loop larger than the budget is decoded alone)
+        size_t inFlight = 0;
+        for (const auto& decoded : mSessionBuffers)
+            if (decoded->refCount.load() > 0)
+                inFlight += (size_t)decoded->audio.getNumChannels() * (size_t)decoded->audio.getNumSamples() * sizeof(float);
+
+        const auto needed = (size_t)AudioPage::numChannels * (size_t)next->info.length * sizeof(float);
+        if (!probeFirst && inFlight > 0 && inFlight + needed > SESSION_LOAD_BUDGET_BYTES)
+            return 10;
+
+        next->taken = true;
+        if (!probeFirst)
+        {
+            mSessionBuffers.push_back(std::make_unique<StagingBuffer>());
+            buffer = mSessionBuffers.back().get();
+            buffer->refCount.store(1); // the loader's, until the audio thread installs it
+        }
+    }
+
+    if (probeFirst)
+    {
+        AudioImport::FileInfo fileInfo;
+        const int length = AudioImport::probe(next->file, fileInfo)
+                         ? getImportLength(fileInfo, next->info.index, next->alignToMaster) : 0;
+
+        const juce::ScopedLock sessionLock(mSessionLock);
+        if (length <= 0 || next->superseded)
+        {
+            if (length <= 0)
+                TRACE(AudioImportFailed, next->info.index);
+            mSessionLoads.remove_if([&](const SessionLoad& load) { return &load == next; });
+        }
+        else
+        {
+            next->info.length = length; // queued like any loop from here
+            next->taken = false;
+        }
+        return 0;
+    }
+
+    // 4. Decode outside the lock (a save meanwhile writes this loop from its stored audio)
+    buffer->audio.setSize(AudioPage::numChannels, next->info.length, false, false, true);
+    bool decoded = false;
+    if (next->file != juce::File())
+    {
+        decoded = AudioImport::decode(next->file, getSampleRate(), buffer->audio, next->info.length);
+    }
+    else
+    {
+        juce::MemoryInputStream in(next->audio, false);
+        decoded = SessionFormat::readAudio(in, next->info, buffer->audio);
+    }
+
+    const juce::ScopedLock sessionLock(mSessionLock);
+    if (!decoded || next->superseded)
+    {
+        if (!decoded && next->file != juce::File())
+            TRACE(AudioImportFailed, next->info.index);
+        else if (!decoded)
+            TRACE(SessionTrackUnreadable, next->info.index);
+
+        StagingBufferPool::release(buffer); // deleted by the background thread
+        mSessionLoads.remove_if([&](const SessionLoad& load) { return &load == next; });
+        return 0;
+    }
+
+    // 5. Hand it over: the audio thread installs it at the start of a block
+    auto& slot = mSessionInstalls[(size_t)next->info.index];
+    slot.load            = next;
+    slot.buffer          = buffer;
+    slot.info            = next->info;
+    slot.resetGeneration = next->resetGeneration;
+    slot.isImport        = next->file != juce::File();
+    slot.alignToMaster   = next->alignToMaster;
+    slot.status.store(SessionInstall::Ready);
+    return 0;
+}
+
+void SimpleLooperAudioProcessor::installSessionTracks()
+{
+    for (int i = 0; i < mNumTracks; ++i)
+    {
+        auto& slot = mSessionInstalls[(size_t)i];
+        if (slot.status.load() != SessionInstall::Ready) continue;
+
+        // A restored session's loops wait for its reset
+        if (isNewerGeneration(slot.resetGeneration, mResetGeneration.load())) continue;
+
+        // A reset (or another session) since the load makes the loop meaningless
+        if (slot.resetGeneration == mResetGeneration.load())
+        {
+            auto& track = *mTracks[(size_t)i];
+            if (slot.isImport && !canImportInto(i))
+            {
+                // No master loop to follow any more, or other loops follow this one
+                TRACE(AudioImportFailed, i);
+                slot.info.length = 0;
+            }
+            else if (slot.isImport && i == 0)
+            {
+                // The file becomes the master loop: the transport starts over from its top,
+                // and the first-loop logic takes its length and tempo on the next block
+                mIsFirstLoop.store(true);
+                mPrimaryLoopLengthSamples.store(0);
+                mGlobalPlaybackPosition = 0;
+                mGlobalTotalSamples.store(0);
+                track.beginProgressiveReplace(slot.buffer, slot.info.length, 0, 0);
+            }
+            else if (slot.isImport)
+            {
+                // From now: with the master loop's current pass, or from the top of the file
+                const int masterLen = mPrimaryLoopLengthSamples.load();
+                juce::int64 startGlobal = mGlobalTotalSamples.load();
+                if (slot.alignToMaster && masterLen > 0 && !mIsFirstLoop.load())
+                    startGlobal = juce::jmax((juce::int64)0, startGlobal - mGlobalPlaybackPosition);
+
+                track.beginProgressiveReplace(slot.buffer, slot.info.length,
+                                              masterLen > 0 ? (int)(startGlobal % masterLen) : 0, startGlobal);
+            }
+            else
+            {
+                track.beginProgressiveReplace(slot.buffer, slot.info.length,
+                                              slot.info.recordingStartOffset, slot.info.recordingStartGlobalSample);
+                track.setTargetMultiplier(slot.info.targetMultiplier);
+                if ((LoopTrack::State)slot.info.state == LoopTrack::State::Stopped)
+                    track.stop();
+            }
+
+            if (slot.info.length > 0)
+                TRACE(SessionTrackInstalled, i, slot.info.length);
+        }
+
+        // The track took its own reference (none if the loop is longer than it holds)
+        StagingBufferPool::release(slot.buffer);
+        slot.buffer = nullptr;
+        slot.status.store(SessionInstall::Done);
+    }
+}
+
+std::vector<SessionAudioCache::Encoded> SimpleLooperAudioProcessor::encodeSessionTrack(int trackIndex,
+    const LoopJob::Source& source, int numChannels, juce::AudioBuffer<float>& scratch)
+{
+    const int numBlocks = (source.length + SessionFormat::blockFrames - 1) / SessionFormat::blockFrames;
+
+    std::vector<SessionAudioCache::Encoded> blocks;
+    blocks.reserve((size_t)numBlocks);
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        const int start = block * SessionFormat::blockFrames;
+        const int numFrames = juce::jmin(SessionFormat::blockFrames, source.length - start);
+
+        scratch.clear(0, numFrames);
+        renderSource(source, scratch.getArrayOfWritePointers(), numChannels, 0, numFrames, start);
+        blocks.push_back(mSessionCache.encode(trackIndex, block, scratch, numChannels, numFrames));
+    }
+
+    mSessionCache.trim(trackIndex, numBlocks); // the loop got shorter
+    return blocks;
+}
+
+bool SimpleLooperAudioProcessor::findEncodedSessionTrack(int trackIndex, const LoopJob::Source& source, int numChannels,
+                                                         juce::AudioBuffer<float>& scratch,
+                                                         std::vector<SessionAudioCache::Encoded>& blocks)
+{
+    const int numBlocks = (source.length + SessionFormat::blockFrames - 1) / SessionFormat::blockFrames;
+
+    blocks.clear();
+    blocks.reserve((size_t)numBlocks);
+    bool allFound = true;
+    for (int block = 0; block < numBlocks; ++block)
+    {
+        const int start = block * SessionFormat::blockFrames;
+        const int numFrames = juce::jmin(SessionFormat::blockFrames, source.length - start);
+
+        scratch.clear(0, numFrames);
+        renderSource(source, scratch.getArrayOfWritePointers(), numChannels, 0, numFrames, start);
+
+        blocks.push_back(mSessionCache.find(trackIndex, block, SessionFormat::hashBlock(scratch, numChannels, numFrames), numChannels));
+        allFound = allFound && blocks.back() != nullptr;
+    }
+    return allFound;
+}
+
+void SimpleLooperAudioProcessor::writeSessionTrackBlocks(juce::OutputStream& out, const LoopJob::Source& source, int numChannels,
+                                                         const std::vector<SessionAudioCache::Encoded>& blocks,
+                                                         juce::AudioBuffer<float>& scratch)
+{
+    for (size_t block = 0; block < blocks.size(); ++block)
+    {
+        if (blocks[block] != nullptr)
+        {
+            SessionFormat::writeCompressedBlock(out, *blocks[block]);
+            continue;
+        }
+
+        // Rendered again: only the stale blocks, rather than keeping every block's samples
+        const int start = (int)block * SessionFormat::blockFrames;
+        const int numFrames = juce::jmin(SessionFormat::blockFrames, source.length - start);
+
+        scratch.clear(0, numFrames);
+        renderSource(source, scratch.getArrayOfWritePointers(), numChannels, 0, numFrames, start);
+        SessionFormat::writeRawBlock(out, scratch, numChannels, numFrames);
+    }
+}
+
+void SimpleLooperAudioProcessor::SessionEncoder::run()
+{
+    juce::AudioBuffer<float> scratch(AudioPage::numChannels, SessionFormat::blockFrames);
+
+    while (!threadShouldExit())
+    {
+        wait(SESSION_ENCODE_INTERVAL_MS);
+
+        // Polled: signalling would take a lock on the audio thread every few seconds
+        owner.mEncoderSnapshot.store(SnapshotRequested);
+        while (owner.mEncoderSnapshot.load() != SnapshotReady)
+        {
+            int expected = SnapshotRequested;
+            if (threadShouldExit() && owner.mEncoderSnapshot.compare_exchange_strong(expected, SnapshotIdle))
+                return;
+            wait(5);
+        }
+
+        for (int i = 0; i < owner.mNumTracks; ++i)
+        {
+            auto& source = owner.mEncoderSources[(size_t)i];
+            if (!source.used)
+                owner.mSessionCache.trim(i, 0); // empty track
+            else if (!threadShouldExit())
+                owner.encodeSessionTrack(i, source, juce::jmin(AudioPage::numChannels, source.getNumChannels()), scratch);
+
+            releaseSource(source, PagePool::Caller::OtherThread);
+        }
+        owner.mEncoderSnapshot.store(SnapshotIdle);
+    }
+}
+
+void SimpleLooperAudioProcessor::reclaimSessionBuffers()
+{
+    // Never waits for a save or load in progress: the next slice retries
+    const juce::ScopedTryLock sessionLock(mSessionLock);
+    if (!sessionLock.isLocked()) return;
+
+    mSessionBuffers.erase(std::remove_if(mSessionBuffers.begin(), mSessionBuffers.end(),
+                                         [](const std::unique_ptr<StagingBuffer>& buffer) { return buffer->refCount.load() == 0; }),
+                          mSessionBuffers.end());
+}
+
+bool SimpleLooperAudioProcessor::canImportInto(int trackIndex) const
+{
+    if (trackIndex < 0 || trackIndex >= mNumTracks
+        || mTracks[(size_t)trackIndex]->getState() == LoopTrack::State::Recording)
+        return false;
+
+    // Other tracks play against the master's transport: they need one running
+    if (trackIndex > 0)
+        return !mIsFirstLoop.load() && mPrimaryLoopLengthSamples.load() > 0;
+
+    // The master restarts the transport, which would shift every other loop
+    for (int i = 1; i < mNumTracks; ++i)
+        if (mTracks[(size_t)i]->getState() != LoopTrack::State::Empty)
+            return false;
+    return true;
+}
+
+bool SimpleLooperAudioProcessor::importAudioFile(int trackIndex, const juce::File& file, bool alignToMaster)
+{
+    if (!canImportInto(trackIndex) || getSampleRate() <= 0.0 || !file.existsAsFile())
+        return false;
+
+    SessionLoad load;
+    load.file = file;
+    load.alignToMaster = alignToMaster;
+    load.info.index = trackIndex;
+    load.info.state = (int)LoopTrack::State::Playing;
+    load.resetGeneration = mResetGeneration.load(); // a reset before the file lands drops it
+
+    const juce::ScopedLock sessionLock(mSessionLock);
+
+    // A newer import into the track replaces one not started yet
+    mSessionLoads.remove_if([&](const SessionLoad& other)
+                            { return !other.taken && other.file != juce::File() && other.info.index == trackIndex; });
+    mSessionLoads.push_back(std::move(load));
+
+    if (!mSessionLoader.isThreadRunning())
+        mSessionLoader.startThread(juce::Thread::Priority::low);
+    mSessionLoader.notify();
+    return true;
+}
+
+int SimpleLooperAudioProcessor::getImportLength(const AudioImport::FileInfo& file, int trackIndex, bool alignToMaster) const
+{
+    // Longer than the track holds: the file's start
+    const int capacity = mTracks[(size_t)trackIndex]->getLoopImage().getCapacity();
+    auto length = juce::jmin((juce::int64)capacity, AudioImport::getConvertedLength(file, getSampleRate()));
+
+    // Nearest whole number of master loops (the end is cut, or padded with silence)
+    const int masterLen = mPrimaryLoopLengthSamples.load();
+    if (alignToMaster && masterLen > 0 && masterLen <= capacity && !mIsFirstLoop.load())
+    {
+        const auto numLoops = juce::jlimit((juce::int64)1, (juce::int64)(capacity / masterLen),
+                                           (length + masterLen / 2) / masterLen);
+        length = numLoops * masterLen;
+    }
+    return (int)length;
+}
+
+//==============================================================================
+bool SimpleLooperAudioProcessor::exportStems(const StemExport::Options& options)
+{
+    if (getStemExportState() == ExportState::Running)
+        return false;
+
+    mStemExporter.stopThread(1000); // the last export's, finished
+    mExportOptions = options;
+    mExportFramesDone.store(0);
+    mExportFramesTotal.store(0);
+    mExportState.store((int)ExportState::Running);
+    mStemExporter.startThread(juce::Thread::Priority::low);
+    return true;
+}
+
+float SimpleLooperAudioProcessor::getStemExportProgress() const
+{
+    const auto total = mExportFramesTotal.load();
+    return total > 0 ? (float)((double)mExportFramesDone.load() / (double)total) : 0.0f;
+}
+
+void SimpleLooperAudioProcessor::takeExportSnapshot()
+{
+    // Stem export: every track at the same instant, as long as a bounce would be
+    int length = mPrimaryLoopLengthSamples.load();
+    for (int i = 0; i < mNumTracks; ++i)
+    {
+        auto& source = mExportSources[(size_t)i];
+        snapshotTrack(i, source);
+        if (source.used)
+            length = juce::jmax(length, source.length);
+    }
+    mExportLength = length;
+    mExportSnapshot.store(SnapshotReady);
+}
+
+void SimpleLooperAudioProcessor::StemExporter::run()
+{
+    const double startMs = juce::Time::getMillisecondCounterHiRes();
+
+    // 1. Snapshot, polled like the encoder's
+    if (!owner.awaitSnapshot(owner.mExportSnapshot, &SimpleLooperAudioProcessor::takeExportSnapshot, EXPORT_STALLED_MS, this))
+    {
+        owner.mExportState.store((int)ExportState::Failed);
+        return;
+    }
+
+    // 2. One file per loop, then the mix
+    const auto& options = owner.mExportOptions;
+    const auto extension = StemExport::getFileExtension(options.format);
+    bool ok = options.folder.createDirectory().wasOk();
+
+    owner.mExportFiles.clear();
+    if (ok)
+    {
+        for (int i = 0; i < owner.mNumTracks; ++i)
+            if (owner.mExportSources[(size_t)i].used)
+                owner.mExportFiles.push_back({ options.folder.getChildFile("Track " + juce::String(i + 1) + extension), i });
+
+        if (options.includeMix && !owner.mExportFiles.empty())
+            owner.mExportFiles.push_back({ options.folder.getChildFile("Mix" + extension), -1 });
+    }
+    owner.mExportSampleRate = owner.getSampleRate();
+    owner.mExportFramesTotal.store((juce::int64)owner.mExportFiles.size() * owner.mExportLength);
+
+    // 3. Write them in parallel, on this thread and the export threads
+    const int numHelpers = juce::jlimit(0, owner.mExportThreads.getNumThreads(), (int)owner.mExportFiles.size() - 1);
+    owner.mExportNextFile.store(0);
+    owner.mExportParticipants.store(numHelpers + 1);
+    owner.mExportDone.reset();
+
+    for (int i = 0; i < numHelpers; ++i)
+        owner.mExportThreads.addJob([this] { owner.exportFiles(); });
+    owner.exportFiles();
+    owner.mExportDone.wait();
+
+    for (const auto& file : owner.mExportFiles)
+        ok = ok && file.written;
+
+    for (auto& source : owner.mExportSources)
+        releaseSource(source, PagePool::Caller::OtherThread);
+    owner.mExportSnapshot.store(SnapshotIdle);
+
+    if (ok)
+        TRACE(StemsExported, -1, (double)owner.mExportFiles.size(), juce::Time::getMillisecondCounterHiRes() - startMs);
+    owner.mExportState.store((int)(ok ? ExportState::Done : ExportState::Failed));
+}
+
+void SimpleLooperAudioProcessor::exportFiles()
+{
+    juce::AudioBuffer<float> scratch(AudioPage::numChannels, EXPORT_BLOCK_SAMPLES);
+
+    for (int i = mExportNextFile.fetch_add(1); i < (int)mExportFiles.size(); i = mExportNextFile.fetch_add(1))
+        mExportFiles[(size_t)i].written = writeExportFile(mExportFiles[(size_t)i], scratch);
+
+    if (mExportParticipants.fetch_sub(1) == 1)
+        mExportDone.signal();
+}
+
+bool SimpleLooperAudioProcessor::writeExportFile(const ExportFile& file, juce::AudioBuffer<float>& scratch)
+{
+    auto writer = StemExport::createWriter(file.file, mExportOptions.format, mExportSampleRate, scratch.getNumChannels());
+    bool ok = writer != nullptr;
+
+    // Block by block: a file never needs more memory than the scratch buffer
+    for (int start = 0; ok && start < mExportLength; start += EXPORT_BLOCK_SAMPLES)
+    {
+        const int length = juce::jmin(EXPORT_BLOCK_SAMPLES, mExportLength - start);
+        scratch.clear(0, length);
+
+        for (int i = 0; i < mNumTracks; ++i)
+        {
+            const auto& source = mExportSources[(size_t)i];
+            if (!source.used || (file.track >= 0 && file.track != i)) continue;
+
+            // Sample 0 is global sample 0, as in a bounce
+            juce::int64 readStart = ((-source.startGlobal % source.length) + source.length + start) % source.length;
+            renderSource(source, scratch.getArrayOfWritePointers(), scratch.getNumChannels(), 0, length, static_cast<int>(readStart));
+        }
+
+        ok = !mStemExporter.threadShouldExit() && writer->writeFromAudioSampleBuffer(scratch, 0, length);
+        mExportFramesDone.fetch_add(length);
+    }
+
+    writer.reset(); // flushes and closes the file
+    if (!ok)
+    {
+        file.file.deleteFile(); // no partial stems
+        TRACE(StemExportFailed, file.track);
+    }
+    return ok;
+}
+
+void SimpleLooperAudioProcessor::calculateBpm(int lengthSamples, double sampleRate)
+{
+    if (lengthSamples <= 0 || sampleRate <= 0) return;
+    
+    double durationSecs = (double)lengthSamples / sampleRate;
+    
+    // Calculate raw BPM based on the assumption that the loop is 1 Beat
+    double rawBpm = 60.0 / durationSecs; 
+    
+    // Sanity Check & Adjustment (Target 70-140 BPM)
+    // If BPM is too low (long loop), assume it contains multiple beats/bars
+    while (rawBpm < 70.0)
+    {
+        rawBpm *= 2.0;
+    }
+    // If BPM is too high (short loop), assume it's a fraction of a beat (though less common for loopers)
+    while (rawBpm > 140.0)
+    {
+        rawBpm /= 2.0;
+    }
+    
+    mBpm.store(rawBpm); // traced with FirstLoopCompleted
+}
+
+void SimpleLooperAudioProcessor::resetAll()
+{
+    pushCommand(LooperCommand::Type::Reset);
+}
+
+int SimpleLooperAudioProcessor::TrackMaintenance::useTimeSlice()
+{
+    bool didWork = false;
+    for (auto& t : owner.mTracks)
+        didWork |= t->runBackgroundTasks();
+
+    owner.reclaimSessionBuffers();
+    return didWork ? 1 : 20;
+}
+
+void SimpleLooperAudioProcessor::resetAllInternal(juce::uint32 generation)
+{
+    TRACE(ResetAll, -1);
+    if (!isNewerGeneration(generation, mResetGeneration.load()))
+        generation = ++mResetsRequested; // unnumbered (MIDI), or overtaken by a newer one
+    mResetGeneration.store(generation);
+    for (int i = 0; i < mTracks.size(); ++i)
+    {
+        TRACE(TrackReset, i);
+        mTracks[i]->clear();
+    }
+        
+    mIsFirstLoop.store(true);
+    mPrimaryLoopLengthSamples.store(0);
+    mGlobalPlaybackPosition = 0;
+    mGlobalTotalSamples.store(0);
+    mBpm.store(0.0);
+
+    // A restored session's transport: the tracks join it as they are installed
+    if (generation == 0 || mRestoreGeneration.load() != generation)
+        return;
+
+    const auto transport = mRestoreTransport;
+    if (mRestoreGeneration.load() != generation)
+        return; // rewritten meanwhile by a newer restore, whose own reset follows
+
+    mBpm.store(transport.bpm);
+    mPrimaryLoopLengthSamples.store(transport.primaryLoopLength);
+    mIsFirstLoop.store(transport.isFirstLoop || transport.primaryLoopLength <= 0);
+    mGlobalPlaybackPosition = transport.primaryLoopLength > 0
+                            ? transport.globalPlaybackPosition % transport.primaryLoopLength : 0;
+    mGlobalTotalSamples.store(transport.globalTotalSamples);
+}
+
+//==============================================================================
+// Parameter Layout for DAW integration (Ableton Configure, MIDI mapping)
+
+juce::AudioProcessorValueTreeState::ParameterLayout SimpleLooperAudioProcessor::createParameterLayout(int numTracks)
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    const auto outputNames = getOutputNames(numTracks);
+
+    for (int i = 0; i < numTracks; ++i)
+    {
+        auto idx = juce::String(i);
+        auto name = "Track " + juce::String(i + 1);
 
-    // Reset All trigger (any edge)
-    bool rsVal = mParamReset->load() >= 0.5f;
-    if (rsVal != mPrevReset)
-        resetAllInternal();
-    mPrevReset = rsVal;
-}
+        layout.add(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID("vol_" + idx, 1), name + " Volume",
+            juce::NormalisableRange<float>(0.0f, 1.0f, 0.01f), 0.8f));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("rec_" + idx, 1), name + " Rec/Play", false));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("mute_" + idx, 1), name + " Mute", false));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("stop_" + idx, 1), name + " Stop", false));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("solo_" + idx, 1), name + " Solo", false));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("afterloop_" + idx, 1), name + " After Loop", false));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("clear_" + idx, 1), name + " Clear", false));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("undo_" + idx, 1), name + " Undo", false));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("redo_" + idx, 1), name + " Redo", false));
+        layout.add(std::make_unique<juce::AudioParameterInt>(
+            juce::ParameterID("undo_depth_" + idx, 1), name + " Undo Depth", 1, LoopHistory::maxLevels, 4));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("mul_" + idx, 1), name + " Multiply", false));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("div_" + idx, 1), name + " Divide", false));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(
+            juce::ParameterID("out_select_" + idx, 1), name + " Output", outputNames, i + 1));
+        layout.add(std::make_unique<juce::AudioParameterBool>(
+            juce::ParameterID("resample_" + idx, 1), name + " FX Replace", false));
+    }
 
-//==============================================================================
-// Deferred operations - run inside processBlock after tracks have been processed
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID("bounce_back", 1), "Bounce Back", false));
+    layout.add(std::make_unique<juce::AudioParameterBool>(
+        juce::ParameterID("reset_all", 1), "Reset All", false));
+    layout.add(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID("midi_sync_channel", 1), "MIDI Sync Channel",
+        juce::StringArray{
+            "CH 1", "CH 2", "CH 3", "CH 4", "CH 5", "CH 6", "CH 7", "CH 8",
+            "CH 9", "CH 10", "CH 11", "CH 12", "CH 13", "CH 14", "CH 15", "CH 16"
+        },
+        0));
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+        juce::ParameterID("undo_memory_mb", 1), "Undo Memory (MB)", 16, 2048, 512));
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+        juce::ParameterID("overdub_layers", 1), "Overdub Layers", 1, LoopImage::maxLayers, 4));
+    layout.add(std::make_unique<juce::AudioParameterInt>(
+        juce::ParameterID("render_threads", 1), "Render Threads", 0, RenderWorkerPool::maxWorkers, 0));
 
-void SimpleLooperAudioProcessor::executePendingOperations()
+    return layout;
+}
+
+void SimpleLooperAudioProcessor::TrackControls::resize(int numTracks)
 {
-    int pendingAL = mPendingAfterLoop.load();
-    bool pendingBn = mPendingBounce.load();
+    for (auto* params : { &volumeParam, &muteParam, &soloParam, &undoDepthParam, &outSelectParam })
+        params->assign((size_t)numTracks, nullptr);
+
+    volume.assign((size_t)numTracks, 0.0f);
+    undoDepth.assign((size_t)numTracks, 0);
+    muted.assign((size_t)numTracks, 0);
+    soloed.assign((size_t)numTracks, 0);
+    playing.assign((size_t)numTracks, 0);
+}
 
-    if (!pendingBn && pendingAL < 0)
-        return;
+void SimpleLooperAudioProcessor::handleParameterChanges()
+{
+    const bool pushAll = !mControlsSynced;
+    mControlsSynced = true;
 
-    // No suspendProcessing: bounce uses progressive replace,
-    // afterloop copies are small enough to run in one block.
+    // Shared settings: undo memory cap (split equally between tracks), overdub layers
+    const double bytesPerPage = (double)sizeof(AudioPage::data);
+    int undoBudgetPages = (int)(mParamUndoMemory->load() * 1024.0 * 1024.0 / bytesPerPage) / mNumTracks;
+    int maxLayers = juce::roundToInt(mParamOverdubLayers->load());
 
-    if (pendingBn)
+    if (pushAll || undoBudgetPages != mUndoBudgetPages || maxLayers != mMaxLayers)
     {
-        mPendingBounce.store(false);
-        performBounceBack();
+        mUndoBudgetPages = undoBudgetPages;
+        mMaxLayers = maxLayers;
+        for (auto& track : mTracks)
+        {
+            track->setUndoBudgetPages(undoBudgetPages);
+            track->setMaxLayers(maxLayers);
+        }
     }
 
-    if (pendingAL >= 0)
+    // Per-track controls: one pass over each parameter array, tracks touched only on change
+    auto& c = mControls;
+    bool anySolo = false;
+
+    for (int i = 0; i < mNumTracks; ++i)
     {
-        mPendingAfterLoop.store(-1);
-        performCaptureAfterLoop(pendingAL);
+        const auto t = (size_t)i;
+
+        // Volume (continuous, driven by SliderAttachment)
+        float volVal = c.volumeParam[t]->load();
+        if (pushAll || volVal != c.volume[t])
+        {
+            c.volume[t] = volVal;
+            mTracks[t]->setVolume(volVal);
+        }
+
+        // Mute / Solo (direct sync, driven by ButtonAttachment toggles)
+        char muVal = c.muteParam[t]->load() >= 0.5f;
+        if (pushAll || muVal != c.muted[t])
+        {
+            c.muted[t] = muVal;
+            mTracks[t]->setMuted(muVal != 0);
+        }
+
+        char soVal = c.soloParam[t]->load() >= 0.5f;
+        if (pushAll || soVal != c.soloed[t])
+        {
+            c.soloed[t] = soVal;
+            mTracks[t]->setSolo(soVal != 0);
+        }
+        anySolo |= soVal != 0;
+
+        // Undo history size
+        int depth = juce::roundToInt(c.undoDepthParam[t]->load());
+        if (pushAll || depth != c.undoDepth[t])
+        {
+            c.undoDepth[t] = depth;
+            mTracks[t]->setUndoDepth(depth);
+        }
     }
+
+    mAnySolo = anySolo;
+
+    mRenderWorkers.setNumActiveWorkers(juce::roundToInt(mParamRenderThreads->load()));
 }
 
 //==============================================================================
-// Bounce Back: mix all tracks into track 1, clear others
+// Command queue
 
-void SimpleLooperAudioProcessor::bounceBack()
+void SimpleLooperAudioProcessor::addCommandTrigger(const juce::String& paramID, LooperCommand::Type type, int trackIndex)
 {
-    LOG_SEP("BOUNCE BACK");
-    performBounceBack();
+    mCommandTriggers.push_back(std::make_unique<CommandTrigger>(*this, paramID, type, trackIndex));
+    apvts.addParameterListener(paramID, mCommandTriggers.back().get());
 }
 
-void SimpleLooperAudioProcessor::performBounceBack()
+void SimpleLooperAudioProcessor::removeCommandTriggers(juce::ValueTree& parameters) const
 {
-    int masterLen = mPrimaryLoopLengthSamples.load();
-    if (masterLen <= 0) return;
-
-    // Find the longest loop across all tracks
-    int bounceLen = masterLen;
-    for (auto& t : mTracks)
+    // replaceState() keeps the current value of a parameter missing from the tree
+    for (int i = parameters.getNumChildren(); --i >= 0;)
     {
-        if (t->hasLoop())
-            bounceLen = juce::jmax(bounceLen, t->getLoopLengthSamples());
+        const auto id = parameters.getChild(i).getProperty("id").toString();
+        for (auto& trigger : mCommandTriggers)
+            if (trigger->paramID == id)
+            {
+                parameters.removeChild(i, nullptr);
+                break;
+            }
     }
+}
 
-    if (bounceLen > mWorkBuffer.getNumSamples()) return;
+juce::int64 SimpleLooperAudioProcessor::getCommandTime() const
+{
+    // (the sample clock itself advances sub-block by sub-block during the block)
+    const juce::int64 nextBlock = mBlockStartSample.load() + mLastBlockSize.load();
 
-    mWorkBuffer.clear(0, bounceLen);
+    // Host automation applied just before processBlock (audio thread): start of the coming block
+    if (juce::Thread::getCurrentThreadId() == mAudioThreadId.load())
+        return nextBlock;
 
-    // Mix all tracks into work buffer using block-based operations
-    for (auto& t : mTracks)
+    // Elapsed time since the current block started, mapped onto the next block
+    double elapsedMs = juce::Time::getMillisecondCounterHiRes() - mBlockStartMs.load();
+    auto offset = (juce::int64)(juce::jmax(0.0, elapsedMs) * getSampleRate() / 1000.0);
+
+    // Late or stalled callbacks: never more than one block ahead
+    return nextBlock + juce::jmin(offset, (juce::int64)mLastBlockSize.load());
+}
+
+bool SimpleLooperAudioProcessor::pushCommand(LooperCommand::Type type, int trackIndex)
+{
+    return pushCommand(type, trackIndex, getCommandTime());
+}
+
+bool SimpleLooperAudioProcessor::pushCommand(LooperCommand::Type type, int trackIndex, juce::int64 sampleTime)
+{
+    LooperCommand command { type, trackIndex, sampleTime };
+    if (type == LooperCommand::Type::Reset)
+        command.generation = ++mResetsRequested;
+    return pushCommand(command);
+}
+
+bool SimpleLooperAudioProcessor::pushCommand(const LooperCommand& command)
+{
+    if (!mCommandQueue.push(command))
     {
-        if (!t->hasLoop()) continue;
+        TRACE(CommandDropped, command.track, (int)command.type);
+        return false;
+    }
+    return true;
+}
 
-        auto& lb = t->getLoopBuffer();
-        int trackLen = t->getLoopLengthSamples();
-        juce::int64 startGlobal = t->getRecordingStartGlobalSample();
+bool SimpleLooperAudioProcessor::scheduleCommand(const LooperCommand& command)
+{
+    if (mNumScheduled == (int)mScheduled.size())
+        return false;
 
-        int numCh = juce::jmin(2, lb.getNumChannels());
+    // Keep them sorted by time; equal times stay in arrival order
+    int i = mNumScheduled++;
+    for (; i > 0 && mScheduled[(size_t)i - 1].sampleTime > command.sampleTime; --i)
+        mScheduled[(size_t)i] = mScheduled[(size_t)i - 1];
+    mScheduled[(size_t)i] = command;
+    return true;
+}
 
-        // Compute where in the track's loop sample 0 of the bounce corresponds to
-        juce::int64 elapsedAtZero = -startGlobal;
-        int readStart = static_cast<int>(((elapsedAtZero % trackLen) + trackLen) % trackLen);
+void SimpleLooperAudioProcessor::collectCommands()
+{
+    // When the schedule is full the rest waits in the queue for the next block
+    LooperCommand command;
+    while (mNumScheduled < (int)mScheduled.size() && mCommandQueue.pop(command))
+        scheduleCommand(command);
+}
 
-        // Block-copy with wrapping
-        for (int ch = 0; ch < numCh; ++ch)
-        {
-            int remaining = bounceLen;
-            int dstPos = 0;
-            int srcPos = readStart;
+void SimpleLooperAudioProcessor::applyCommand(const LooperCommand& command)
+{
+    using Cmd = LooperCommand::Type;
+
+    if (command.type == Cmd::Bounce)
+    {
+        if (!mPendingBounce.load())
+            mBounceRequestMs = juce::Time::getMillisecondCounterHiRes();
+        mPendingBounce.store(true);
+        return;
+    }
+    if (command.type == Cmd::Reset)
+    {
+        resetAllInternal(command.generation);
+        return;
+    }
 
-            while (remaining > 0)
+    if (command.track < 0 || command.track >= (int)mTracks.size())
+        return;
+
+    auto& track = *mTracks[(size_t)command.track];
+
+    switch (command.type)
+    {
+        case Cmd::RecPlay:
+            // State cycle
+            switch (track.getState())
             {
-                int toLoopEnd = trackLen - srcPos;
-                int chunk = juce::jmin(remaining, toLoopEnd);
-                mWorkBuffer.addFrom(ch, dstPos, lb, ch, srcPos, chunk);
-                dstPos += chunk;
-                srcPos += chunk;
-                if (srcPos >= trackLen) srcPos = 0;
-                remaining -= chunk;
+                case LoopTrack::State::Empty:       track.setRecording(); break;
+                case LoopTrack::State::Recording:   track.setPlaying(); break;
+                case LoopTrack::State::Playing:     track.setOverdubbing(); break;
+                case LoopTrack::State::Overdubbing: track.setPlaying(); break;
+                case LoopTrack::State::Stopped:     track.setPlaying(); break;
             }
+            break;
+
+        case Cmd::Stop:      track.stop(); break;
+        case Cmd::AfterLoop: mPendingAfterLoop.store(command.track); break;
+        case Cmd::Clear:     track.clear(); break;
+        case Cmd::Undo:      track.performUndo(); break;
+        case Cmd::Redo:      track.performRedo(); break;
+        case Cmd::FxReplace: track.toggleFxReplace(); break;
+
+        case Cmd::Multiply:
+            if (track.getState() == LoopTrack::State::Empty)
+                track.setTargetMultiplier(juce::jmin(64.0f, track.getTargetMultiplier() * 2.0f));
+            else
+                track.multiplyLoop();
+            break;
+
+        case Cmd::Divide:
+            if (track.getState() == LoopTrack::State::Empty)
+                track.setTargetMultiplier(juce::jmax(1.0f / 64.0f, track.getTargetMultiplier() / 2.0f));
+            else
+                track.divideLoop();
+            break;
+
+        default:
+            break;
+    }
+}
+
+//==============================================================================
+// Bounce / After Loop jobs
+// The audio thread starts a job (snapshots + parameters), the worker renders it
+// into a free work buffer, and the audio thread installs the result as a
+// progressive replace. The audio thread never waits for the worker.
+
+void SimpleLooperAudioProcessor::executePendingOperations()
+{
+    // 0. Session: loops decoded by the loader, snapshots for the encoder (O(pages)
+    // per track, no audio copied)
+    installSessionTracks();
+
+    if (mEncoderSnapshot.load() == SnapshotRequested)
+    {
+        for (int i = 0; i < mNumTracks; ++i)
+            snapshotTrack(i, mEncoderSources[(size_t)i]);
+        mEncoderSnapshot.store(SnapshotReady);
+    }
+
+    if (mExportSnapshot.load() == SnapshotRequested)
+        takeExportSnapshot();
+
+    if (mSaveSnapshot.load() == SnapshotRequested)
+        takeSaveSnapshot();
+
+    // 1. Hand a finished job back
+    if (mJob.status.load() == LoopJob::Done)
+        installJob();
+
+    if (mJob.status.load() != LoopJob::Idle)
+        return;
+
+    // 2. Start the next request (one job at a time; a request that can't start yet stays pending)
+    if (mPendingBounce.load())
+    {
+        if (startBounce())
+            mPendingBounce.store(false);
+        return;
+    }
+
+    int pendingAL = mPendingAfterLoop.load();
+    if (pendingAL >= 0 && startCaptureAfterLoop(pendingAL))
+        mPendingAfterLoop.store(-1);
+}
+
+void SimpleLooperAudioProcessor::JobWorker::run()
+{
+    // Woken by the audio thread when it starts a job. A wake that lands between the
+    // check and the wait is only caught by the timeout (the waker never locks).
+    while (!threadShouldExit())
+    {
+        if (owner.mJob.status.load() == LoopJob::Pending)
+        {
+            owner.runJob();
+            continue;
         }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait_for(lock, std::chrono::milliseconds(50), [this] { return woken.exchange(false) || threadShouldExit(); });
     }
+}
+
+void SimpleLooperAudioProcessor::JobWorker::wake()
+{
+    woken.store(true);
+    condition.notify_one();
+}
 
-    // Apply crossfade to avoid click at loop boundary
-    LoopTrack::applyCrossfade(mWorkBuffer, bounceLen, CROSSFADE_SAMPLES);
+void SimpleLooperAudioProcessor::snapshotTrack(int trackIndex, LoopJob::Source& source)
+{
+    auto& track = *mTracks[(size_t)trackIndex];
 
-    // Start progressive replacement on track 1 (playhead-first, zero glitch)
-    mTracks[0]->beginProgressiveReplace(&mWorkBuffer, bounceLen, 0, 0);
+    source.used = track.hasLoop();
+    if (!source.used) return;
 
-    // Clear all other tracks immediately (they go silent)
-    for (size_t i = 1; i < mTracks.size(); ++i)
-        mTracks[i]->clear();
+    source.length         = track.getLoopLengthSamples();
+    source.startGlobal    = track.getRecordingStartGlobalSample();
+    source.replaceSource  = track.getReplaceSource();
+    if (source.replaceSource != nullptr)
+        StagingBufferPool::retain(source.replaceSource); // stays readable if the track lets it go
+    else
+        source.image.shareFrom(track.getLoopImage()); // copy-on-write: O(pages), no audio copied
+}
 
-    mPrimaryLoopLengthSamples.store(bounceLen);
-    LOG("Bounce started progressive | bounceLen=" + juce::String(bounceLen));
+void SimpleLooperAudioProcessor::bounceBack()
+{
+    pushCommand(LooperCommand::Type::Bounce);
 }
 
-//==============================================================================
-// After Loop: capture last N bars of audio from retrospective buffer into a specific track
+bool SimpleLooperAudioProcessor::startBounce()
+{
+    int masterLen = mPrimaryLoopLengthSamples.load();
+    if (masterLen <= 0) return true;
+
+    // Find the longest loop across all tracks
+    int bounceLen = masterLen;
+    for (auto& t : mTracks)
+    {
+        if (t->hasLoop())
+            bounceLen = juce::jmax(bounceLen, t->getLoopLengthSamples());
+    }
+
+    if (bounceLen > mRetroBufferSize) return true;
+
+    auto* output = mStagingBuffers.acquire();
+    if (output == nullptr) return false;
+
+    for (int i = 0; i < (int)mTracks.size(); ++i)
+        snapshotTrack(i, mJob.sources[(size_t)i]);
+
+    mJob.kind            = LoopJob::Kind::Bounce;
+    mJob.target          = 0;
+    mJob.output          = output;
+    mJob.length          = bounceLen;
+    mJob.startOffset     = 0;
+    mJob.startGlobal     = 0;
+    mJob.resetGeneration = mResetGeneration;
+    mJob.status.store(LoopJob::Pending);
+    mJobWorker.wake();
+
+    TRACE(BounceStarted, -1, bounceLen);
+    return true;
+}
 
 void SimpleLooperAudioProcessor::captureAfterLoop(int trackIndex)
 {
-    LOG_SEP("AFTER LOOP (Track " + juce::String(trackIndex) + ")");
-    performCaptureAfterLoop(trackIndex);
+    pushCommand(LooperCommand::Type::AfterLoop, trackIndex);
 }
 
-void SimpleLooperAudioProcessor::performCaptureAfterLoop(int trackIndex)
+bool SimpleLooperAudioProcessor::startCaptureAfterLoop(int trackIndex)
 {
     int masterLen = mPrimaryLoopLengthSamples.load();
-    if (masterLen <= 0 || mRetroBufferSize <= 0) return;
-    if (trackIndex < 0 || trackIndex >= (int)mTracks.size()) return;
+    if (masterLen <= 0 || mRetroBufferSize <= 0) return true;
+    if (trackIndex < 0 || trackIndex >= (int)mTracks.size()) return true;
 
     // Determine capture length based on targetMultiplier
-    float mult = mTracks[trackIndex]->getTargetMultiplier();
+    auto& track = *mTracks[(size_t)trackIndex];
+    float mult = track.getTargetMultiplier();
     if (mult < 1.0f / 64.0f) mult = 1.0f / 64.0f;
     if (mult > 64.0f) mult = 64.0f;
     int captureLen = static_cast<int>((float)masterLen * mult);
 
-    if (captureLen <= 0) return;
-    if (captureLen > mRetroBufferSize) return;
-    if (captureLen > mWorkBuffer.getNumSamples()) return;
+    // The worker reads the retrospective buffer while the audio thread keeps writing
+    // it: leave a second of headroom so the range being read is never overwritten.
+    int maxCapture = mRetroBufferSize - static_cast<int>(getSampleRate());
+    if (captureLen <= 0 || captureLen > maxCapture) return true;
+
+    const bool overdub = track.hasLoop();
+    int resultLen = overdub ? track.getLoopLengthSamples() : captureLen;
+    if (resultLen > mRetroBufferSize) return true;
+
+    auto* output = mStagingBuffers.acquire();
+    if (output == nullptr) return false;
+
+    juce::int64 captureStartGlobal = juce::jmax((juce::int64)0, mGlobalTotalSamples.load() - (juce::int64)captureLen);
+
+    for (auto& source : mJob.sources)
+        source.used = false;
+    snapshotTrack(trackIndex, mJob.sources[(size_t)trackIndex]);
+
+    mJob.kind               = LoopJob::Kind::AfterLoop;
+    mJob.target             = trackIndex;
+    mJob.output             = output;
+    mJob.length             = resultLen;
+    mJob.retroStart         = (mRetroWritePos - captureLen + mRetroBufferSize) % mRetroBufferSize;
+    mJob.captureLength      = captureLen;
+    mJob.captureStartGlobal = captureStartGlobal;
+    mJob.resetGeneration    = mResetGeneration;
+    mJob.targetGeneration   = track.getContentGeneration();
+
+    if (overdub)
+    {
+        // Track has a loop: the capture is mixed on top, keeping the track's alignment
+        mJob.startOffset = track.getRecordingStartOffset();
+        mJob.startGlobal = track.getRecordingStartGlobalSample();
+    }
+    else
+    {
+        // Track is empty: a fresh loop from the captured audio
+        mJob.startOffset = static_cast<int>(captureStartGlobal % masterLen);
+        mJob.startGlobal = captureStartGlobal;
+    }
+
+    mJob.status.store(LoopJob::Pending);
+    mJobWorker.wake();
+
+    TRACE(AfterLoopStarted, trackIndex, captureLen, mult, overdub ? 1 : 0);
+    return true;
+}
+
+void SimpleLooperAudioProcessor::runJob()
+{
+    // The job holds the only reference to its output: safe to grow it here
+    mStagingBuffers.reserve(*mJob.output, mJob.length);
+    auto& dest = mJob.output->audio;
+    dest.clear(0, mJob.length);
+
+    if (mJob.kind == LoopJob::Kind::Bounce)
+    {
+        const double renderStart = juce::Time::getMillisecondCounterHiRes();
+
+        // Mix all tracks, range by range, on this thread and the mixdown threads
+        // (the channel pointers are taken here: AudioBuffer's own accessors are not for concurrent writers)
+        mMixdown.channels    = dest.getArrayOfWritePointers();
+        mMixdown.numChannels = dest.getNumChannels();
+        mMixdown.numRanges   = (mJob.length + MIXDOWN_RANGE_SAMPLES - 1) / MIXDOWN_RANGE_SAMPLES;
+        const int numHelpers = juce::jmin(mMixdownThreads.getNumThreads(), mMixdown.numRanges - 1);
+        mMixdown.nextRange.store(0);
+        mMixdown.participants.store(numHelpers + 1);
+        mMixdown.done.reset();
+
+        for (int i = 0; i < numHelpers; ++i)
+            mMixdownThreads.addJob([this] { mixdownRanges(); });
+        mixdownRanges();
+        mMixdown.done.wait();
+
+        // Apply crossfade to avoid click at loop boundary (once every range is in)
+        LoopTrack::applyCrossfade(dest, mJob.length, CROSSFADE_SAMPLES);
+
+        mLastBounceRenderMs.store(juce::Time::getMillisecondCounterHiRes() - renderStart);
+    }
+    else
+    {
+        // Existing loop (from its start) + the capture where it lands in that loop
+        auto& source = mJob.sources[(size_t)mJob.target];
+        int captureStart = 0;
+        if (source.used)
+        {
+            renderSource(source, dest.getArrayOfWritePointers(), dest.getNumChannels(), 0, mJob.length, 0);
+            juce::int64 elapsed = juce::jmax((juce::int64)0, mJob.captureStartGlobal - source.startGlobal);
+            captureStart = static_cast<int>(elapsed % mJob.length);
+        }
+        addCapture(dest, mJob.length, captureStart);
+    }
+
+    mJob.status.store(LoopJob::Done);
+}
+
+void SimpleLooperAudioProcessor::mixdownRanges()
+{
+
+    for (int range = mMixdown.nextRange.fetch_add(1); range < mMixdown.numRanges;
+         range = mMixdown.nextRange.fetch_add(1))
+    {
+        const int start  = range * MIXDOWN_RANGE_SAMPLES;
+        const int length = juce::jmin(MIXDOWN_RANGE_SAMPLES, mJob.length - start);
+
+        // Every track over this range (stays in cache); sample 0 of the bounce is global sample 0
+        for (auto& source : mJob.sources)
+        {
+            if (!source.used) continue;
+            juce::int64 readStart = ((-source.startGlobal % source.length) + source.length + start) % source.length;
+            renderSource(source, mMixdown.channels, mMixdown.numChannels, start, length, static_cast<int>(readStart));
+        }
+    }
+
+    if (mMixdown.participants.fetch_sub(1) == 1)
+        mMixdown.done.signal();
+}
+
+void SimpleLooperAudioProcessor::renderSource(const LoopJob::Source& source, float* const* dest, int numDestChannels,
+                                              int destStart, int length, int readStart)
+{
+    const int trackLen = source.length;
+    const int numCh = juce::jmin(numDestChannels, source.getNumChannels());
+
+    // Block-copy with wrapping
+    for (int ch = 0; ch < numCh; ++ch)
+    {
+        int remaining = length;
+        int dstPos = destStart;
+        int srcPos = readStart;
+
+        while (remaining > 0)
+        {
+            int chunk = juce::jmin(remaining, trackLen - srcPos);
+            if (source.replaceSource != nullptr)
+                juce::FloatVectorOperations::add(dest[ch] + dstPos, source.replaceSource->audio.getReadPointer(ch, srcPos), chunk);
+            else
+                source.image.addTo(ch, srcPos, dest[ch] + dstPos, chunk);
+
+            dstPos += chunk;
+            srcPos += chunk;
+            if (srcPos >= trackLen) srcPos = 0;
+            remaining -= chunk;
+        }
+    }
+}
 
-    // Read last captureLen samples from the circular retrospective buffer
-    int retroReadStart = (mRetroWritePos - captureLen + mRetroBufferSize) % mRetroBufferSize;
+void SimpleLooperAudioProcessor::addCapture(juce::AudioBuffer<float>& dest, int destLength, int destStart)
+{
+    const int captureLen = mJob.captureLength;
+    const int retroCh = juce::jmin(dest.getNumChannels(), mRetrospectiveBuffer.getNumChannels());
 
-    mWorkBuffer.clear(0, captureLen);
+    auto retroIndex = [&](int k) { return (mJob.retroStart + k) % mRetroBufferSize; };
+    auto destIndex  = [&](int k) { return (destStart + k) % destLength; };
 
-    int retroCh = juce::jmin(2, mRetrospectiveBuffer.getNumChannels());
     for (int ch = 0; ch < retroCh; ++ch)
     {
-        int toEnd = mRetroBufferSize - retroReadStart;
-        if (captureLen <= toEnd)
+        // 1. Raw capture, wrapping in both the circular buffer and the loop
+        for (int k = 0; k < captureLen;)
         {
-            mWorkBuffer.copyFrom(ch, 0, mRetrospectiveBuffer, ch, retroReadStart, captureLen);
+            int chunk = juce::jmin(captureLen - k,
+                                   mRetroBufferSize - retroIndex(k),
+                                   destLength - destIndex(k));
+            dest.addFrom(ch, destIndex(k), mRetrospectiveBuffer, ch, retroIndex(k), chunk);
+            k += chunk;
         }
-        else
+
+        // 2. Same boundary crossfade as LoopTrack::applyCrossfade on the captured audio
+        int fadeSamples = juce::jmin(CROSSFADE_SAMPLES, captureLen / 2);
+        auto* retro = mRetrospectiveBuffer.getReadPointer(ch);
+        auto* out   = dest.getWritePointer(ch);
+        for (int i = 0; i < fadeSamples; ++i)
         {
-            mWorkBuffer.copyFrom(ch, 0, mRetrospectiveBuffer, ch, retroReadStart, toEnd);
-            mWorkBuffer.copyFrom(ch, toEnd, mRetrospectiveBuffer, ch, 0, captureLen - toEnd);
+            float fadeIn  = (float)i / (float)fadeSamples;
+            float fadeOut = 1.0f - fadeIn;
+
+            int tail = captureLen - fadeSamples + i;
+            float headSample = retro[retroIndex(i)];
+            float tailSample = retro[retroIndex(tail)];
+            float blended    = headSample * fadeIn + tailSample * fadeOut;
+
+            out[destIndex(i)]    += blended - headSample;
+            out[destIndex(tail)] += blended - tailSample;
         }
     }
+}
 
-    juce::int64 globalNow = mGlobalTotalSamples.load();
-    juce::int64 captureStartGlobal = globalNow - (juce::int64)captureLen;
-    if (captureStartGlobal < 0) captureStartGlobal = 0;
+void SimpleLooperAudioProcessor::installJob()
+{
+    auto* result = mJob.output;
 
-    // Apply crossfade to avoid click at loop boundary
-    LoopTrack::applyCrossfade(mWorkBuffer, captureLen, CROSSFADE_SAMPLES);
+    // A reset since the job started makes its result meaningless
+    if (mJob.resetGeneration != mResetGeneration)
+    {
+        releaseJob();
+        return;
+    }
 
-    if (!mTracks[trackIndex]->hasLoop())
+    if (mJob.kind == LoopJob::Kind::Bounce)
     {
-        // Track is empty: create a fresh loop from captured audio
-        int alignedOffset = static_cast<int>(captureStartGlobal % masterLen);
-        mTracks[trackIndex]->setLoopFromMix(mWorkBuffer, captureLen, alignedOffset, captureStartGlobal);
-        LOG("After Loop (new): " + juce::String(captureLen) + " samples (mult=" + juce::String(mult) +
-            ") into track " + juce::String(trackIndex) + " globalStart=" + juce::String(captureStartGlobal));
+        // Progressive replacement on track 1 (playhead-first, zero glitch)
+        mTracks[0]->beginProgressiveReplace(result, mJob.length, 0, 0);
+
+        // Clear all other tracks (they go silent)
+        for (size_t i = 1; i < mTracks.size(); ++i)
+            mTracks[i]->clear();
+
+        mPrimaryLoopLengthSamples.store(mJob.length);
+        mLastBounceLatencyMs.store(juce::Time::getMillisecondCounterHiRes() - mBounceRequestMs);
+        TRACE(BounceInstalled, -1, mJob.length, mLastBounceLatencyMs.load());
     }
     else
     {
-        // Track has a loop: overdub captured audio on top
-        mTracks[trackIndex]->overdubFromBuffer(mWorkBuffer, captureLen, captureStartGlobal);
-        LOG("After Loop (overdub): " + juce::String(captureLen) + " samples (mult=" + juce::String(mult) +
-            ") into track " + juce::String(trackIndex));
+        // The target must still be what the job was computed from: an overdub (or any
+        // other edit) since the snapshot would be lost under the result
+        auto& track = *mTracks[(size_t)mJob.target];
+        bool wasEmpty = !mJob.sources[(size_t)mJob.target].used;
+        bool matches  = track.getContentGeneration() == mJob.targetGeneration
+                     && (wasEmpty ? (track.getState() == LoopTrack::State::Empty)
+                                  : (track.hasLoop() && track.getLoopLengthSamples() == mJob.length));
+
+        if (matches)
+        {
+            track.beginProgressiveReplace(result, mJob.length, mJob.startOffset, mJob.startGlobal);
+            TRACE(AfterLoopInstalled, mJob.target, mJob.length);
+        }
+        else
+        {
+            TRACE(AfterLoopDropped, mJob.target);
+        }
     }
+
+    releaseJob();
+}
+
+void SimpleLooperAudioProcessor::releaseJob()
+{
+    // The track that installed the result keeps its own reference
+    StagingBufferPool::release(mJob.output);
+    mJob.output = nullptr;
+
+    for (auto& source : mJob.sources)
+        releaseSource(source, PagePool::Caller::Audio);
+    mJob.status.store(LoopJob::Idle);
+}
+
+void SimpleLooperAudioProcessor::releaseSource(LoopJob::Source& source, PagePool::Caller caller)
+{
+    source.image.releaseAll(caller);
+    StagingBufferPool::release(source.replaceSource);
+    source.replaceSource = nullptr;
+    source.used = false;
 }
 
 //==============================================================================
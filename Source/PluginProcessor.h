@@ -9,8 +9,27 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <condition_variable>
+#include <list>
+#include <mutex>
 #include "LoopTrack.h"
+#include "PagePool.h"
+#include "LooperCommand.h"
+#include "MidiLearn.h"
+#include "StagingBuffer.h"
+#include "RenderWorkers.h"
 #include "DebugLogger.h"
+#include "DspProfiler.h"
+#include "SessionFormat.h"
+#include "SessionAudioCache.h"
+#include "StemExport.h"
+#include "AudioImport.h"
+
+// Tracks of the plugin build. Hosts need a fixed bus / parameter layout,
+// so the count is chosen once, when the processor is constructed.
+#ifndef SIMPLELOOPER_NUM_TRACKS
+ #define SIMPLELOOPER_NUM_TRACKS 6
+#endif
 
 //==============================================================================
 /**
@@ -18,10 +37,12 @@
 class SimpleLooperAudioProcessor  : public juce::AudioProcessor
 {
 public:
-    static constexpr int NUM_TRACKS = 6;
+    static constexpr int MAX_TRACKS = 64;
     std::atomic<bool> mIsRecording{ false };
     //==============================================================================
-    SimpleLooperAudioProcessor();
+    /** numTracks: 1 to MAX_TRACKS. Each track gets its FX return input, its output
+        pair and its parameters. */
+    explicit SimpleLooperAudioProcessor(int numTracks = SIMPLELOOPER_NUM_TRACKS);
     ~SimpleLooperAudioProcessor() override;
 
     //==============================================================================
@@ -59,12 +80,20 @@ public:
     
     // Public Accessor for UI - returns vector of pointers
     std::vector<std::unique_ptr<LoopTrack>>& getTracks() { return mTracks; }
+    int getNumTracks() const { return mNumTracks; }
+
+    /** Output bus names in out_select order: "Monitor 1/2", "Output 3/4", ... */
+    static juce::StringArray getOutputNames(int numTracks);
     
     // UI Accessors for State
     bool isFirstLoop() const { return mIsFirstLoop.load(); }
     double getBpm() const { return mBpm.load(); }
     int getPrimaryLoopLength() const { return mPrimaryLoopLengthSamples.load(); }
     int getGlobalPlaybackPosition() const { return mGlobalPlaybackPosition; }
+
+    /** Last bounce: command to installed result, and the mixdown alone, in ms (-1 = none yet). */
+    double getLastBounceLatencyMs() const { return mLastBounceLatencyMs.load(); }
+    double getLastBounceRenderMs() const { return mLastBounceRenderMs.load(); }
     juce::int64 getGlobalTotalSamples() const { return mGlobalTotalSamples.load(); }
 
     // Commands
@@ -72,12 +101,56 @@ public:
     void bounceBack();
     void captureAfterLoop(int trackIndex);
 
+    // Timestamped commands (any thread). processBlock applies each one at its exact sample.
+    // Returns false if the queue is full (command dropped).
+    bool pushCommand(LooperCommand::Type type, int trackIndex = 0);
+    bool pushCommand(LooperCommand::Type type, int trackIndex, juce::int64 sampleTime);
+
+    /** Sample-clock time for a command issued now. Off the audio thread this is the
+        current position inside the block being played, one block later: commands keep
+        their relative spacing, at a constant latency of one block. */
+    juce::int64 getCommandTime() const;
+
+    // Stem export (message thread): every track's loop, and optionally their mix, written
+    // to files in the background from a snapshot, while the looper keeps running.
+    // False if an export is still running.
+    enum class ExportState { Idle, Running, Done, Failed };
+    bool exportStems(const StemExport::Options& options);
+    ExportState getStemExportState() const { return (ExportState)mExportState.load(); }
+    /** 0..1: frames written over frames to write, every file together. */
+    float getStemExportProgress() const;
+
+    /** Message thread: replaces a track's loop with an audio file, decoded and converted
+        to the session's rate in the background (the session loader), then installed
+        like a loaded session's loop. alignToMaster: the length is rounded to whole
+        master loops and the loop starts in phase with the master; otherwise it starts
+        from its top when it lands. False before prepareToPlay, for a missing file or a
+        track canImportInto refuses; a file no format reads is dropped by the loader. */
+    bool importAudioFile(int trackIndex, const juce::File& file, bool alignToMaster);
+
+    /** Whether an import into the track can play in time: not while it records, other
+        tracks only once the master has a loop, and the master (which becomes the loop
+        the transport restarts from) only while no other track holds one. Checked again
+        when the decoded file lands. */
+    bool canImportInto(int trackIndex) const;
+
+    // MIDI note/CC -> command bindings (learned from the editor)
+    MidiLearn& getMidiLearn() { return mMidiLearn; }
+
+    // Per-stage load of processBlock (the editor's DSP load panel switches it on)
+    DspProfiler& getProfiler() { return mProfiler; }
+
     // APVTS for DAW parameter automation / MIDI mapping (Ableton Configure)
     juce::AudioProcessorValueTreeState apvts;
 
 private:
     //==============================================================================
     // --- LOOP TRACKS ---
+    const int mNumTracks;
+
+   #ifndef JucePlugin_PreferredChannelConfigurations
+    static BusesProperties createBusesProperties(int numTracks);
+   #endif
     
     // Sync State
     std::atomic<bool> mIsFirstLoop { true };
@@ -90,62 +163,431 @@ private:
 
     // Must use unique_ptr because LoopTrack contains atomics (non-copyable/non-movable)
     std::vector<std::unique_ptr<LoopTrack>> mTracks;
+
+    // --- Loop memory ---
+    // Shared page pool for every track's loop / undo / FX capture storage.
+    // The background thread grows the pool and zeroes released pages.
+    PagePool mPagePool;
+
+    // Per-track background work (layer merges, releasing cleared loops).
+    // Runs on mBackgroundThread, the pool's maintenance thread.
+    struct TrackMaintenance : public juce::TimeSliceClient
+    {
+        explicit TrackMaintenance(SimpleLooperAudioProcessor& p) : owner(p) {}
+        int useTimeSlice() override;
+        SimpleLooperAudioProcessor& owner;
+    };
+    TrackMaintenance mTrackMaintenance { *this };
+    juce::TimeSliceThread mBackgroundThread { "SimpleLooper Background" };
+    static constexpr double PAGE_RESERVE_SECONDS = 10.0;
     
     // Temporary buffer to hold input audio while tracks process and write to output
     juce::AudioBuffer<float> mInputCache;
     // Per-track FX return capture buffers (one per input bus)
-    juce::AudioBuffer<float> mFxReturnCache[NUM_TRACKS];
+    std::vector<juce::AudioBuffer<float>> mFxReturnCache;
 
     // --- Parameter system (DAW / MIDI mapping) ---
-    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout(int numTracks);
     void handleParameterChanges();
-    void resetAllInternal();
-    void performBounceBack();
-    void performCaptureAfterLoop(int trackIndex);
-
-    // Cached parameter pointers (valid for APVTS lifetime)
-    std::atomic<float>* mParamVol[NUM_TRACKS] = {};
-    std::atomic<float>* mParamRecPlay[NUM_TRACKS] = {};
-    std::atomic<float>* mParamStop[NUM_TRACKS] = {};
-    std::atomic<float>* mParamMute[NUM_TRACKS] = {};
-    std::atomic<float>* mParamSolo[NUM_TRACKS] = {};
-    std::atomic<float>* mParamAfterLoop[NUM_TRACKS] = {};
-    std::atomic<float>* mParamClear[NUM_TRACKS] = {};
-    std::atomic<float>* mParamUndo[NUM_TRACKS] = {};
-    std::atomic<float>* mParamMul[NUM_TRACKS] = {};
-    std::atomic<float>* mParamDiv[NUM_TRACKS] = {};
-    std::atomic<float>* mParamOutSelect[NUM_TRACKS] = {};
-    std::atomic<float>* mParamResample[NUM_TRACKS] = {};
-    std::atomic<float>* mParamBounce = nullptr;
-    std::atomic<float>* mParamReset = nullptr;
+    /** AUDIO: clears every track and the transport, and starts reset generation
+        generation (a fresh one if it is 0 or older than the current one). */
+    void resetAllInternal(juce::uint32 generation);
+
+    // Per-track controls as a structure of arrays: one contiguous array per field, so the
+    // per-block loops (parameter sync, solo scan, mixing) stream through dense memory
+    // instead of visiting every LoopTrack object.
+    struct TrackControls
+    {
+        void resize(int numTracks);
+
+        // Cached parameter pointers for continuous controls (valid for APVTS lifetime)
+        std::vector<std::atomic<float>*> volumeParam, muteParam, soloParam, undoDepthParam, outSelectParam;
+
+        // Values last pushed to the tracks (audio thread): tracks are only touched on change
+        std::vector<float> volume;
+        std::vector<int> undoDepth;
+        std::vector<char> muted, soloed;
+
+        // Track produced audio in the current segment (processSegment -> mixTracks)
+        std::vector<char> playing;
+    };
+    TrackControls mControls;
+    bool mAnySolo = false;
+    bool mControlsSynced = false; // false: push every value on the next block
+    int mUndoBudgetPages = -1;
+    int mMaxLayers = -1;
+
     std::atomic<float>* mParamMidiSyncChannel = nullptr;
+    std::atomic<float>* mParamUndoMemory = nullptr;
+    std::atomic<float>* mParamOverdubLayers = nullptr;
+    std::atomic<float>* mParamRenderThreads = nullptr;
+
+    // --- Command queue ---
+    // Trigger parameters (rec, stop, undo, ...) push a command on every change
+    // (any edge, compatible with ButtonAttachment toggles), so two presses
+    // inside one block are two commands.
+    struct CommandTrigger : public juce::AudioProcessorValueTreeState::Listener
+    {
+        CommandTrigger(SimpleLooperAudioProcessor& p, const juce::String& id, LooperCommand::Type t, int track)
+            : owner(p), paramID(id), type(t), trackIndex(track) {}
+        void parameterChanged(const juce::String&, float) override { owner.pushCommand(type, trackIndex); }
+
+        SimpleLooperAudioProcessor& owner;
+        juce::String paramID;
+        LooperCommand::Type type;
+        int trackIndex;
+    };
+    std::vector<std::unique_ptr<CommandTrigger>> mCommandTriggers;
+    void addCommandTrigger(const juce::String& paramID, LooperCommand::Type type, int trackIndex);
+    /** Drops the trigger parameters from a parameter tree: they are momentary presses,
+        not state, and restoring one would push its command. */
+    void removeCommandTriggers(juce::ValueTree& parameters) const;
+
+    LooperCommandQueue mCommandQueue;
+    // Commands taken from the queue, sorted by time, not yet due (audio thread only)
+    std::array<LooperCommand, 256> mScheduled;
+    int mNumScheduled = 0;
+    bool scheduleCommand(const LooperCommand& command);
+    void collectCommands();
+    bool pushCommand(const LooperCommand& command);
+
+    // Incoming MIDI triggers go straight to mScheduled at their event's sample
+    MidiLearn mMidiLearn;
+    void applyCommand(const LooperCommand& command);
+
+    // Free-running sample clock (never reset), and where the current host block started
+    // on it and in real time
+    std::atomic<juce::int64> mSampleClock { 0 };
+    std::atomic<juce::int64> mBlockStartSample { 0 };
+    std::atomic<double> mBlockStartMs { 0.0 };
+    std::atomic<int> mLastBlockSize { 0 };
+    std::atomic<juce::Thread::ThreadID> mAudioThreadId { nullptr };
+
+    // Largest piece of a host block processed at once (scratch buffer size). A host block
+    // larger than this, or than prepareToPlay announced, is split into sub-blocks.
+    static constexpr int MAX_SUB_BLOCK_SAMPLES = 1024;
+    int mSubBlockSize = MAX_SUB_BLOCK_SAMPLES;
+
+    /** Everything but command collection for [offset, offset + numSamples) of the host block. */
+    void processSubBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages, int offset, int numSamples);
+
+    /** Tracks + transport for [startSample, startSample + numSamples) of the sub-block
+        starting at bufferOffset in the host buffer (the caches hold the sub-block from 0). */
+    void processSegment(juce::AudioBuffer<float>& buffer, int bufferOffset, int startSample, int numSamples);
+
+    // --- Parallel track rendering (render_threads > 0) ---
+    // Each track renders into its own buffer from its own state and the shared input,
+    // so tracks can render on any thread in any order: mixing then reads the buffers
+    // in the plan's fixed order, and the result is bit-identical to serial rendering.
+    struct SegmentRender
+    {
+        juce::AudioBuffer<float>* input = nullptr;
+        int startSample = 0;
+        int numSamples = 0;
+        juce::int64 globalTotal = 0;
+        int masterLength = 0;
+        bool anySolo = false;
+    };
+    SegmentRender mSegmentRender;
+    RenderWorkerPool mRenderWorkers;
+    double mRenderDeadlineMs = 0.0;
+
+    // Cycle timers around processBlock's stages and each track's render
+    DspProfiler mProfiler;
+
+    /** Any thread taking part in a segment: renders track trackIndex (RenderWorkerPool task). */
+    static void renderTrack(void* processor, int trackIndex);
+
+    // --- Output mixing ---
+    // Tracks render at unity gain into their own buffers (LoopTrack::getOutput); each
+    // output bus then sums its playing tracks with their volumes in one pass per group
+    // of sources (MixKernels::addWeighted), instead of every track adding into the bus.
+    // The routing (out_select) is resolved into a plan, rebuilt only when it changes.
+    struct MixPlan
+    {
+        void resize(int numTracks);
 
-    // Previous param states for edge detection
-    bool mPrevRecPlay[NUM_TRACKS] = {};
-    bool mPrevStop[NUM_TRACKS] = {};
-    bool mPrevAfterLoop[NUM_TRACKS] = {};
-    bool mPrevClear[NUM_TRACKS] = {};
-    bool mPrevUndo[NUM_TRACKS] = {};
-    bool mPrevMul[NUM_TRACKS] = {};
-    bool mPrevDiv[NUM_TRACKS] = {};
-    bool mPrevResample[NUM_TRACKS] = {};
-    bool mPrevBounce = false;
-    bool mPrevReset = false;
+        std::vector<int> busOfTrack;
+        std::vector<int> tracks;     // track indices grouped by bus
+        std::vector<int> busStart;   // bus b mixes tracks[busStart[b] .. busStart[b + 1])
+
+        // Gathered per bus and channel by mixTracks
+        std::vector<const float*> sources;
+        std::vector<float> gains;
+    };
+    MixPlan mMixPlan;
+    std::atomic<bool> mMixPlanDirty { true };
+
+    struct RoutingListener : public juce::AudioProcessorValueTreeState::Listener
+    {
+        explicit RoutingListener(SimpleLooperAudioProcessor& p) : owner(p) {}
+        void parameterChanged(const juce::String&, float) override { owner.mMixPlanDirty.store(true); }
+        SimpleLooperAudioProcessor& owner;
+    };
+    RoutingListener mRoutingListener { *this };
+
+    void rebuildMixPlan();
+    /** Adds the tracks that rendered and played (mControls.playing) into their buses. */
+    void mixTracks(juce::AudioBuffer<float>& buffer, int startSample, int numSamples);
 
     // --- Retrospective buffer (After Loop) ---
     juce::AudioBuffer<float> mRetrospectiveBuffer;
     int mRetroWritePos = 0;
     int mRetroBufferSize = 0;
 
-    // Pre-allocated work buffer for bounce/afterloop operations
-    juce::AudioBuffer<float> mWorkBuffer;
-
-    // --- Deferred heavy operations (avoid audio thread overload) ---
+    // --- Bounce / After Loop (worker thread) ---
+    // The audio thread only hands a job over (copy-on-write snapshots of the
+    // tracks) and installs the finished result with a progressive replace.
     static constexpr int CROSSFADE_SAMPLES = 128;
+
+    struct LoopJob
+    {
+        enum Status { Idle, Pending, Done };
+        enum class Kind { Bounce, AfterLoop };
+
+        std::atomic<int> status { Idle };
+        Kind kind = Kind::Bounce;
+        int target = 0;               // track receiving the result
+        StagingBuffer* output = nullptr; // result, one reference held by the job
+        int length = 0;               // result length
+        int startOffset = 0;          // result alignment (see LoopTrack::beginProgressiveReplace)
+        juce::int64 startGlobal = 0;
+        juce::uint32 resetGeneration = 0;
+        juce::uint32 targetGeneration = 0; // After Loop: the target's content generation
+
+        // Track content when the job started. A track still being replaced is read
+        // from its replace source (referenced by the job, so nobody reuses it meanwhile).
+        struct Source
+        {
+            LoopImage image;
+            StagingBuffer* replaceSource = nullptr;
+            int length = 0;
+            juce::int64 startGlobal = 0;
+            bool used = false;
+
+            int getNumChannels() const { return replaceSource != nullptr ? replaceSource->audio.getNumChannels()
+                                                                         : image.getNumChannels(); }
+        };
+        std::vector<Source> sources;  // one per track, sized at construction
+
+        // After Loop: range of the retrospective buffer to capture
+        int retroStart = 0;
+        int captureLength = 0;
+        juce::int64 captureStartGlobal = 0;
+    };
+
+    struct JobWorker : public juce::Thread
+    {
+        explicit JobWorker(SimpleLooperAudioProcessor& p) : juce::Thread("SimpleLooper Jobs"), owner(p) {}
+        void run() override;
+
+        /** AUDIO: a job is pending. Never blocks: unlike notify() (WaitableEvent::signal
+            locks its mutex), the condition is signalled without taking the lock. */
+        void wake();
+
+        SimpleLooperAudioProcessor& owner;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> woken { false };
+    };
+
+    LoopJob mJob;
+    JobWorker mJobWorker { *this };
+    // Results in flight: one per job being rendered or being copied into a track
+    StagingBufferPool mStagingBuffers;
+    // Resets: numbered when requested (any thread), applied by the audio thread,
+    // which publishes the newest one it applied
+    std::atomic<juce::uint32> mResetGeneration { 0 };
+    std::atomic<juce::uint32> mResetsRequested { 0 };
+    static bool isNewerGeneration(juce::uint32 a, juce::uint32 b) { return (juce::int32)(a - b) > 0; }
+
+    // Bounce mixdown: the job worker splits the bounce into time ranges and mixes
+    // them on these threads too (every range reads all tracks, writes only its own samples)
+    static constexpr int MIXDOWN_RANGE_SAMPLES = 1 << 16;
+    struct Mixdown
+    {
+        float* const* channels = nullptr; // job output
+        int numChannels = 0;
+        std::atomic<int> nextRange { 0 };
+        int numRanges = 0;
+        std::atomic<int> participants { 0 }; // threads still mixing, the last one signals done
+        juce::WaitableEvent done;
+    };
+    Mixdown mMixdown;
+    juce::ThreadPool mMixdownThreads { juce::jlimit(1, 8, juce::SystemStats::getNumCpus() - 1) };
+    void mixdownRanges(); // any mixdown thread: mixes ranges until none is left
+
+    // Requests, started on the audio thread when the worker is free
     std::atomic<bool> mPendingBounce { false };
+    double mBounceRequestMs = 0.0;
+    std::atomic<double> mLastBounceLatencyMs { -1.0 };
+    std::atomic<double> mLastBounceRenderMs { -1.0 };
     std::atomic<int>  mPendingAfterLoop { -1 }; // track index, -1 = none
     void executePendingOperations();
 
+    /** Copy-on-write snapshot of a track's loop (or a reference to its replace source). */
+    void snapshotTrack(int trackIndex, LoopJob::Source& source);
+    /** Drops a snapshot; caller: the thread dropping it (PagePool's release paths). */
+    static void releaseSource(LoopJob::Source& source, PagePool::Caller caller);
+    bool startBounce();                 // AUDIO: false = retry later
+    bool startCaptureAfterLoop(int trackIndex);
+    void runJob();                      // WORKER
+    void installJob();                  // AUDIO
+    void releaseJob();                  // AUDIO
+    /** Adds source into dest[destStart, destStart + length), reading the loop from readStart. */
+    void renderSource(const LoopJob::Source& source, float* const* dest, int numDestChannels, int destStart,
+                      int length, int readStart);
+    void addCapture(juce::AudioBuffer<float>& dest, int destLength, int destStart);
+
+    // --- Session state (getStateInformation / setStateInformation, SessionFormat) ---
+    // Saving snapshots the tracks under the callback lock, like a job, then writes
+    // their audio, compressed through the cache, into the host's block.
+    // Loading restores parameters, MIDI learn and transport at once. The loops are
+    // decoded on the loader thread, one at a time and within a memory budget, and the
+    // audio thread installs each with a progressive replace as soon as it is ready:
+    // playback reads the decoded buffer until the track's pages are filled.
+    // Imported audio files take the same way, decoded from the file instead.
+    struct SessionLoad
+    {
+        SessionFormat::TrackInfo info;
+        juce::MemoryBlock audio;            // the TRAK chunk's audio, as stored
+        juce::File file;                    // or a file to import (info.length 0 until its header is read)
+        bool alignToMaster = false;         // import: see importAudioFile
+        juce::uint32 resetGeneration = 0;   // a reset since the load drops it
+        bool taken = false;                 // decoding, or handed to the audio thread
+        bool superseded = false;            // a newer session was loaded meanwhile
+    };
+    std::list<SessionLoad> mSessionLoads;  // until installed (a save writes them as they are)
+
+    // Decoded loops. The loader holds one reference until the audio thread installs
+    // the loop, the track one until its pages are filled; then the background thread
+    // deletes the buffer.
+    std::vector<std::unique_ptr<StagingBuffer>> mSessionBuffers;
+    static constexpr size_t SESSION_LOAD_BUDGET_BYTES = (size_t)256 << 20; // decoded, not in pages yet
+
+    std::vector<LoopJob::Source> mSessionSources; // save snapshots, one per track
+    juce::CriticalSection mSessionLock;           // all of the above
+
+    // The transport a restored session starts from, applied by its reset (generation
+    // mRestoreGeneration, 0 while written). Written under mSessionLock.
+    SessionFormat::Transport mRestoreTransport;
+    std::atomic<juce::uint32> mRestoreGeneration { 0 };
+
+    // Loader -> audio thread hand-over, one slot per track (sized at construction)
+    struct SessionInstall
+    {
+        enum Status { Free, Ready, Done };
+        std::atomic<int> status { Free };
+        SessionLoad* load = nullptr;        // loader side
+        StagingBuffer* buffer = nullptr;    // one reference, for the track
+        SessionFormat::TrackInfo info;
+        juce::uint32 resetGeneration = 0;
+        bool isImport = false;
+        bool alignToMaster = false;
+    };
+    std::vector<SessionInstall> mSessionInstalls;
+
+    struct SessionLoader : public juce::Thread
+    {
+        explicit SessionLoader(SimpleLooperAudioProcessor& p) : juce::Thread("SimpleLooper Session Load"), owner(p) {}
+        void run() override;
+        SimpleLooperAudioProcessor& owner;
+    };
+    SessionLoader mSessionLoader { *this };
+
+    int loadNextSessionTrack();    // LOADER: ms to wait before the next call (-1: until notified)
+    void installSessionTracks();   // AUDIO
+    void reclaimSessionBuffers();  // BACKGROUND
+    /** An imported file's loop length: converted, within the track, rounded to the master if asked. */
+    int getImportLength(const AudioImport::FileInfo& file, int trackIndex, bool alignToMaster) const;
+
+    // Compressed loop audio, kept between saves. Every few seconds the encoder thread
+    // has the audio thread snapshot the tracks (executePendingOperations) and encodes
+    // the blocks that changed; a save only takes the blocks current there.
+    SessionAudioCache mSessionCache;
+    std::vector<LoopJob::Source> mEncoderSources; // encoder snapshots, one per track
+    enum SnapshotRequest { SnapshotIdle, SnapshotRequested, SnapshotReady };
+    std::atomic<int> mEncoderSnapshot { SnapshotIdle };
+
+    // A save's snapshot, taken between two blocks like the encoder's: the transport,
+    // and each track's loop into mSessionSources with its TrackInfo (sized at construction)
+    std::atomic<int> mSaveSnapshot { SnapshotIdle };
+    SessionFormat::Transport mSaveTransport;
+    std::vector<SessionFormat::TrackInfo> mSaveInfos;
+    juce::uint32 mSaveGeneration = 0;
+    static constexpr int SAVE_STALLED_MS = 50; // no block for this long: the host isn't processing
+    /** AUDIO, or under the callback lock: fills the save snapshot above. */
+    void takeSaveSnapshot();
+
+    /** Not the audio thread: has the audio thread take a snapshot (take) between two blocks,
+        or takes it here under the callback lock once no block came for stalledMs (the host
+        isn't processing: the lock is free). thread: the calling thread, to give up when it
+        should exit (false), or null. */
+    bool awaitSnapshot(std::atomic<int>& snapshot, void (SimpleLooperAudioProcessor::*take)(),
+                       int stalledMs, juce::Thread* thread);
+    static constexpr int SESSION_ENCODE_INTERVAL_MS = 2000;
+
+    struct SessionEncoder : public juce::Thread
+    {
+        explicit SessionEncoder(SimpleLooperAudioProcessor& p) : juce::Thread("SimpleLooper Session"), owner(p) {}
+        void run() override;
+        SimpleLooperAudioProcessor& owner;
+    };
+    SessionEncoder mSessionEncoder { *this };
+
+    /** A snapshot's blocks, encoded through the cache (render, hash, encode if changed). */
+    std::vector<SessionAudioCache::Encoded> encodeSessionTrack(int trackIndex, const LoopJob::Source& source,
+                                                               int numChannels, juce::AudioBuffer<float>& scratch);
+    /** A save: a snapshot's blocks as the encoder cached them (render, hash, look up),
+        null for a block not cached as it is now. False if any block is null. */
+    bool findEncodedSessionTrack(int trackIndex, const LoopJob::Source& source, int numChannels,
+                                 juce::AudioBuffer<float>& scratch, std::vector<SessionAudioCache::Encoded>& blocks);
+    /** A save: a snapshot's audio with the cached blocks, the others uncompressed (Codec::PerBlock). */
+    void writeSessionTrackBlocks(juce::OutputStream& out, const LoopJob::Source& source, int numChannels,
+                                 const std::vector<SessionAudioCache::Encoded>& blocks, juce::AudioBuffer<float>& scratch);
+
+    // --- Stem export ---
+    // The exporter thread has the audio thread snapshot every track (as for the session
+    // encoder), then writes the files in parallel: it and the export threads take
+    // files off the list until none is left, each rendering its file block by block.
+    // If the host isn't calling processBlock, the exporter takes the snapshot itself,
+    // under the callback lock.
+    StemExport::Options mExportOptions;           // of the export running (set before it starts)
+    std::vector<LoopJob::Source> mExportSources;  // one per track
+    std::atomic<int> mExportSnapshot { SnapshotIdle };
+    int mExportLength = 0;                        // AUDIO -> exporter, with the snapshot
+    static constexpr int EXPORT_STALLED_MS = 200; // no block for this long: the host stopped processing
+    /** AUDIO, or under the callback lock: every track's snapshot and the export length. */
+    void takeExportSnapshot();
+    double mExportSampleRate = 0.0;
+    std::atomic<int> mExportState { (int)ExportState::Idle };
+    std::atomic<juce::int64> mExportFramesDone { 0 };
+    std::atomic<juce::int64> mExportFramesTotal { 0 };
+    static constexpr int EXPORT_BLOCK_SAMPLES = 1 << 16;
+
+    struct ExportFile
+    {
+        juce::File file;
+        int track = -1;         // -1: the mix
+        bool written = false;
+    };
+    std::vector<ExportFile> mExportFiles;
+    std::atomic<int> mExportNextFile { 0 };
+    std::atomic<int> mExportParticipants { 0 }; // threads still writing, the last one signals done
+    juce::WaitableEvent mExportDone;
+    juce::ThreadPool mExportThreads { juce::jlimit(1, 8, juce::SystemStats::getNumCpus() - 1) };
+
+    struct StemExporter : public juce::Thread
+    {
+        explicit StemExporter(SimpleLooperAudioProcessor& p) : juce::Thread("SimpleLooper Stem Export"), owner(p) {}
+        void run() override;
+        SimpleLooperAudioProcessor& owner;
+    };
+    StemExporter mStemExporter { *this };
+
+    void exportFiles();     // EXPORTER, export threads: writes files until none is left
+    bool writeExportFile(const ExportFile& file, juce::AudioBuffer<float>& scratch);
+
     // --- MIDI Clock output (24 PPQN) ---
     double mMidiClockAccumulator = 0.0; // fractional sample position for next tick
     bool mMidiClockRunning = false;
@@ -0,0 +1,216 @@
+#include "RenderWorkers.h"
+
+// Test harness only: tasks on the workers are checked like the audio thread
+#if SIMPLELOOPER_RT_GUARD
+ #include "RealtimeGuard.h"
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+ #include <immintrin.h>
+ #define RENDERWORKERS_PAUSE() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+ #define RENDERWORKERS_PAUSE() __asm__ __volatile__("yield")
+#else
+ #define RENDERWORKERS_PAUSE() std::atomic_signal_fence(std::memory_order_seq_cst)
+#endif
+
+RenderWorkerPool::~RenderWorkerPool()
+{
+    stop();
+}
+
+void RenderWorkerPool::start(int numWorkers, double sampleRate, int samplesPerBlock)
+{
+    stop();
+
+    const double blockMs = 1000.0 * juce::jmax(1, samplesPerBlock) / juce::jmax(1.0, sampleRate);
+    spinMs = 2.0 * blockMs;                                        // hot across the next block
+    lateMs = blockMs;                                              // longer and the callback is late anyway
+    fallbackBatches = juce::jmax(1, juce::roundToInt(1000.0 / blockMs)); // about one second
+
+    current.store(0);
+    for (auto& batch : finishedIn)
+        batch.store(0);
+    batchNumber = 0;
+    lastNumTasks = 0;
+    consecutiveMisses = 0;
+    serialBatchesLeft = 0;
+
+    const auto options = juce::Thread::RealtimeOptions{}
+                             .withPriority(8)
+                             .withApproximateAudioProcessingTime(juce::jmax(1, samplesPerBlock), sampleRate);
+
+    for (int i = 0; i < juce::jlimit(0, maxWorkers, numWorkers); ++i)
+    {
+        workers.push_back(std::make_unique<Worker>(*this, i));
+        // Without realtime scheduling rights, the highest normal priority still helps
+        if (!workers.back()->startRealtimeThread(options))
+            workers.back()->startThread(juce::Thread::Priority::highest);
+    }
+}
+
+void RenderWorkerPool::stop()
+{
+    for (auto& worker : workers)
+        worker->signalThreadShouldExit();
+    for (auto& worker : workers)
+        worker->stopThread(1000);
+    workers.clear();
+}
+
+void RenderWorkerPool::setNumActiveWorkers(int numActive)
+{
+    numActiveWorkers.store(juce::jlimit(0, getNumWorkers(), numActive), std::memory_order_relaxed);
+}
+
+bool RenderWorkerPool::run(int numTasks, Task task, void* context, double deadlineMs)
+{
+    if (numTasks <= 0) return true;
+    jassert(numTasks <= maxTasks);
+    numTasks = juce::jmin(numTasks, maxTasks);
+
+    if (++batchNumber == 0) ++batchNumber; // 0 marks a task nobody runs
+    lastNumTasks = numTasks;
+    batchTask.store(task, std::memory_order_relaxed);
+    batchContext.store(context, std::memory_order_relaxed);
+
+    if (numTasks == 1 || numActiveWorkers.load(std::memory_order_relaxed) == 0 || serialBatchesLeft > 0)
+    {
+        if (serialBatchesLeft > 0)
+            --serialBatchesLeft;
+
+        // Published empty: a worker still in an earlier batch claims nothing more
+        current.store(makeBatch(batchNumber, 0));
+        for (int i = 0; i < numTasks; ++i)
+            runTask(batchNumber, i);
+        return true;
+    }
+
+    // Publish the batch: the store makes its description visible to the workers
+    current.store(makeBatch(batchNumber, numTasks));
+
+    if (!work(batchNumber))
+    {
+        consecutiveMisses = 0;
+        return true;
+    }
+
+    // Tasks still running on a worker: spin until they are done, for one block at most
+    const double waitStart = juce::Time::getMillisecondCounterHiRes();
+    double waited = 0.0;
+    while (work(batchNumber))
+    {
+        waited = juce::Time::getMillisecondCounterHiRes() - waitStart;
+        if (waited > lateMs)
+        {
+            numLateTasks.fetch_add(1);
+            break;
+        }
+        RENDERWORKERS_PAUSE();
+    }
+
+    const bool metDeadline = waited <= deadlineMs;
+    if (metDeadline)
+    {
+        consecutiveMisses = 0;
+    }
+    else if (++consecutiveMisses >= missesBeforeFallback)
+    {
+        consecutiveMisses = 0;
+        serialBatchesLeft = fallbackBatches;
+        numFallbacks.fetch_add(1);
+    }
+    return metDeadline;
+}
+
+bool RenderWorkerPool::wasRendered(int taskIndex) const
+{
+    return taskIndex < lastNumTasks && finishedIn[(size_t)taskIndex].load(std::memory_order_acquire) == batchNumber;
+}
+
+bool RenderWorkerPool::isIdle() const
+{
+    for (auto& batch : runningIn)
+        if (batch.load(std::memory_order_acquire) != 0)
+            return false;
+    return true;
+}
+
+bool RenderWorkerPool::work(juce::uint32 batch)
+{
+    const auto published = current.load();
+    if ((juce::uint32)(published >> 32) != batch) return false;        // a newer batch started
+
+    bool anyLeft = false;
+    for (int i = 0; i < (int)(published & 0xffffffff); ++i)
+        if (finishedIn[(size_t)i].load(std::memory_order_acquire) != batch && !runTask(batch, i))
+            anyLeft = true;                                             // held by another thread
+    return anyLeft;
+}
+
+bool RenderWorkerPool::runTask(juce::uint32 batch, int taskIndex)
+{
+    const auto i = (size_t)taskIndex;
+
+    // Fails while another thread runs the task, for this batch or (late) an earlier one
+    juce::uint32 idle = 0;
+    if (!runningIn[i].compare_exchange_strong(idle, batch))
+        return false;
+
+    // Claimed for a batch since replaced, or finished by the thread that just let go
+    if ((juce::uint32)(current.load() >> 32) != batch || finishedIn[i].load(std::memory_order_relaxed) == batch)
+    {
+        runningIn[i].store(0);
+        return finishedIn[i].load(std::memory_order_relaxed) == batch;
+    }
+
+    // A late task may read a newer batch's description: run() keeps it the same
+    {
+       #if SIMPLELOOPER_RT_GUARD
+        RealtimeGuard::ScopedRealtime realtime;
+       #endif
+        batchTask.load(std::memory_order_relaxed)(batchContext.load(std::memory_order_relaxed), taskIndex);
+    }
+    finishedIn[i].store(batch, std::memory_order_release);
+    runningIn[i].store(0);
+    return true;
+}
+
+void RenderWorkerPool::Worker::run()
+{
+    // Same float environment as the audio thread (processBlock), or denormals would
+    // make a track rendered here differ from one rendered there
+    juce::ScopedNoDenormals noDenormals;
+
+    juce::uint32 lastBatch = (juce::uint32)(pool.current.load() >> 32);
+    double hotUntil = 0.0;
+
+    while (!threadShouldExit())
+    {
+        if (index >= pool.numActiveWorkers.load(std::memory_order_relaxed))
+        {
+            wait(idleWaitMs);
+            continue;
+        }
+
+        const auto published = pool.current.load(std::memory_order_acquire);
+        const auto batch = (juce::uint32)(published >> 32);
+        if (batch != lastBatch)
+        {
+            lastBatch = batch;
+            pool.work(batch);
+
+            // Serial batches are published empty: nothing to stay hot for
+            if ((published & 0xffffffff) != 0)
+                hotUntil = juce::Time::getMillisecondCounterHiRes() + pool.spinMs;
+        }
+        else if (juce::Time::getMillisecondCounterHiRes() < hotUntil)
+        {
+            RENDERWORKERS_PAUSE();
+        }
+        else
+        {
+            wait(1);
+        }
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+    Helper threads that render tracks alongside the audio thread.
+
+    run() hands out a batch of independent tasks (one per track). Each task is
+    claimed on its own (a compare-and-swap on its slot), by the workers and by the
+    audio thread itself, so a batch always completes even if no worker wakes up in
+    time: the audio thread simply claims whatever is left, which is serial rendering.
+
+    - Workers stay hot (spinning) for a short while after each batch, then poll
+      with a short sleep, so the audio thread never has to signal or lock anything.
+    - A task claimed by a worker is waited for, but for one block at most: a worker
+      preempted for longer keeps its task, and the batch returns without it
+      (wasRendered is false, the track is silent). Until the task finishes the pool
+      is not idle (isIdle): the caller leaves that track alone, and later batches
+      skip it.
+    - The deadline decides whether the next batches still use the workers: after a
+      few batches in a row where the audio thread waited longer than the deadline,
+      everything runs on the audio thread for a while (serial fallback), then the
+      workers get another try.
+*/
+class RenderWorkerPool
+{
+public:
+    using Task = void (*)(void* context, int taskIndex);
+
+    static constexpr int maxWorkers = 7;
+
+    RenderWorkerPool() = default;
+    ~RenderWorkerPool();
+
+    //==============================================================================
+    /** PREPARE: message thread. Starts numWorkers threads at audio priority, sized
+        for blocks of samplesPerBlock at sampleRate. */
+    void start(int numWorkers, double sampleRate, int samplesPerBlock);
+    void stop();
+
+    int getNumWorkers() const { return (int)workers.size(); }
+
+    //==============================================================================
+    /** AUDIO: how many of the workers take part in batches (0 = everything on the audio thread). */
+    void setNumActiveWorkers(int numActive);
+
+    /** AUDIO: runs task(context, i) for every i in [0, numTasks) and returns once they
+        have all finished, or after one block if a worker still holds some. Returns false
+        if the wait for the workers exceeded deadlineMs. numTasks must not exceed maxTasks;
+        task and context must be the same in every batch (a late task may read either). */
+    bool run(int numTasks, Task task, void* context, double deadlineMs);
+
+    /** AUDIO: whether task i ran in the last batch (false: skipped or still running late). */
+    bool wasRendered(int taskIndex) const;
+
+    /** AUDIO: false while a task the audio thread gave up on still runs on a worker. */
+    bool isIdle() const;
+
+    /** Times the pool fell back to serial rendering, and batches that returned without
+        a late task (UI / diagnostics). */
+    int getNumFallbacks() const { return numFallbacks.load(); }
+    int getNumLateTasks() const { return numLateTasks.load(); }
+
+    static constexpr int maxTasks = 64;
+
+private:
+    struct Worker : public juce::Thread
+    {
+        Worker(RenderWorkerPool& p, int i) : juce::Thread("SimpleLooper Render " + juce::String(i + 1)), pool(p), index(i) {}
+        void run() override;
+        RenderWorkerPool& pool;
+        const int index;
+    };
+
+    /** Claims and runs the tasks of this batch nobody holds; false once none is left to run. */
+    bool work(juce::uint32 batch);
+    /** Runs one task unless another thread holds it; true if it has finished in this batch. */
+    bool runTask(juce::uint32 batch, int taskIndex);
+
+    static constexpr int missesBeforeFallback = 3;
+    static constexpr int idleWaitMs = 20;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    double spinMs = 0.0;
+    double lateMs = 0.0;
+    int fallbackBatches = 0;
+
+    // Current batch: batch number (bits 32-63) and task count (0-31), in one word.
+    // The task and context below are written before the batch number is published.
+    static juce::uint64 makeBatch(juce::uint32 batch, int size) { return ((juce::uint64)batch << 32) | (juce::uint64)size; }
+    std::atomic<juce::uint64> current { 0 };
+    std::atomic<Task> batchTask { nullptr };
+    std::atomic<void*> batchContext { nullptr };
+    std::atomic<int> numActiveWorkers { 0 };
+
+    // Per task: the batch running it (0 = nobody), and the last batch it finished in.
+    // A worker that claims a task for a batch already replaced gives it back unrun.
+    std::array<std::atomic<juce::uint32>, maxTasks> runningIn {};
+    std::array<std::atomic<juce::uint32>, maxTasks> finishedIn {};
+
+    // Audio thread only
+    juce::uint32 batchNumber = 0;
+    int lastNumTasks = 0;
+    int consecutiveMisses = 0;
+    int serialBatchesLeft = 0;
+
+    std::atomic<int> numFallbacks { 0 };
+    std::atomic<int> numLateTasks { 0 };
+
+    JUCE_DECLARE_NON_COPYABLE(RenderWorkerPool)
+};
@@ -0,0 +1,50 @@
+#include "SessionAudioCache.h"
+
+void SessionAudioCache::resize(int numTracks)
+{
+    const juce::ScopedLock sl(lock);
+    tracks.resize((size_t)juce::jmax(0, numTracks));
+}
+
+SessionAudioCache::Encoded SessionAudioCache::encode(int track, int block, const juce::AudioBuffer<float>& audio,
+                                                     int numChannels, int numFrames)
+{
+    const auto hash = SessionFormat::hashBlock(audio, numChannels, numFrames);
+    if (auto cached = find(track, block, hash, numChannels))
+        return cached;
+
+    auto encoded = std::make_shared<const juce::MemoryBlock>(SessionFormat::encodeBlock(audio, numChannels, numFrames));
+
+    const juce::ScopedLock sl(lock);
+    auto& entries = tracks[(size_t)track];
+    if ((size_t)block >= entries.size())
+        entries.resize((size_t)block + 1);
+    entries[(size_t)block] = { hash, numChannels, encoded };
+    return encoded;
+}
+
+SessionAudioCache::Encoded SessionAudioCache::find(int track, int block, const SessionFormat::BlockHash& hash, int numChannels)
+{
+    const juce::ScopedLock sl(lock);
+    const auto& entries = tracks[(size_t)track];
+    if ((size_t)block >= entries.size())
+        return nullptr;
+
+    const auto& entry = entries[(size_t)block];
+    return entry.hash == hash && entry.numChannels == numChannels ? entry.encoded : nullptr;
+}
+
+void SessionAudioCache::trim(int track, int numBlocks)
+{
+    // Released outside the lock: the last reference frees the encoded data
+    std::vector<Entry> dropped;
+    {
+        const juce::ScopedLock sl(lock);
+        auto& entries = tracks[(size_t)track];
+        if ((size_t)numBlocks >= entries.size())
+            return;
+
+        dropped.assign(std::make_move_iterator(entries.begin() + numBlocks), std::make_move_iterator(entries.end()));
+        entries.resize((size_t)numBlocks);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+#include <vector>
+#include "SessionFormat.h"
+
+/**
+    Compressed loop audio for the session state, kept between saves.
+
+    One entry per block (SessionFormat::blockFrames frames) of each track, keyed by
+    a hash of the block's samples. The processor's session encoder thread keeps the
+    cache current in the background, encoding only the blocks whose samples changed.
+    A save never encodes: it renders and hashes each block and takes the entries
+    that are current (find), storing each stale block uncompressed.
+
+    Any thread. The lock is only held to look an entry up or store it, never while
+    encoding; entries are shared, so a save keeps what it took even if the
+    encoder replaces it meanwhile.
+*/
+class SessionAudioCache
+{
+public:
+    using Encoded = std::shared_ptr<const juce::MemoryBlock>;
+
+    SessionAudioCache() = default;
+
+    /** Construction only: one (empty) table per track. */
+    void resize(int numTracks);
+
+    /** The first numFrames of numChannels channels of audio, encoded as block number
+        block of the track: from the cache when the samples haven't changed. */
+    Encoded encode(int track, int block, const juce::AudioBuffer<float>& audio, int numChannels, int numFrames);
+
+    /** The block's entry if it holds these samples (same hash and channels), else null. */
+    Encoded find(int track, int block, const SessionFormat::BlockHash& hash, int numChannels);
+
+    /** Forgets a track's blocks from numBlocks on (0: the whole track). */
+    void trim(int track, int numBlocks);
+
+private:
+    struct Entry
+    {
+        SessionFormat::BlockHash hash;
+        int numChannels = 0;
+        Encoded encoded;
+    };
+
+    std::vector<std::vector<Entry>> tracks;
+    juce::CriticalSection lock;
+
+    JUCE_DECLARE_NON_COPYABLE(SessionAudioCache)
+};
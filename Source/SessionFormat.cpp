@@ -0,0 +1,295 @@
+#include "SessionFormat.h"
+
+namespace SessionFormat
+{
+    static constexpr char magic[4] = { 'S', 'L', 'P', 'S' };
+
+    void writeHeader(juce::OutputStream& out)
+    {
+        out.write(magic, sizeof(magic));
+        out.writeInt((int)version);
+    }
+
+    bool readHeader(juce::InputStream& in)
+    {
+        char name[4] {};
+        if (in.read(name, sizeof(name)) != (int)sizeof(name) || std::memcmp(name, magic, sizeof(magic)) != 0)
+            return false;
+
+        const auto fileVersion = (juce::uint32)in.readInt();
+        return fileVersion >= 1 && fileVersion <= version;
+    }
+
+    void writeChunkHeader(juce::OutputStream& out, juce::uint32 id, juce::uint64 payloadSize)
+    {
+        out.writeInt((int)id);
+        out.writeInt64((juce::int64)payloadSize);
+    }
+
+    bool readChunkHeader(juce::InputStream& in, juce::uint32& id, juce::uint64& payloadSize)
+    {
+        if (in.getNumBytesRemaining() < (juce::int64)chunkHeaderSize)
+            return false;
+
+        id = (juce::uint32)in.readInt();
+        payloadSize = (juce::uint64)in.readInt64();
+        return payloadSize <= (juce::uint64)in.getNumBytesRemaining();
+    }
+
+    //==============================================================================
+    void write(juce::OutputStream& out, const Transport& transport)
+    {
+        out.writeDouble(transport.sampleRate);
+        out.writeDouble(transport.bpm);
+        out.writeInt(transport.primaryLoopLength);
+        out.writeInt(transport.globalPlaybackPosition);
+        out.writeInt64(transport.globalTotalSamples);
+        out.writeByte(transport.isFirstLoop ? 1 : 0);
+    }
+
+    bool read(juce::InputStream& in, juce::uint64 payloadSize, Transport& transport)
+    {
+        if (payloadSize < Transport::size)
+            return false;
+
+        transport.sampleRate             = in.readDouble();
+        transport.bpm                    = in.readDouble();
+        transport.primaryLoopLength      = juce::jmax(0, in.readInt());
+        transport.globalPlaybackPosition = juce::jmax(0, in.readInt());
+        transport.globalTotalSamples     = juce::jmax((juce::int64)0, in.readInt64());
+        transport.isFirstLoop            = in.readByte() != 0;
+        return true;
+    }
+
+    void write(juce::OutputStream& out, const TrackInfo& info)
+    {
+        out.writeInt((int)TrackInfo::size);
+        out.writeInt(info.index);
+        out.writeInt(info.state);
+        out.writeInt(info.length);
+        out.writeInt(info.recordingStartOffset);
+        out.writeInt64(info.recordingStartGlobalSample);
+        out.writeFloat(info.targetMultiplier);
+        out.writeInt(info.numChannels);
+        out.writeInt((int)info.codec);
+    }
+
+    bool read(juce::InputStream& in, juce::uint64 payloadSize, TrackInfo& info)
+    {
+        const auto infoSize = (juce::uint64)(juce::uint32)in.readInt();
+        if (infoSize < TrackInfo::sizeV1 || infoSize > payloadSize)
+            return false;
+
+        info.index                      = in.readInt();
+        info.state                      = in.readInt();
+        info.length                     = in.readInt();
+        info.recordingStartOffset       = in.readInt();
+        info.recordingStartGlobalSample = in.readInt64();
+        info.targetMultiplier           = in.readFloat();
+        info.numChannels                = in.readInt();
+        info.codec                      = Codec::Raw; // version 1
+        if (infoSize >= TrackInfo::size)
+        {
+            const int codec = in.readInt();
+            if (codec != (int)Codec::Raw && codec != (int)Codec::Compressed && codec != (int)Codec::PerBlock)
+                return false;
+            info.codec = (Codec)codec;
+        }
+        in.skipNextBytes((juce::int64)(infoSize - juce::jmin(infoSize, TrackInfo::size))); // fields of a later writer
+
+        if (info.length <= 0 || info.numChannels <= 0 || info.numChannels > 8)
+            return false;
+
+        // The audio must be all there: nothing is allocated for data the chunk doesn't hold
+        // (a compressed block takes at least its size field, a block of either codec its codec field)
+        const auto audioBytes = payloadSize - infoSize;
+        return info.codec == Codec::Raw ? (juce::uint64)info.length * (juce::uint64)info.numChannels * 4 <= audioBytes
+                                        : (juce::uint64)info.getNumBlocks() * 4 <= audioBytes;
+    }
+
+    //==============================================================================
+    bool readSamples(juce::InputStream& in, float* samples, int numSamples)
+    {
+       #if JUCE_LITTLE_ENDIAN
+        const auto numBytes = (int)((size_t)numSamples * sizeof(float));
+        return in.read(samples, numBytes) == numBytes;
+       #else
+        for (int i = 0; i < numSamples; ++i)
+            samples[i] = in.readFloat();
+        return !in.isExhausted() || numSamples == 0;
+       #endif
+    }
+
+    void writeSamples(juce::OutputStream& out, const float* samples, int numSamples)
+    {
+       #if JUCE_LITTLE_ENDIAN
+        out.write(samples, (size_t)numSamples * sizeof(float));
+       #else
+        for (int i = 0; i < numSamples; ++i)
+            out.writeFloat(samples[i]);
+       #endif
+    }
+
+    void writeRawBlock(juce::OutputStream& out, const juce::AudioBuffer<float>& audio, int numChannels, int numFrames)
+    {
+        out.writeInt((int)Codec::Raw);
+        for (int ch = 0; ch < numChannels; ++ch)
+            writeSamples(out, audio.getReadPointer(ch), numFrames);
+    }
+
+    void writeCompressedBlock(juce::OutputStream& out, const juce::MemoryBlock& encoded)
+    {
+        out.writeInt((int)Codec::Compressed);
+        out.writeInt((int)encoded.getSize());
+        out.write(encoded.getData(), encoded.getSize());
+    }
+
+    juce::uint64 getRawBlockSize(int numChannels, int numFrames)
+    {
+        return 4 + (juce::uint64)numChannels * (juce::uint64)numFrames * 4;
+    }
+
+    juce::uint64 getCompressedBlockSize(const juce::MemoryBlock& encoded)
+    {
+        return 4 + 4 + (juce::uint64)encoded.getSize();
+    }
+
+    bool readAudio(juce::InputStream& in, const TrackInfo& info, juce::AudioBuffer<float>& audio)
+    {
+        if (audio.getNumSamples() < info.length)
+            return false;
+
+        juce::MemoryBlock encoded;
+        for (int block = 0; block < info.getNumBlocks(); ++block)
+        {
+            const int start = block * blockFrames;
+            const int numFrames = info.getBlockLength(block);
+
+            auto codec = info.codec;
+            if (codec == Codec::PerBlock)
+            {
+                codec = (Codec)in.readInt();
+                if (codec != Codec::Raw && codec != Codec::Compressed)
+                    return false;
+            }
+
+            if (codec == Codec::Compressed)
+            {
+                const auto size = (juce::uint32)in.readInt();
+                if ((juce::int64)size > in.getNumBytesRemaining())
+                    return false;
+
+                encoded.setSize(size);
+                if (in.read(encoded.getData(), (int)size) != (int)size
+                    || !decodeBlock(encoded.getData(), size, info.numChannels, numFrames, audio, start))
+                    return false;
+                continue;
+            }
+
+            for (int ch = 0; ch < info.numChannels; ++ch)
+            {
+                if (ch >= audio.getNumChannels())
+                    in.skipNextBytes((juce::int64)numFrames * 4);
+                else if (!readSamples(in, audio.getWritePointer(ch, start), numFrames))
+                    return false;
+            }
+        }
+
+        for (int ch = info.numChannels; ch < audio.getNumChannels(); ++ch)
+            audio.copyFrom(ch, 0, audio, 0, 0, info.length);
+        return true;
+    }
+}
+
+//==============================================================================
+namespace SessionFormat
+{
+    // Float bits -> integer in the float's order (negative values reversed below the positive ones)
+    static juce::uint32 toOrdered(juce::uint32 bits)   { return (bits & 0x80000000u) != 0 ? ~bits : bits | 0x80000000u; }
+    static juce::uint32 fromOrdered(juce::uint32 key)  { return (key & 0x80000000u) != 0 ? key & 0x7fffffffu : ~key; }
+
+    // Small deltas of either sign -> small unsigned values
+    static juce::uint32 zigzag(juce::uint32 delta)     { return (delta << 1) ^ (juce::uint32)((juce::int32)delta >> 31); }
+    static juce::uint32 unzigzag(juce::uint32 value)   { return (value >> 1) ^ (0u - (value & 1u)); }
+
+    BlockHash hashBlock(const juce::AudioBuffer<float>& audio, int numChannels, int numFrames)
+    {
+        BlockHash hash { 0xcbf29ce484222325ull ^ (juce::uint64)numFrames, 0x9e3779b97f4a7c15ull ^ (juce::uint64)numChannels };
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const auto* words = reinterpret_cast<const juce::uint32*>(audio.getReadPointer(ch));
+            for (int i = 0; i < numFrames; ++i)
+            {
+                hash.a = (hash.a ^ words[i]) * 0x100000001b3ull;                    // FNV-1a on words
+                hash.b = (hash.b + words[i] * 0xbf58476d1ce4e5b9ull) * 0x94d049bb133111ebull;
+                hash.b ^= hash.b >> 29;
+            }
+        }
+        return hash;
+    }
+
+    juce::MemoryBlock encodeBlock(const juce::AudioBuffer<float>& audio, int numChannels, int numFrames)
+    {
+        // Byte planes: per channel, byte 3 of every sample, then byte 2, ...
+        juce::HeapBlock<juce::uint8> planes((size_t)numChannels * (size_t)numFrames * 4);
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const auto* words = reinterpret_cast<const juce::uint32*>(audio.getReadPointer(ch));
+            auto* dest = planes.get() + (size_t)ch * (size_t)numFrames * 4;
+
+            juce::uint32 previous = toOrdered(0), previousDelta = 0;
+            for (int i = 0; i < numFrames; ++i)
+            {
+                const auto key = toOrdered(words[i]);
+                const auto delta = key - previous;
+                const auto value = zigzag(delta - previousDelta); // second order: linear prediction
+                previous = key;
+                previousDelta = delta;
+
+                for (int b = 0; b < 4; ++b)
+                    dest[(size_t)b * (size_t)numFrames + (size_t)i] = (juce::uint8)(value >> (24 - 8 * b));
+            }
+        }
+
+        juce::MemoryBlock encoded;
+        {
+            // A fast level: the transform does most of the work
+            juce::MemoryOutputStream out(encoded, false);
+            juce::GZIPCompressorOutputStream zip(out, 3);
+            zip.write(planes.get(), (size_t)numChannels * (size_t)numFrames * 4);
+        }
+        return encoded;
+    }
+
+    bool decodeBlock(const void* data, size_t size, int numChannels, int numFrames,
+                     juce::AudioBuffer<float>& audio, int destStart)
+    {
+        const auto planeBytes = (size_t)numFrames * 4;
+        juce::HeapBlock<juce::uint8> planes(planeBytes);
+
+        juce::MemoryInputStream source(data, size, false);
+        juce::GZIPDecompressorInputStream unzip(source);
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            if (unzip.read(planes.get(), (int)planeBytes) != (int)planeBytes)
+                return false;
+            if (ch >= audio.getNumChannels())
+                continue;
+
+            auto* words = reinterpret_cast<juce::uint32*>(audio.getWritePointer(ch, destStart));
+            juce::uint32 previous = toOrdered(0), previousDelta = 0;
+            for (int i = 0; i < numFrames; ++i)
+            {
+                juce::uint32 value = 0;
+                for (int b = 0; b < 4; ++b)
+                    value |= (juce::uint32)planes[(size_t)b * (size_t)numFrames + (size_t)i] << (24 - 8 * b);
+
+                previousDelta += unzigzag(value);
+                previous += previousDelta;
+                words[i] = fromOrdered(previous);
+            }
+        }
+        return true;
+    }
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <JuceHeader.h>
+
+/**
+    Binary layout of the plugin state (getStateInformation / setStateInformation).
+
+    All values little endian:
+
+        "SLPS", uint32 version
+        chunks, each: uint32 id, uint64 payload size, payload
+            PARM  parameters (the APVTS ValueTree, ValueTree::writeToStream)
+            MIDI  MIDI-learn bindings: uint32 count, then count x 5 bytes
+                  (source, channel, number, command type, track)
+            XPRT  transport (Transport)
+            TRAK  one per track with a loop: TrackInfo, then the loop's first
+                  TrackInfo::length frames in blocks of blockFrames frames (the
+                  last one shorter), each block channel after channel:
+                  - Codec::Raw: float32 samples
+                  - Codec::Compressed: uint32 size, then the block's encodeBlock()
+                    bytes (version 2)
+                  - Codec::PerBlock: uint32 codec (Raw or Compressed), then the
+                    block as that codec stores it (version 3)
+
+    Readers skip chunks they don't know and whatever follows the fields they know
+    inside a chunk, so later versions can add chunks and append fields. A new
+    version number means an incompatible change; older versions stay readable.
+
+    Compression is lossless on the float bits: loops are float mixes (overdubs,
+    gains, crossfades), which an integer codec such as FLAC (24 bit at most)
+    would round. Each sample's bits are mapped to an integer that orders like the
+    float, predicted from the previous two (second order delta) and the residuals
+    split into byte planes, so the high bytes (nearly constant) and the zero runs
+    of silence deflate well.
+*/
+namespace SessionFormat
+{
+    constexpr juce::uint32 version = 3;
+    constexpr int blockFrames = 1 << 16;
+
+    constexpr juce::uint32 makeId(const char (&name)[5])
+    {
+        return (juce::uint32)(juce::uint8)name[0]         | ((juce::uint32)(juce::uint8)name[1] << 8)
+             | ((juce::uint32)(juce::uint8)name[2] << 16) | ((juce::uint32)(juce::uint8)name[3] << 24);
+    }
+
+    constexpr juce::uint32 parametersId = makeId("PARM");
+    constexpr juce::uint32 midiLearnId  = makeId("MIDI");
+    constexpr juce::uint32 transportId  = makeId("XPRT");
+    constexpr juce::uint32 trackId      = makeId("TRAK");
+
+    constexpr juce::uint64 headerSize      = 8;
+    constexpr juce::uint64 chunkHeaderSize = 12;
+
+    struct Transport
+    {
+        double sampleRate = 0.0;
+        double bpm = 0.0;
+        int primaryLoopLength = 0;
+        int globalPlaybackPosition = 0;
+        juce::int64 globalTotalSamples = 0;
+        bool isFirstLoop = true;
+
+        static constexpr juce::uint64 size = 8 + 8 + 4 + 4 + 8 + 1;
+    };
+
+    enum class Codec
+    {
+        Raw,
+        Compressed,
+        PerBlock     // compressed blocks, and raw ones the encoder hasn't caught up with
+    };
+
+    struct TrackInfo
+    {
+        int index = 0;
+        int state = 0;               // LoopTrack::State
+        int length = 0;              // frames stored (loopLengthSamples)
+        int recordingStartOffset = 0;
+        juce::int64 recordingStartGlobalSample = 0;
+        float targetMultiplier = 1.0f;
+        int numChannels = 0;
+        Codec codec = Codec::Compressed;
+
+        static constexpr juce::uint64 sizeV1 = 4 + 4 + 4 + 4 + 4 + 8 + 4 + 4; // with its own size field first
+        static constexpr juce::uint64 size   = sizeV1 + 4;
+
+        int getNumBlocks() const { return (length + blockFrames - 1) / blockFrames; }
+        int getBlockLength(int block) const { return juce::jmin(blockFrames, length - block * blockFrames); }
+    };
+
+    //==============================================================================
+    void writeHeader(juce::OutputStream& out);
+    /** False if the stream doesn't start with a session header of a version we read. */
+    bool readHeader(juce::InputStream& in);
+
+    void writeChunkHeader(juce::OutputStream& out, juce::uint32 id, juce::uint64 payloadSize);
+    /** False at the end of the data, or if the chunk claims more bytes than are left. */
+    bool readChunkHeader(juce::InputStream& in, juce::uint32& id, juce::uint64& payloadSize);
+
+    void write(juce::OutputStream& out, const Transport& transport);
+    bool read(juce::InputStream& in, juce::uint64 payloadSize, Transport& transport);
+
+    void write(juce::OutputStream& out, const TrackInfo& info);
+    /** Leaves the stream on the first sample. False if the info is inconsistent with the chunk size. */
+    bool read(juce::InputStream& in, juce::uint64 payloadSize, TrackInfo& info);
+
+    /** numSamples float32 samples (Codec::Raw), straight into memory on little endian machines. */
+    bool readSamples(juce::InputStream& in, float* samples, int numSamples);
+    void writeSamples(juce::OutputStream& out, const float* samples, int numSamples);
+
+    /** One block as Codec::PerBlock stores it: the first numFrames of numChannels channels
+        of audio, uncompressed, or encodeBlock() data. */
+    void writeRawBlock(juce::OutputStream& out, const juce::AudioBuffer<float>& audio, int numChannels, int numFrames);
+    void writeCompressedBlock(juce::OutputStream& out, const juce::MemoryBlock& encoded);
+    /** Bytes either takes, with its codec field. */
+    juce::uint64 getRawBlockSize(int numChannels, int numFrames);
+    juce::uint64 getCompressedBlockSize(const juce::MemoryBlock& encoded);
+
+    /** Reads a track's audio (either codec) into the first info.length frames of audio
+        (sized by the caller). Stored channels beyond audio's are skipped; a mono loop
+        fills every channel. */
+    bool readAudio(juce::InputStream& in, const TrackInfo& info, juce::AudioBuffer<float>& audio);
+
+    //==============================================================================
+    // Compressed blocks
+
+    /** Identity of a block's samples (128 bits of two independent 64-bit hashes). */
+    struct BlockHash
+    {
+        juce::uint64 a = 0, b = 0;
+        bool operator== (const BlockHash& other) const { return a == other.a && b == other.b; }
+    };
+
+    BlockHash hashBlock(const juce::AudioBuffer<float>& audio, int numChannels, int numFrames);
+
+    /** The first numFrames of numChannels channels of audio, losslessly compressed. */
+    juce::MemoryBlock encodeBlock(const juce::AudioBuffer<float>& audio, int numChannels, int numFrames);
+
+    /** Decodes encodeBlock() data into audio[destStart, destStart + numFrames). Stored
+        channels beyond audio's are dropped. False if the data is damaged. */
+    bool decodeBlock(const void* data, size_t size, int numChannels, int numFrames,
+                     juce::AudioBuffer<float>& audio, int destStart);
+}
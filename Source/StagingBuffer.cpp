@@ -0,0 +1,38 @@
+#include "StagingBuffer.h"
+
+void StagingBufferPool::prepare(int newNumChannels)
+{
+    numChannels = juce::jmax(1, newNumChannels);
+    for (auto& buffer : buffers)
+    {
+        buffer.audio.setSize(numChannels, 0);
+        buffer.refCount.store(0);
+    }
+}
+
+StagingBuffer* StagingBufferPool::acquire()
+{
+    for (auto& buffer : buffers)
+    {
+        int expected = 0;
+        if (buffer.refCount.compare_exchange_strong(expected, 1))
+            return &buffer;
+    }
+    return nullptr;
+}
+
+void StagingBufferPool::reserve(StagingBuffer& buffer, int numSamples) const
+{
+    // Keeps the allocation when it is already big enough
+    if (buffer.audio.getNumSamples() < numSamples || buffer.audio.getNumChannels() != numChannels)
+        buffer.audio.setSize(numChannels, numSamples, false, false, true);
+}
+
+int StagingBufferPool::getNumFree() const
+{
+    int count = 0;
+    for (auto& buffer : buffers)
+        if (buffer.refCount.load() == 0)
+            ++count;
+    return count;
+}
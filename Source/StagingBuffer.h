@@ -0,0 +1,51 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+/**
+    Audio rendered off the audio thread (bounce, after loop) and handed to a
+    track's progressive replace. Reference counted: the job holds one reference
+    while it renders, a track one while its replace still reads the buffer.
+    When the last reference goes the buffer is free for the next job.
+*/
+struct StagingBuffer
+{
+    juce::AudioBuffer<float> audio;
+    std::atomic<int> refCount { 0 };
+};
+
+/**
+    Small fixed set of StagingBuffers, so back-to-back jobs each get their own.
+    - acquire() / retain() / release() are lock-free (audio thread).
+    - Buffers start empty and grow on the worker thread (reserve), so memory
+      follows the longest result produced and the audio thread never reallocates.
+*/
+class StagingBufferPool
+{
+public:
+    static constexpr int numBuffers = 3;
+
+    StagingBufferPool() = default;
+
+    /** PREPARE: message thread, while no buffer is referenced. Frees the buffers' memory. */
+    void prepare(int numChannels);
+
+    /** AUDIO: a free buffer holding one reference, or nullptr if all are in use. */
+    StagingBuffer* acquire();
+
+    static void retain(StagingBuffer* buffer) { if (buffer != nullptr) buffer->refCount.fetch_add(1); }
+    static void release(StagingBuffer* buffer) { if (buffer != nullptr) buffer->refCount.fetch_sub(1); }
+
+    /** WORKER: makes room for numSamples. The caller must hold the only reference. */
+    void reserve(StagingBuffer& buffer, int numSamples) const;
+
+    int getNumFree() const;
+
+private:
+    std::array<StagingBuffer, numBuffers> buffers;
+    int numChannels = 2;
+
+    JUCE_DECLARE_NON_COPYABLE(StagingBufferPool)
+};
@@ -0,0 +1,44 @@
+#include "StemExport.h"
+
+namespace StemExport
+{
+    juce::String getFileExtension(Format format)
+    {
+        return format == Format::Flac ? ".flac" : ".wav";
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File& file, Format format,
+                                                          double sampleRate, int numChannels)
+    {
+        // FileOutputStream appends to an existing file
+        if (file.exists() && !file.deleteFile())
+            return nullptr;
+
+        std::unique_ptr<juce::OutputStream> stream = std::make_unique<juce::FileOutputStream>(file);
+        if (!static_cast<juce::FileOutputStream&>(*stream).openedOk())
+            return nullptr;
+
+        using SampleFormat = juce::AudioFormatWriterOptions::SampleFormat;
+        const bool flac = format == Format::Flac;
+        const auto options = juce::AudioFormatWriterOptions{}.withSampleRate(sampleRate)
+                                                             .withNumChannels(numChannels)
+                                                             .withBitsPerSample(flac ? 24 : 32)
+                                                             .withSampleFormat(flac ? SampleFormat::integral
+                                                                                    : SampleFormat::floatingPoint);
+
+        std::unique_ptr<juce::AudioFormat> audioFormat;
+        if (flac)
+            audioFormat = std::make_unique<juce::FlacAudioFormat>();
+        else
+            audioFormat = std::make_unique<juce::WavAudioFormat>();
+
+        // The writer owns the stream once it's created
+        auto writer = audioFormat->createWriterFor(stream, options);
+        if (writer == nullptr)
+        {
+            stream.reset();
+            file.deleteFile();
+        }
+        return writer;
+    }
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <JuceHeader.h>
+#include <memory>
+
+/**
+    Stem export: what to write, and the file writers.
+
+    The processor snapshots the tracks and renders the files on background threads
+    (SimpleLooperAudioProcessor::exportStems); this only turns audio into files.
+    Every file of an export has the same length (the longest loop, at least the
+    master loop) and starts at the master loop's start, like a bounce, so the files
+    line up when dropped into a DAW.
+*/
+namespace StemExport
+{
+    enum class Format
+    {
+        Wav,    // 32-bit float: the loops' samples as they are
+        Flac    // 24-bit integer, the most FLAC stores
+    };
+
+    struct Options
+    {
+        juce::File folder;          // created if missing; files of the same name are replaced
+        Format format = Format::Wav;
+        bool includeMix = true;     // plus "Mix": the sum of every loop
+    };
+
+    /** ".wav" or ".flac" */
+    juce::String getFileExtension(Format format);
+
+    /** A writer for a new file (an existing one is replaced). Null if the file can't
+        be created. */
+    std::unique_ptr<juce::AudioFormatWriter> createWriter(const juce::File& file, Format format,
+                                                          double sampleRate, int numChannels);
+}
@@ -14,22 +14,23 @@ TrackComponent::TrackComponent(SimpleLooperAudioProcessor& p, LoopTrack& trackTo
         btn.setColour(juce::TextButton::textColourOffId, Colours_::textPrimary);
     };
     setupButton(recPlayButton); setupButton(stopButton); setupButton(undoButton);
+    setupButton(redoButton);
     setupButton(divButton); setupButton(mulButton); setupButton(afterLoopButton);
     setupButton(clearButton); setupButton(fxReplaceButton);
     setupButton(muteButton); setupButton(soloButton);
 
+    // Overdub passes: popup with mute / delete per layer (not a parameter)
+    addAndMakeVisible(layersButton);
+    layersButton.setColour(juce::TextButton::buttonColourId, Colours_::idle);
+    layersButton.setColour(juce::TextButton::textColourOffId, Colours_::textPrimary);
+    layersButton.onClick = [this] { showLayerMenu(); };
+
     addAndMakeVisible(volumeSlider);
     volumeSlider.setSliderStyle(juce::Slider::LinearHorizontal);
     volumeSlider.setTextBoxStyle(juce::Slider::NoTextBox, false, 0, 0);
 
     addAndMakeVisible(mOutputSelector);
-    mOutputSelector.addItem("Monitor 1/2", 1);
-    mOutputSelector.addItem("Output 3/4", 2);
-    mOutputSelector.addItem("Output 5/6", 3);
-    mOutputSelector.addItem("Output 7/8", 4);
-    mOutputSelector.addItem("Output 9/10", 5);
-    mOutputSelector.addItem("Output 11/12", 6);
-    mOutputSelector.addItem("Output 13/14", 7);
+    mOutputSelector.addItemList(SimpleLooperAudioProcessor::getOutputNames(p.getNumTracks()), 1);
 
     auto idx = juce::String(trackIndex);
     mVolAttachment       = std::make_unique<juce::AudioProcessorValueTreeState::SliderAttachment>(p.apvts, "vol_" + idx, volumeSlider);
@@ -39,6 +40,7 @@ TrackComponent::TrackComponent(SimpleLooperAudioProcessor& p, LoopTrack& trackTo
     mMuteAttachment      = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "mute_" + idx, muteButton);
     mSoloAttachment      = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "solo_" + idx, soloButton);
     mUndoAttachment      = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "undo_" + idx, undoButton);
+    mRedoAttachment      = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "redo_" + idx, redoButton);
     mMulAttachment       = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "mul_" + idx, mulButton);
     mDivAttachment       = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "div_" + idx, divButton);
     mAfterLoopAttachment = std::make_unique<juce::AudioProcessorValueTreeState::ButtonAttachment>(p.apvts, "afterloop_" + idx, afterLoopButton);
@@ -144,10 +146,11 @@ void TrackComponent::resized()
     int bh = 26, gp = 3;
 
     auto r1 = area.removeFromTop(bh);
-    int n = 8, bw = (r1.getWidth() - (n - 1) * gp) / n;
+    int n = 9, bw = (r1.getWidth() - (n - 1) * gp) / n;
     recPlayButton.setBounds(r1.removeFromLeft(bw));   r1.removeFromLeft(gp);
     stopButton.setBounds(r1.removeFromLeft(bw));      r1.removeFromLeft(gp);
     undoButton.setBounds(r1.removeFromLeft(bw));      r1.removeFromLeft(gp);
+    redoButton.setBounds(r1.removeFromLeft(bw));      r1.removeFromLeft(gp);
     divButton.setBounds(r1.removeFromLeft(bw));       r1.removeFromLeft(gp);
     mulButton.setBounds(r1.removeFromLeft(bw));       r1.removeFromLeft(gp);
     afterLoopButton.setBounds(r1.removeFromLeft(bw)); r1.removeFromLeft(gp);
@@ -157,7 +160,8 @@ void TrackComponent::resized()
     area.removeFromTop(4);
     auto r2 = area.removeFromTop(bh);
     muteButton.setBounds(r2.removeFromLeft(30));  r2.removeFromLeft(gp);
-    soloButton.setBounds(r2.removeFromLeft(30));  r2.removeFromLeft(6);
+    soloButton.setBounds(r2.removeFromLeft(30));  r2.removeFromLeft(gp);
+    layersButton.setBounds(r2.removeFromLeft(30)); r2.removeFromLeft(6);
     mOutputSelector.setBounds(r2.removeFromRight(110)); r2.removeFromRight(6);
     volumeSlider.setBounds(r2);
 }
@@ -182,6 +186,9 @@ void TrackComponent::updateButtonVisuals()
     soloButton.setColour(juce::TextButton::textColourOnId, track.getSolo() ? Colours_::bg : Colours_::textPrimary);
     undoButton.setEnabled(track.canUndo());
     undoButton.setColour(juce::TextButton::buttonColourId, track.canUndo() ? Colours_::undo.brighter(0.2f) : Colours_::idle);
+    undoButton.setButtonText(track.canUndo() ? "UNDO " + juce::String(track.getNumUndoLevels()) : "UNDO");
+    redoButton.setEnabled(track.canRedo());
+    redoButton.setColour(juce::TextButton::buttonColourId, track.canRedo() ? Colours_::undo.brighter(0.2f) : Colours_::idle);
 
     float mult = track.getTargetMultiplier();
     juce::String mt = (mult < 1.0f) ? "1/" + juce::String(juce::roundToInt(1.0f / mult))
@@ -198,10 +205,106 @@ void TrackComponent::updateButtonVisuals()
     afterLoopButton.setEnabled(ca);
     afterLoopButton.setColour(juce::TextButton::buttonColourId, ca ? Colours_::afterloop : Colours_::idle);
     clearButton.setColour(juce::TextButton::buttonColourId, Colours_::clear);
-    bool fx = track.isFxCaptureReady();
-    fxReplaceButton.setEnabled(fx);
+    bool fx = track.isFxCaptureArmed();
+    fxReplaceButton.setEnabled(fx || track.getLoopLengthSamples() > 0);
     fxReplaceButton.setColour(juce::TextButton::buttonColourId, fx ? Colours_::fxReady : Colours_::idle);
     stopButton.setColour(juce::TextButton::buttonColourId, Colours_::idle);
+
+    int layers = track.getNumLayers();
+    layersButton.setEnabled(layers > 0);
+    layersButton.setButtonText(layers > 0 ? "L" + juce::String(layers) : "L");
+}
+
+void TrackComponent::showLayerMenu()
+{
+    int layers = track.getNumLayers();
+    if (layers == 0) return;
+
+    juce::PopupMenu menu;
+    for (int i = 0; i < layers; ++i)
+    {
+        juce::PopupMenu pass;
+        pass.addItem(1 + i * 2, "Mute", true, track.isLayerMuted(i));
+        pass.addItem(2 + i * 2, "Delete");
+        menu.addSubMenu("Pass " + juce::String(i + 1), pass);
+    }
+
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(&layersButton),
+        [this](int result)
+        {
+            if (result <= 0) return;
+            int layer = (result - 1) / 2;
+            if ((result - 1) % 2 == 0)
+                track.requestLayerMute(layer, !track.isLayerMuted(layer));
+            else
+                track.requestLayerDelete(layer);
+        });
+}
+
+void TrackComponent::mouseDown(const juce::MouseEvent& e)
+{
+    // Right-click on the panel (outside the buttons): import, MIDI learn
+    if (e.mods.isPopupMenu())
+        showTrackMenu();
+}
+
+void TrackComponent::chooseImportFile(bool alignToMaster)
+{
+    importChooser = std::make_unique<juce::FileChooser>("Import into track " + juce::String(trackID + 1),
+                                                        juce::File(), AudioImport::getWildcard());
+    importChooser->launchAsync(juce::FileBrowserComponent::openMode | juce::FileBrowserComponent::canSelectFiles,
+        [this, alignToMaster](const juce::FileChooser& chooser)
+        {
+            if (chooser.getResult() != juce::File())
+                processor.importAudioFile(trackID, chooser.getResult(), alignToMaster);
+        });
+}
+
+void TrackComponent::showTrackMenu()
+{
+    using Cmd = LooperCommand::Type;
+    static const Cmd commands[] = { Cmd::RecPlay, Cmd::Stop, Cmd::Undo, Cmd::Redo, Cmd::Multiply,
+                                    Cmd::Divide, Cmd::AfterLoop, Cmd::Clear, Cmd::FxReplace };
+    constexpr int numCommands = (int)(sizeof(commands) / sizeof(commands[0]));
+    constexpr int forgetBase = 100, cancelId = 200, importId = 300, importAlignedId = 301;
+
+    auto& learn = processor.getMidiLearn();
+    juce::PopupMenu menu, forget;
+    menu.addSectionHeader("Track " + juce::String(trackID + 1));
+    const bool canImport = processor.canImportInto(trackID);
+    menu.addItem(importId, "Import audio file...", canImport);
+    menu.addItem(importAlignedId, "Import audio file, fit to the master loop...", canImport && trackID > 0);
+
+    menu.addSectionHeader("MIDI Learn");
+
+    for (int i = 0; i < numCommands; ++i)
+    {
+        auto binding = learn.describeBinding(commands[i], trackID);
+        juce::String name = getCommandName(commands[i]);
+        menu.addItem(1 + i, binding.isEmpty() ? name : name + "  [" + binding + "]",
+                     true, learn.isLearning(commands[i], trackID));
+        if (binding.isNotEmpty())
+            forget.addItem(forgetBase + i, name + "  [" + binding + "]");
+    }
+
+    menu.addSeparator();
+    menu.addSubMenu("Forget", forget, forget.getNumItems() > 0);
+    if (learn.isLearning())
+        menu.addItem(cancelId, "Cancel learning");
+
+    menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this),
+        [this](int result)
+        {
+            auto& learn = processor.getMidiLearn();
+            if (result == importId || result == importAlignedId)
+                chooseImportFile(result == importAlignedId);
+            else if (result == cancelId)
+                learn.cancelLearning();
+            else if (result >= forgetBase && result < forgetBase + numCommands)
+                learn.forget(commands[result - forgetBase], trackID);
+            else if (result >= 1 && result <= numCommands)
+                learn.startLearning(commands[result - 1], trackID);
+        });
 }
 
 void TrackComponent::timerCallback() { updateButtonVisuals(); }
@@ -15,6 +15,7 @@ public:
     void paint(juce::Graphics&) override;
     void resized() override;
     void timerCallback() override;
+    void mouseDown(const juce::MouseEvent& e) override;
 
 private:
     SimpleLooperAudioProcessor& processor;
@@ -24,6 +25,7 @@ private:
     juce::TextButton recPlayButton   { "REC" };
     juce::TextButton stopButton      { "STOP" };
     juce::TextButton undoButton      { "UNDO" };
+    juce::TextButton redoButton      { "REDO" };
     juce::TextButton divButton       { "/2" };
     juce::TextButton mulButton       { "X2" };
     juce::TextButton afterLoopButton { "AFTER" };
@@ -31,10 +33,16 @@ private:
     juce::TextButton fxReplaceButton { "FX" };
     juce::TextButton muteButton      { "M" };
     juce::TextButton soloButton      { "S" };
+    juce::TextButton layersButton    { "L" };
     juce::Slider     volumeSlider;
     juce::ComboBox   mOutputSelector;
 
     void updateButtonVisuals();
+    void showLayerMenu();
+    void showTrackMenu();
+    void chooseImportFile(bool alignToMaster);
+
+    std::unique_ptr<juce::FileChooser> importChooser;
 
     std::unique_ptr<juce::AudioProcessorValueTreeState::SliderAttachment>   mVolAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>   mRecAttachment;
@@ -43,6 +51,7 @@ private:
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>   mMuteAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>   mSoloAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>   mUndoAttachment;
+    std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>   mRedoAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>   mMulAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>   mDivAttachment;
     std::unique_ptr<juce::AudioProcessorValueTreeState::ButtonAttachment>   mAfterLoopAttachment;